@@ -26,6 +26,9 @@
 #include <starpu_scheduler.h>
 #include <stdlib.h>
 
+#include "sched_trace.h"
+#include "sched_log.h"
+
 #ifdef STARPU_QUICK_CHECK
 #define NTASKS	320
 #elif !defined(STARPU_LONG_CHECK)
@@ -38,7 +41,7 @@
 
 static double get_task_heter_ratio(unsigned sched_ctx_id,struct starpu_task* task);
 
-int all_device_len = 0;// the total number of assigned tasks in all device queues
+static int all_device_len = 0;// the total number of assigned tasks in all device queues
 
 struct dummy_sched_data
 {
@@ -65,6 +68,7 @@ static void init_dummy_sched(unsigned sched_ctx_id)
 	starpu_sched_ctx_set_policy_data(sched_ctx_id, (void*)data);
 
 	STARPU_PTHREAD_MUTEX_INIT(&data->policy_mutex, NULL);
+	sched_trace_init();
 	FPRINTF(stderr, "Initialising Dummy scheduler\n");
 }
 
@@ -83,6 +87,7 @@ static void deinit_dummy_sched(unsigned sched_ctx_id)
 
 	free(data);
 
+	sched_trace_dump();
 	FPRINTF(stderr, "Destroying Dummy scheduler\n");
 }
 
@@ -157,6 +162,8 @@ static int push_task_dummy(struct starpu_task *task)
 	   of them would pop for tasks */
     STARPU_PTHREAD_MUTEX_LOCK(&data->policy_mutex);
     double max_heter_ratio = get_task_heter_ratio(sched_ctx_id, task);
+	SCHED_TRACE(SCHED_TRACE_PUSH, starpu_task_get_job_id(task), -1, 0.0);
+	SCHED_TRACE(SCHED_TRACE_RATIO, starpu_task_get_job_id(task), -1, max_heter_ratio);
     // printf("%lf\n", max_heter_ratio);
 	// starpu_task_list_push_back(&data->sched_list, task);
 	if(starpu_task_list_empty(&data->sched_list))
@@ -244,11 +251,11 @@ static double get_task_heter_ratio(unsigned sched_ctx_id,struct starpu_task* tas
 				continue;
 			}
 			double local_length = 1+starpu_task_expected_length(task, perf_arch, nimpl);
-			printf("expected length is %lf\n", local_length);
+			SCHED_LOG_TRACE("expected length of worker %u impl %u is %lf\n", worker, nimpl, local_length);
 			if (local_length>max_execution_time) max_execution_time = local_length;
 		}
 	}
-	printf("the max_execution_time is %lf\n", max_execution_time);
+	SCHED_LOG_DEBUG("the max_execution_time is %lf\n", max_execution_time);
 
 	workers->init_iterator(workers, &it1);
 	while(workers->has_next_master(workers, &it1))
@@ -292,12 +299,16 @@ static struct starpu_task *pop_task_dummy(unsigned sched_ctx_id)
 	unsigned workerid = starpu_worker_get_id_check();
 	struct starpu_task *task = NULL;
 	if (!starpu_task_list_empty(&data->worker_sched_list[workerid]))
+	{
 		task = starpu_task_list_pop_front(&data->worker_sched_list[workerid]);
+		SCHED_TRACE(SCHED_TRACE_POP, starpu_task_get_job_id(task), workerid, 0.0);
+	}
 	STARPU_PTHREAD_MUTEX_UNLOCK(&data->policy_mutex);
 	return task;
 }
 
-static struct starpu_sched_policy dummy_sched_policy =
+/* Also registered by name in sched-plugin/ */
+struct starpu_sched_policy dummy_sched_policy =
 {
 	.init_sched = init_dummy_sched,
 	.deinit_sched = deinit_dummy_sched,
@@ -307,6 +318,7 @@ static struct starpu_sched_policy dummy_sched_policy =
 	.policy_description = "dummy scheduling strategy"
 };
 
+#ifndef SCHED_POLICY_LIBRARY
 void dummy_func(void *descr[] STARPU_ATTRIBUTE_UNUSED, void *arg STARPU_ATTRIBUTE_UNUSED)
 {
 	int k = 0;
@@ -366,3 +378,4 @@ int main(int argc, char **argv)
 
 	return 0;
 }
+#endif /* !SCHED_POLICY_LIBRARY */
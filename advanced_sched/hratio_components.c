@@ -0,0 +1,336 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+#include <starpu.h>
+#include <starpu_sched_component.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "sched_trace.h"
+#include "hratio_components.h"
+
+/* Ordering component: binary max-heap on the ratio, equal ratios in push
+ * order. Entries are small, the tasks themselves are not touched. */
+struct hratio_entry
+{
+	double key;
+	unsigned long seq;
+	struct starpu_task *task;
+};
+
+struct hratio_component_data
+{
+	starpu_pthread_mutex_t mutex;
+	struct hratio_entry *heap;
+	unsigned ntasks;
+	unsigned size;
+	unsigned long seq;
+};
+
+struct hratio_gate_component_data
+{
+	struct hratio_gate_data params;
+	/* Released and not started yet */
+	int released;
+	/* Held by the thread running the release loop, the others set pending
+	 * so that it loops once more */
+	starpu_pthread_mutex_t mutex;
+	int pending;
+	/* Pulled from the parent but refused by the child, goes first */
+	struct starpu_task *held;
+};
+
+/* Heterogeneity ratio of TASK over the workers below COMPONENT, as
+ * get_task_heter_ratio in test-pi/pi.c, 0 without prediction */
+static double hratio_task_ratio(struct starpu_sched_component *component, struct starpu_task *task)
+{
+	unsigned sched_ctx_id = component->tree->sched_ctx_id;
+	int nbasic = starpu_worker_get_count();
+	double min_length = NAN, max_length = NAN;
+	unsigned impl_mask, nimpl;
+	int worker;
+
+	for (worker = starpu_bitmap_first(component->workers_in_ctx);
+	     worker != -1;
+	     worker = starpu_bitmap_next(component->workers_in_ctx, worker))
+	{
+		struct starpu_perfmodel_arch *perf_arch = starpu_worker_get_perf_archtype(worker, sched_ctx_id);
+
+		if (worker < nbasic && !starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
+			continue;
+		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
+		{
+			if (worker < nbasic ? !(impl_mask & (1U << nimpl))
+			    : !starpu_combined_worker_can_execute_task(worker, task, nimpl))
+				continue;
+			double length = starpu_task_expected_length(task, perf_arch, nimpl);
+			if (isnan(length))
+				continue;
+			if (isnan(min_length) || length < min_length)
+				min_length = length;
+			if (isnan(max_length) || length > max_length)
+				max_length = length;
+		}
+	}
+	return isnan(min_length) ? 0.0 : (1 + max_length) / min_length;
+}
+
+static int hratio_entry_before(const struct hratio_entry *a, const struct hratio_entry *b)
+{
+	return a->key > b->key || (a->key == b->key && a->seq < b->seq);
+}
+
+/* mutex held */
+static void hratio_heap_push(struct hratio_component_data *data, double key, struct starpu_task *task)
+{
+	unsigned i = data->ntasks++;
+
+	if (data->ntasks > data->size)
+	{
+		data->size = data->size ? 2 * data->size : 64;
+		data->heap = realloc(data->heap, data->size * sizeof(*data->heap));
+		STARPU_ASSERT(data->heap);
+	}
+	struct hratio_entry entry = { .key = key, .seq = data->seq++, .task = task };
+	while (i > 0 && hratio_entry_before(&entry, &data->heap[(i - 1) / 2]))
+	{
+		data->heap[i] = data->heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	data->heap[i] = entry;
+}
+
+/* mutex held */
+static struct starpu_task *hratio_heap_pop(struct hratio_component_data *data)
+{
+	if (data->ntasks == 0)
+		return NULL;
+
+	struct starpu_task *task = data->heap[0].task;
+	struct hratio_entry last = data->heap[--data->ntasks];
+	unsigned i = 0, child;
+
+	while ((child = 2 * i + 1) < data->ntasks)
+	{
+		if (child + 1 < data->ntasks && hratio_entry_before(&data->heap[child + 1], &data->heap[child]))
+			child++;
+		if (!hratio_entry_before(&data->heap[child], &last))
+			break;
+		data->heap[i] = data->heap[child];
+		i = child;
+	}
+	data->heap[i] = last;
+	return task;
+}
+
+static int hratio_push_task(struct starpu_sched_component *component, struct starpu_task *task)
+{
+	struct hratio_component_data *data = component->data;
+	/* Computed out of the lock, from the current predictions */
+	double key = hratio_task_ratio(component, task);
+
+	SCHED_TRACE(SCHED_TRACE_RATIO, starpu_task_get_job_id(task), -1, key);
+	STARPU_PTHREAD_MUTEX_LOCK(&data->mutex);
+	hratio_heap_push(data, key, task);
+	STARPU_PTHREAD_MUTEX_UNLOCK(&data->mutex);
+
+	/* Let the components below pull it */
+	component->can_pull(component);
+	return 0;
+}
+
+static struct starpu_task *hratio_pull_task(struct starpu_sched_component *component)
+{
+	struct hratio_component_data *data = component->data;
+	struct starpu_task *task;
+	int i;
+
+	STARPU_PTHREAD_MUTEX_LOCK(&data->mutex);
+	task = hratio_heap_pop(data);
+	STARPU_PTHREAD_MUTEX_UNLOCK(&data->mutex);
+	if (task)
+		return task;
+
+	for (i = 0; i < component->nparents; i++)
+	{
+		if (component->parents[i] == NULL)
+			continue;
+		task = component->parents[i]->pull_task(component->parents[i]);
+		if (task)
+			break;
+	}
+	return task;
+}
+
+static double hratio_estimated_load(struct starpu_sched_component *component)
+{
+	struct hratio_component_data *data = component->data;
+	int nworkers = starpu_bitmap_cardinal(component->workers_in_ctx);
+	/* Same unit as the StarPU queue components: tasks per worker */
+	return (nworkers > 0 ? (double) data->ntasks / nworkers : 0.0)
+		+ starpu_sched_component_estimated_load(component);
+}
+
+static void hratio_deinit_data(struct starpu_sched_component *component)
+{
+	struct hratio_component_data *data = component->data;
+	STARPU_ASSERT(data->ntasks == 0);
+	STARPU_PTHREAD_MUTEX_DESTROY(&data->mutex);
+	free(data->heap);
+	free(data);
+}
+
+struct starpu_sched_component *hratio_component_create(struct starpu_sched_tree *tree)
+{
+	struct starpu_sched_component *component = starpu_sched_component_create(tree);
+	struct hratio_component_data *data;
+
+	data = calloc(1, sizeof(*data));
+	STARPU_ASSERT(data);
+	STARPU_PTHREAD_MUTEX_INIT(&data->mutex, NULL);
+
+	component->data = data;
+	component->push_task = hratio_push_task;
+	component->pull_task = hratio_pull_task;
+	component->estimated_load = hratio_estimated_load;
+	component->deinit_data = hratio_deinit_data;
+	return component;
+}
+
+static int hratio_gate_open(struct starpu_sched_component *component)
+{
+	struct hratio_gate_component_data *data = component->data;
+
+	if (data->params.horizon > 0.0)
+	{
+		struct starpu_sched_component *child = component->children[0];
+		double end = child->estimated_end(child);
+		return isnan(end) || end - starpu_timing_now() < data->params.horizon;
+	}
+	return (unsigned) __atomic_load_n(&data->released, __ATOMIC_RELAXED) < data->params.ntasks_threshold;
+}
+
+/* Next task to release: the held one, or the parent's best */
+static struct starpu_task *hratio_gate_next(struct hratio_gate_component_data *data, struct starpu_sched_component *parent)
+{
+	struct starpu_task *task = __atomic_exchange_n(&data->held, NULL, __ATOMIC_SEQ_CST);
+	return task ? task : parent->pull_task(parent);
+}
+
+/* Pull from the parent and push to the child while open. A task the child
+ * refuses is held until the next release: pushing it back to the parent
+ * would call this again. Returns whether something was released. */
+static int hratio_gate_release(struct starpu_sched_component *component)
+{
+	struct hratio_gate_component_data *data = component->data;
+	struct starpu_sched_component *parent = component->parents[0];
+	struct starpu_sched_component *child = component->children[0];
+	int released = 0;
+
+	__atomic_store_n(&data->pending, 1, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&data->pending, __ATOMIC_SEQ_CST)
+	       && STARPU_PTHREAD_MUTEX_TRYLOCK(&data->mutex) == 0)
+	{
+		__atomic_store_n(&data->pending, 0, __ATOMIC_SEQ_CST);
+		while (hratio_gate_open(component))
+		{
+			struct starpu_task *task = hratio_gate_next(data, parent);
+			if (!task)
+				break;
+			__atomic_add_fetch(&data->released, 1, __ATOMIC_RELAXED);
+			if (child->push_task(child, task) != 0)
+			{
+				__atomic_sub_fetch(&data->released, 1, __ATOMIC_RELAXED);
+				__atomic_store_n(&data->held, task, __ATOMIC_SEQ_CST);
+				break;
+			}
+			released = 1;
+		}
+		STARPU_PTHREAD_MUTEX_UNLOCK(&data->mutex);
+	}
+	return released;
+}
+
+static int hratio_gate_push_task(struct starpu_sched_component *component, struct starpu_task *task)
+{
+	struct hratio_gate_component_data *data = component->data;
+	struct starpu_sched_component *child = component->children[0];
+
+	/* Refused, the pushing component keeps it */
+	if (!hratio_gate_open(component))
+		return 1;
+	__atomic_add_fetch(&data->released, 1, __ATOMIC_RELAXED);
+	int ret = child->push_task(child, task);
+	if (ret != 0)
+		__atomic_sub_fetch(&data->released, 1, __ATOMIC_RELAXED);
+	return ret;
+}
+
+/* A worker below ran out of tasks */
+static struct starpu_task *hratio_gate_pull_task(struct starpu_sched_component *component)
+{
+	struct hratio_gate_component_data *data = component->data;
+	struct starpu_sched_component *parent = component->parents[0];
+
+	if (!hratio_gate_open(component))
+		return NULL;
+	struct starpu_task *task = hratio_gate_next(data, parent);
+	if (task)
+		__atomic_add_fetch(&data->released, 1, __ATOMIC_RELAXED);
+	return task;
+}
+
+/* The parent got tasks */
+static void hratio_gate_can_pull(struct starpu_sched_component *component)
+{
+	hratio_gate_release(component);
+	starpu_sched_component_can_pull(component);
+}
+
+/* The child has room */
+static int hratio_gate_can_push(struct starpu_sched_component *component)
+{
+	return hratio_gate_release(component);
+}
+
+static void hratio_gate_deinit_data(struct starpu_sched_component *component)
+{
+	struct hratio_gate_component_data *data = component->data;
+	STARPU_ASSERT(data->held == NULL);
+	STARPU_PTHREAD_MUTEX_DESTROY(&data->mutex);
+	free(data);
+}
+
+struct starpu_sched_component *hratio_gate_component_create(struct starpu_sched_tree *tree, const struct hratio_gate_data *params)
+{
+	struct starpu_sched_component *component = starpu_sched_component_create(tree);
+	struct hratio_gate_component_data *data;
+
+	data = calloc(1, sizeof(*data));
+	STARPU_ASSERT(data);
+	data->params = *params;
+	STARPU_PTHREAD_MUTEX_INIT(&data->mutex, NULL);
+
+	component->data = data;
+	component->push_task = hratio_gate_push_task;
+	component->pull_task = hratio_gate_pull_task;
+	component->can_pull = hratio_gate_can_pull;
+	component->can_push = hratio_gate_can_push;
+	component->deinit_data = hratio_gate_deinit_data;
+	return component;
+}
+
+void hratio_gate_task_started(struct starpu_sched_component *gate)
+{
+	struct hratio_gate_component_data *data = gate->data;
+
+	if (__atomic_sub_fetch(&data->released, 1, __ATOMIC_RELAXED) < 0)
+		/* Started without going through the gate */
+		__atomic_add_fetch(&data->released, 1, __ATOMIC_RELAXED);
+	hratio_gate_release(gate);
+}
@@ -0,0 +1,49 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * H-Ratio as components of StarPU's modular schedulers
+ * (starpu_sched_component.h), to be combined with the StarPU ones:
+ *
+ * - the ordering component holds the ready tasks by decreasing
+ *   heterogeneity ratio, (1 + longest) / shortest expected length over the
+ *   workers below it, and gives the highest first to the components that
+ *   pull from it;
+ * - the gate component pulls from its parent and pushes to its only child
+ *   while the workers below hold fewer than a threshold of released tasks,
+ *   or some of them have less than a horizon of predicted work. The policy
+ *   calls hratio_gate_task_started() from its pre_exec hook, which also
+ *   releases the next tasks.
+ *
+ * modular_hratio.c builds the "modular-hratio" policy from them:
+ * hratio -> gate -> perfmodel select (mct, or eager while calibrating) ->
+ * per-worker prio queues -> best implementation -> workers.
+ */
+
+#ifndef __HRATIO_COMPONENTS_H__
+#define __HRATIO_COMPONENTS_H__
+
+#include <starpu.h>
+#include <starpu_sched_component.h>
+
+struct hratio_gate_data
+{
+	/* Released tasks not started yet, at most */
+	unsigned ntasks_threshold;
+	/* When positive, release instead while the child estimates an end
+	 * less than this many us from now */
+	double horizon;
+};
+
+struct starpu_sched_component *hratio_component_create(struct starpu_sched_tree *tree);
+struct starpu_sched_component *hratio_gate_component_create(struct starpu_sched_tree *tree, const struct hratio_gate_data *params);
+
+/* A task released by GATE started executing */
+void hratio_gate_task_started(struct starpu_sched_component *gate);
+
+#endif /* __HRATIO_COMPONENTS_H__ */
@@ -0,0 +1,150 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * H-Ratio built from sched components, as StarPU's modular-heft:
+ *
+ *   hratio -> gate -> perfmodel select -+- mct --------------+-> prio -> best impl -> worker
+ *                                       +- eager calibration +   (one per worker)
+ *                                       +- eager ------------+
+ *
+ * With STARPU_HR_PLACEMENT=ws, the gate feeds a work stealing component
+ * instead, whose workers steal from each other.
+ */
+
+#include <starpu.h>
+#include <starpu_sched_component.h>
+#include <starpu_scheduler.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sched_trace.h"
+#include "hratio_components.h"
+
+/* Default gate, as the thr of the monolithic policy in test-pi/pi.c */
+#define _HR_GATE_NTASKS_DEFAULT 256
+
+/* Tree shape: the gate is the only child of the root */
+static struct starpu_sched_component *modular_hratio_gate(unsigned sched_ctx_id)
+{
+	struct starpu_sched_tree *t = starpu_sched_ctx_get_policy_data(sched_ctx_id);
+	return t->root->children[0];
+}
+
+static void modular_hratio_connect_workers(struct starpu_sched_tree *t, unsigned sched_ctx_id,
+					   struct starpu_sched_component **parents, unsigned nparents, int with_queue)
+{
+	struct starpu_sched_component_prio_data prio_data =
+	{
+		.ntasks_threshold = starpu_get_env_number_default("STARPU_NTASKS_THRESHOLD", 30),
+		.exp_len_threshold = starpu_get_env_float_default("STARPU_EXP_LEN_THRESHOLD", 0.01),
+	};
+	unsigned i, p;
+
+	for (i = 0; i < starpu_worker_get_count() + starpu_combined_worker_get_count(); i++)
+	{
+		struct starpu_sched_component *worker_component = starpu_sched_component_worker_get(sched_ctx_id, i);
+		struct starpu_sched_component *impl_component = starpu_sched_component_best_implementation_create(t, NULL);
+		struct starpu_sched_component *top = impl_component;
+
+		if (with_queue)
+		{
+			/* Sorted by priority, prefetches the data of its tasks */
+			top = starpu_sched_component_prio_create(t, &prio_data);
+			starpu_sched_component_connect(top, impl_component);
+		}
+		starpu_sched_component_connect(impl_component, worker_component);
+		for (p = 0; p < nparents; p++)
+			starpu_sched_component_connect(parents[p], top);
+	}
+}
+
+static void initialize_modular_hratio_policy(unsigned sched_ctx_id)
+{
+	struct hratio_gate_data gate_data =
+	{
+		.ntasks_threshold = starpu_get_env_number_default("STARPU_HR_GATE_NTASKS", _HR_GATE_NTASKS_DEFAULT),
+		.horizon = starpu_get_env_float_default("STARPU_HR_HORIZON", 0.0),
+	};
+	const char *placement = getenv("STARPU_HR_PLACEMENT");
+
+	starpu_sched_ctx_create_worker_collection(sched_ctx_id, STARPU_WORKER_LIST);
+	struct starpu_sched_tree *t = starpu_sched_tree_create(sched_ctx_id);
+
+	t->root = hratio_component_create(t);
+	struct starpu_sched_component *gate = hratio_gate_component_create(t, &gate_data);
+	starpu_sched_component_connect(t->root, gate);
+
+	if (placement && strcmp(placement, "ws") == 0)
+	{
+		struct starpu_sched_component *ws = starpu_sched_component_work_stealing_create(t, NULL);
+		starpu_sched_component_connect(gate, ws);
+		modular_hratio_connect_workers(t, sched_ctx_id, &ws, 1, 0);
+	}
+	else
+	{
+		struct starpu_sched_component_mct_data mct_data =
+		{
+			._alpha = starpu_get_env_float_default("STARPU_SCHED_ALPHA", 1.0),
+			._beta = starpu_get_env_float_default("STARPU_SCHED_BETA", 1.0),
+			._gamma = starpu_get_env_float_default("STARPU_SCHED_GAMMA", 1000.0),
+			.idle_power = starpu_get_env_float_default("STARPU_IDLE_POWER", 0.0),
+		};
+		struct starpu_sched_component *mct = starpu_sched_component_mct_create(t, &mct_data);
+		struct starpu_sched_component *no_perfmodel = starpu_sched_component_eager_create(t, NULL);
+		struct starpu_sched_component *calibrator = starpu_sched_component_eager_calibration_create(t, NULL);
+		struct starpu_sched_component_perfmodel_select_data select_data =
+		{
+			.calibrator_component = calibrator,
+			.no_perfmodel_component = no_perfmodel,
+			.perfmodel_component = mct,
+		};
+		struct starpu_sched_component *select = starpu_sched_component_perfmodel_select_create(t, &select_data);
+		struct starpu_sched_component *placers[] = { mct, no_perfmodel, calibrator };
+
+		starpu_sched_component_connect(gate, select);
+		starpu_sched_component_connect(select, calibrator);
+		starpu_sched_component_connect(select, mct);
+		starpu_sched_component_connect(select, no_perfmodel);
+		modular_hratio_connect_workers(t, sched_ctx_id, placers, 3, 1);
+	}
+
+	starpu_sched_tree_update_workers(t);
+	starpu_sched_ctx_set_policy_data(sched_ctx_id, (void*)t);
+	sched_trace_init();
+}
+
+static void deinitialize_modular_hratio_policy(unsigned sched_ctx_id)
+{
+	struct starpu_sched_tree *t = (struct starpu_sched_tree*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
+	sched_trace_dump();
+	starpu_sched_tree_destroy(t);
+	starpu_sched_ctx_delete_worker_collection(sched_ctx_id);
+}
+
+static void modular_hratio_pre_exec_hook(struct starpu_task *task)
+{
+	starpu_sched_component_worker_pre_exec_hook(task);
+	hratio_gate_task_started(modular_hratio_gate(task->sched_ctx));
+}
+
+/* Also registered by name in sched-plugin/ */
+struct starpu_sched_policy modular_hratio_sched_policy =
+{
+	.init_sched = initialize_modular_hratio_policy,
+	.deinit_sched = deinitialize_modular_hratio_policy,
+	.add_workers = starpu_sched_tree_add_workers,
+	.remove_workers = starpu_sched_tree_remove_workers,
+	.push_task = starpu_sched_tree_push_task,
+	.pop_task = starpu_sched_tree_pop_task,
+	.pre_exec_hook = modular_hratio_pre_exec_hook,
+	.post_exec_hook = starpu_sched_component_worker_post_exec_hook,
+	.pop_every_task = NULL,
+	.policy_name = "modular-hratio",
+	.policy_description = "heterogeneity ratio ordering and gating as sched components"
+};
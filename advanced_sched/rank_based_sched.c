@@ -27,6 +27,10 @@
 #include <stdlib.h>
 #include <starpu_task.h>
 
+#include "sched_trace.h"
+#include "sched_log.h"
+#include "sched_workers.h"
+
 #ifdef STARPU_QUICK_CHECK
 #define NTASKS 320
 #elif !defined(STARPU_LONG_CHECK)
@@ -47,20 +51,21 @@
 static double get_task_heter_ratio(unsigned sched_ctx_id, struct starpu_task *task);
 static double get_rank(unsigned sched_ctx_id, struct starpu_task *task);
 
-int all_device_len = 0; // the total number of assigned tasks in all device queues
+static int all_device_len = 0; // the total number of assigned tasks in all device queues
 
 struct dummy_sched_data
 {
 	struct starpu_task_list sched_list;
 	starpu_pthread_mutex_t policy_mutex;
 	struct starpu_task_list *worker_sched_list;
+	struct sched_workers workers;
 };
 
 static void init_dummy_sched(unsigned sched_ctx_id)
 {
 	starpu_sched_ctx_create_worker_collection(sched_ctx_id, STARPU_WORKER_LIST);
 
-	struct dummy_sched_data *data = (struct dummy_sched_data *)malloc(sizeof(struct dummy_sched_data));
+	struct dummy_sched_data *data = (struct dummy_sched_data *)calloc(1, sizeof(struct dummy_sched_data));
 
 	unsigned int worker_num = starpu_worker_get_count();
 
@@ -75,6 +80,7 @@ static void init_dummy_sched(unsigned sched_ctx_id)
 	starpu_sched_ctx_set_policy_data(sched_ctx_id, (void *)data);
 
 	STARPU_PTHREAD_MUTEX_INIT(&data->policy_mutex, NULL);
+	sched_trace_init();
 	FPRINTF(stderr, "Initialising Dummy scheduler\n");
 }
 
@@ -94,9 +100,23 @@ static void deinit_dummy_sched(unsigned sched_ctx_id)
 
 	free(data);
 
+	sched_trace_dump();
 	FPRINTF(stderr, "Destroying Dummy scheduler\n");
 }
 
+/* Single workers only: unlike H-Ratio, no combined worker is looked for */
+static void add_workers_dummy(unsigned sched_ctx_id, int *workerids, unsigned nworkers)
+{
+	struct dummy_sched_data *data = (struct dummy_sched_data *)starpu_sched_ctx_get_policy_data(sched_ctx_id);
+	sched_workers_add(&data->workers, workerids, nworkers, sched_ctx_id);
+}
+
+static void remove_workers_dummy(unsigned sched_ctx_id, int *workerids, unsigned nworkers)
+{
+	struct dummy_sched_data *data = (struct dummy_sched_data *)starpu_sched_ctx_get_policy_data(sched_ctx_id);
+	sched_workers_remove(&data->workers, workerids, nworkers);
+}
+
 static int push_task_on_device(unsigned sched_ctx_id)
 {
 	struct dummy_sched_data *data = (struct dummy_sched_data *)starpu_sched_ctx_get_policy_data(sched_ctx_id);
@@ -168,9 +188,12 @@ static int push_task_dummy(struct starpu_task *task)
 	   of them would pop for tasks */
 	double rank;
 	rank = get_rank(sched_ctx_id, task);
-	printf("the rank is %d\n", rank);
+	SCHED_TRACE(SCHED_TRACE_PUSH, starpu_task_get_job_id(task), -1, 0.0);
+	SCHED_TRACE(SCHED_TRACE_RANK, starpu_task_get_job_id(task), -1, rank);
+	SCHED_LOG_DEBUG("the rank is %lf\n", rank);
 	STARPU_PTHREAD_MUTEX_LOCK(&data->policy_mutex);
 	double max_heter_ratio = get_task_heter_ratio(sched_ctx_id, task);
+	SCHED_TRACE(SCHED_TRACE_RATIO, starpu_task_get_job_id(task), -1, max_heter_ratio);
 	// printf("%lf\n", max_heter_ratio);
 	// starpu_task_list_push_back(&data->sched_list, task);
 	if (starpu_task_list_empty(&data->sched_list))
@@ -227,6 +250,7 @@ static int push_task_dummy(struct starpu_task *task)
 }
 static double get_task_heter_ratio(unsigned sched_ctx_id, struct starpu_task *task)
 {
+	struct dummy_sched_data *data = (struct dummy_sched_data *)starpu_sched_ctx_get_policy_data(sched_ctx_id);
 	struct starpu_worker_collection *workers = starpu_sched_ctx_get_worker_collection(sched_ctx_id);
 
 	struct starpu_sched_ctx_iterator it;
@@ -241,9 +265,9 @@ static double get_task_heter_ratio(unsigned sched_ctx_id, struct starpu_task *ta
 	while (workers->has_next_master(workers, &it))
 	{
 		worker = workers->get_next_master(workers, &it);
-		unsigned memory_node = starpu_worker_get_memory_node(worker);
-		struct starpu_perfmodel_arch *perf_arch = starpu_worker_get_perf_archtype(worker, sched_ctx_id);
-		if (!starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
+		const struct sched_worker_desc *desc = &data->workers.desc[worker];
+		struct starpu_perfmodel_arch *perf_arch = desc->perf_arch;
+		if (!sched_workers_may_execute(desc, task) || !starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
 			continue;
 
 		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
@@ -254,20 +278,20 @@ static double get_task_heter_ratio(unsigned sched_ctx_id, struct starpu_task *ta
 				continue;
 			}
 			double local_length = 1 + starpu_task_expected_length(task, perf_arch, nimpl);
-			printf("expected length is %lf\n", local_length);
+			SCHED_LOG_TRACE("expected length of worker %u impl %u is %lf\n", worker, nimpl, local_length);
 			if (local_length > max_execution_time)
 				max_execution_time = local_length;
 		}
 	}
-	printf("the max_execution_time is %lf\n", max_execution_time);
+	SCHED_LOG_DEBUG("the max_execution_time is %lf\n", max_execution_time);
 
 	workers->init_iterator(workers, &it1);
 	while (workers->has_next_master(workers, &it1))
 	{
 		worker = workers->get_next_master(workers, &it1);
-		unsigned memory_node = starpu_worker_get_memory_node(worker);
-		struct starpu_perfmodel_arch *perf_arch = starpu_worker_get_perf_archtype(worker, sched_ctx_id);
-		if (!starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
+		const struct sched_worker_desc *desc = &data->workers.desc[worker];
+		struct starpu_perfmodel_arch *perf_arch = desc->perf_arch;
+		if (!sched_workers_may_execute(desc, task) || !starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
 			continue;
 
 		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
@@ -288,7 +312,8 @@ static double get_task_heter_ratio(unsigned sched_ctx_id, struct starpu_task *ta
 
 static double avg_execution_time(unsigned sched_ctx_id, struct starpu_task *task)
 {
-	unsigned m = starpu_worker_get_count();
+	struct dummy_sched_data *data = (struct dummy_sched_data *)starpu_sched_ctx_get_policy_data(sched_ctx_id);
+	unsigned m = data->workers.nworkers;
 	double ances_completion_time = 0;
 	unsigned impl_mask;
 	unsigned nimpl;
@@ -301,9 +326,9 @@ static double avg_execution_time(unsigned sched_ctx_id, struct starpu_task *task
 	while (workers->has_next_master(workers, &it))
 	{
 		unsigned worker = workers->get_next_master(workers, &it);
-		// unsigned memory_node = starpu_worker_get_memory_node(worker);
-		struct starpu_perfmodel_arch *perf_arch = starpu_worker_get_perf_archtype(worker, sched_ctx_id);
-		if (!starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
+		const struct sched_worker_desc *desc = &data->workers.desc[worker];
+		struct starpu_perfmodel_arch *perf_arch = desc->perf_arch;
+		if (!sched_workers_may_execute(desc, task) || !starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
 			continue;
 
 		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
@@ -320,46 +345,33 @@ static double avg_execution_time(unsigned sched_ctx_id, struct starpu_task *task
 	return ances_completion_time / m;
 }
 /*Based on /home/undergrats/XY/starPU/starpu_bk/src/core/perfmodel/perfmodel.c*/
-static double gengral_data_transfer_time(struct starpu_task *ances, struct starpu_task *sucess) //T() transfer a to b
+static double gengral_data_transfer_time(struct dummy_sched_data *data, struct starpu_task *ances, struct starpu_task *sucess) //T() transfer a to b
 {
 	unsigned nbuffers = STARPU_TASK_GET_NBUFFERS(sucess);
 	unsigned buffer = 0;
 	double penalty = 0.0;
-	unsigned src_node = 0;
-	unsigned des_node = 0;
-
-	unsigned m = starpu_worker_get_count();
 
+	/* Grouped by memory node, see sched_workers_transfer_time() */
 	for (buffer = 0; buffer < nbuffers; buffer++)
 	{
 		starpu_data_handle_t handle = STARPU_TASK_GET_HANDLE(sucess, buffer);
-		size_t size = _starpu_data_get_size(handle);
-		for (int i = 0; i < m; i++)
-		{
-			for (int j = 0; j < m; j++)
-			{
-				src_node = starpu_worker_get_memory_node(i);
-				des_node = starpu_worker_get_memory_node(j);
-				if (i == j)
-					continue;
-				penalty += starpu_transfer_predict(src_node, des_node, size);
-			}
-		}
+		penalty += sched_workers_transfer_time(&data->workers, _starpu_data_get_size(handle));
 	}
-	return penalty / (m * m);
+	return penalty;
 }
 
 static double get_rank(unsigned sched_ctx_id, struct starpu_task *task)
 {
+	struct dummy_sched_data *data = (struct dummy_sched_data *)starpu_sched_ctx_get_policy_data(sched_ctx_id);
 	double ances_exe_time = avg_execution_time(sched_ctx_id, task);
 	double max_trans_plus_exe = 0;
-	int succe_size = statpu_task_get_task_succs(task, 0, NULL);
+	int succe_size = starpu_task_get_task_succs(task, 0, NULL);
 	struct starpu_task *succe[succe_size];
 	starpu_task_get_task_succs(task, sizeof(succe) / sizeof(*succe), succe);
 	for (int i = 0; i < succe_size; i++)
 	{
 		double succe_exe_time = avg_execution_time(sched_ctx_id, succe[i]);
-		double trans_time = gengral_data_transfer_time(task, succe[i]);
+		double trans_time = gengral_data_transfer_time(data, task, succe[i]);
 		double trans_plus_exe = succe_exe_time + trans_time;
 		if (trans_plus_exe > max_trans_plus_exe)
 		{
@@ -387,20 +399,27 @@ static struct starpu_task *pop_task_dummy(unsigned sched_ctx_id)
 	unsigned workerid = starpu_worker_get_id_check();
 	struct starpu_task *task = NULL;
 	if (!starpu_task_list_empty(&data->worker_sched_list[workerid]))
+	{
 		task = starpu_task_list_pop_front(&data->worker_sched_list[workerid]);
+		SCHED_TRACE(SCHED_TRACE_POP, starpu_task_get_job_id(task), workerid, 0.0);
+	}
 	STARPU_PTHREAD_MUTEX_UNLOCK(&data->policy_mutex);
 	return task;
 }
 
-static struct starpu_sched_policy dummy_sched_policy =
+/* Also registered by name in sched-plugin/ */
+struct starpu_sched_policy rank_based_sched_policy =
 	{
 		.init_sched = init_dummy_sched,
 		.deinit_sched = deinit_dummy_sched,
+		.add_workers = add_workers_dummy,
+		.remove_workers = remove_workers_dummy,
 		.push_task = push_task_dummy,
 		.pop_task = pop_task_dummy,
-		.policy_name = "dummy",
-		.policy_description = "dummy scheduling strategy"};
+		.policy_name = "rank-based",
+		.policy_description = "rank-based scheduling strategy"};
 
+#ifndef SCHED_POLICY_LIBRARY
 void dummy_func(void *descr[] STARPU_ATTRIBUTE_UNUSED, void *arg STARPU_ATTRIBUTE_UNUSED)
 {
 	int k = 0;
@@ -432,7 +451,7 @@ int main(int argc, char **argv)
 #endif
 
 	starpu_conf_init(&conf);
-	conf.sched_policy = &dummy_sched_policy,
+	conf.sched_policy = &rank_based_sched_policy,
 	ret = starpu_init(&conf);
 	if (ret == -ENODEV)
 		return 77;
@@ -460,3 +479,4 @@ int main(int argc, char **argv)
 
 	return 0;
 }
+#endif /* !SCHED_POLICY_LIBRARY */
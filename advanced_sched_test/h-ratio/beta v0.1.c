@@ -40,6 +40,7 @@
 #include "SobolQRNG/sobol.h"
 #include "SobolQRNG/sobol_gold.h"
 #include "pi.h"
+#include "sched_log.h"
 #include <starpu.h>
 
 #include <common/fxt.h>
@@ -229,7 +230,7 @@ static int push_task_on_best_worker(struct starpu_task *task, int best_workerid,
 {
 	static int cou = 0;
 	cou++;
-	printf("%d\n", cou);
+	SCHED_LOG_TRACE("push_task_on_best_worker call %d\n", cou);
     // printf("e\n");
 	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
 	/* make sure someone coule execute that task ! */
@@ -803,7 +804,7 @@ static double compute_task_heter_ratio(unsigned sched_ctx_id, struct starpu_task
 }
 
 static void* check_threshold(){
-    printf("in\n");
+    SCHED_LOG_DEBUG("check_threshold thread started\n");
     static int k = 0;
 	k = task_count;
 
@@ -1384,7 +1385,7 @@ void dummy_func(void *descr[] STARPU_ATTRIBUTE_UNUSED, void *arg STARPU_ATTRIBUT
     for(int i = 0; i < 1000000; i++)
         m += i;
 	k = k+1;
-	printf("finish %d\n",k);
+	SCHED_LOG_TRACE("finish %d\n",k);
     usleep(10);
 }
 
@@ -28,6 +28,8 @@
 #include <starpu_task.h>
 #include <datawizard/coherency.h>
 
+#include "sched_log.h"
+
 #ifdef STARPU_QUICK_CHECK
 #define NTASKS 320
 #elif !defined(STARPU_LONG_CHECK)
@@ -169,7 +171,7 @@ static int push_task_dummy(struct starpu_task *task)
 	   of them would pop for tasks */
 	double rank;
 	rank = get_rank(sched_ctx_id, task);
-	printf("the rank is %d\n", rank);
+	SCHED_LOG_DEBUG("the rank is %lf\n", rank);
 	STARPU_PTHREAD_MUTEX_LOCK(&data->policy_mutex);
 	double max_heter_ratio = get_task_heter_ratio(sched_ctx_id, task);
 	// printf("%lf\n", max_heter_ratio);
@@ -255,12 +257,12 @@ static double get_task_heter_ratio(unsigned sched_ctx_id, struct starpu_task *ta
 				continue;
 			}
 			double local_length = 1 + starpu_task_expected_length(task, perf_arch, nimpl);
-			printf("expected length is %lf\n", local_length);
+			SCHED_LOG_TRACE("expected length of worker %u impl %u is %lf\n", worker, nimpl, local_length);
 			if (local_length > max_execution_time)
 				max_execution_time = local_length;
 		}
 	}
-	printf("the max_execution_time is %lf\n", max_execution_time);
+	SCHED_LOG_DEBUG("the max_execution_time is %lf\n", max_execution_time);
 
 	workers->init_iterator(workers, &it1);
 	while (workers->has_next_master(workers, &it1))
@@ -26,6 +26,8 @@
 #include <starpu_scheduler.h>
 #include <stdlib.h>
 
+#include "sched_log.h"
+
 #ifdef STARPU_QUICK_CHECK
 #define NTASKS	320
 #elif !defined(STARPU_LONG_CHECK)
@@ -199,11 +201,11 @@ static double get_task_heter_ratio(unsigned sched_ctx_id,struct starpu_task* tas
 				continue;
 			}
 			double local_length = 1+starpu_task_expected_length(task, perf_arch, nimpl);
-			printf("expected length is %lf\n", local_length);
+			SCHED_LOG_TRACE("expected length of worker %u impl %u is %lf\n", worker, nimpl, local_length);
 			if (local_length>max_execution_time) max_execution_time = local_length;
 		}
 	}
-	printf("the max_execution_time is %lf\n", max_execution_time);
+	SCHED_LOG_DEBUG("the max_execution_time is %lf\n", max_execution_time);
 
 	workers->init_iterator(workers, &it1);
 	while(workers->has_next_master(workers, &it1))
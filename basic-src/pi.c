@@ -36,6 +36,8 @@
 #include <limits.h>
 #include <stdlib.h>
 
+#include "sched_log.h"
+
 #ifdef STARPU_USE_CUDA
 void cuda_kernel(void **descr, void *cl_arg);
 #endif
@@ -937,11 +939,11 @@ static double get_task_heter_ratio(unsigned sched_ctx_id,struct starpu_task* tas
 				continue;
 			}
 			double local_length = 1+starpu_task_expected_length(task, perf_arch, nimpl);
-			printf("expected length is %lf\n", local_length);
+			SCHED_LOG_TRACE("expected length of worker %u impl %u is %lf\n", worker, nimpl, local_length);
 			if (local_length>max_execution_time) max_execution_time = local_length;
 		}
 	}
-	printf("the max_execution_time is %lf\n", max_execution_time);
+	SCHED_LOG_DEBUG("the max_execution_time is %lf\n", max_execution_time);
 
 	workers->init_iterator(workers, &it1);
 	while(workers->has_next_master(workers, &it1))
@@ -1363,7 +1365,7 @@ void cpu_kernel(void *descr[], void *cl_arg)
 
 	unsigned *cnt = (unsigned *)STARPU_VECTOR_GET_PTR(descr[1]);
 	*cnt = current_cnt;
-	printf("%d\n", current_cnt);
+	SCHED_LOG_DEBUG("%u shots in the quarter circle\n", current_cnt);
 
 	free(random_numbers);
 }
@@ -0,0 +1,90 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "sched_plugin.h"
+
+static char *policies[BENCH_MAXPOLICIES];
+static unsigned npolicies;
+
+static void bench_add_policies(char *list)
+{
+	char *saveptr;
+	char *name;
+
+	for (name = strtok_r(list, ",", &saveptr); name; name = strtok_r(NULL, ",", &saveptr))
+	{
+		if (npolicies == BENCH_MAXPOLICIES)
+		{
+			fprintf(stderr, "at most %d policies, %s ignored\n", BENCH_MAXPOLICIES, name);
+			continue;
+		}
+		policies[npolicies++] = strdup(name);
+	}
+}
+
+void bench_parse_policies(int *argc, char **argv)
+{
+	int i, j;
+
+	for (i = 1, j = 1; i < *argc; i++)
+	{
+		if (strcmp(argv[i], "-sched") == 0 && i + 1 < *argc)
+			bench_add_policies(argv[++i]);
+		else
+			argv[j++] = argv[i];
+	}
+	*argc = j;
+
+	if (npolicies == 0)
+	{
+		const char *env = getenv("STARPU_SCHED");
+		char *list = strdup(env && env[0] ? env : "hratio");
+		bench_add_policies(list);
+		free(list);
+	}
+#ifdef STARPU_HAVE_UNSETENV
+	/* It would override the policy of each run */
+	unsetenv("STARPU_SCHED");
+#endif
+}
+
+int bench_for_each_policy(bench_run_func run, void *arg)
+{
+	unsigned i;
+	int ret;
+
+	for (i = 0; i < npolicies; i++)
+	{
+		struct starpu_conf conf;
+
+		starpu_conf_init(&conf);
+		conf.sched_policy = sched_plugin_find(policies[i]);
+		if (!conf.sched_policy)
+			conf.sched_policy_name = policies[i];
+
+		ret = starpu_init(&conf);
+		if (ret == -ENODEV)
+			return 77;
+		STARPU_CHECK_RETURN_VALUE(ret, "starpu_init");
+
+		ret = run(policies[i], arg);
+		starpu_shutdown();
+		if (ret < 0)
+		{
+			fprintf(stderr, "%s: %s\n", policies[i], strerror(-ret));
+			return 1;
+		}
+	}
+	return 0;
+}
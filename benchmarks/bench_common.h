@@ -0,0 +1,39 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Helpers shared by the benchmark drivers: each driver runs its workload
+ * once per policy given with -sched, initializing and shutting StarPU down
+ * around each run, and prints one result line per policy.
+ *
+ * A policy name is looked up in libsmartcoop_sched first (see
+ * sched_plugin.h), then left to StarPU, so that the policies of this
+ * repository compare with the StarPU ones (dmda, eager, ws...).
+ */
+
+#ifndef __BENCH_COMMON_H__
+#define __BENCH_COMMON_H__
+
+#include <starpu.h>
+
+#define BENCH_MAXPOLICIES 16
+
+/* Runs the workload under POLICY, StarPU being initialized. Returns 0, or a
+ * negative error which stops the sweep. */
+typedef int (*bench_run_func)(const char *policy, void *arg);
+
+/* Take "-sched name[,name...]" out of ARGV. Without it, the policy is
+ * STARPU_SCHED, or hratio. */
+void bench_parse_policies(int *argc, char **argv);
+
+/* Call RUN once per policy, between starpu_init() and starpu_shutdown().
+ * Returns 77 when StarPU has no worker, as the StarPU examples do, 0 on
+ * success. */
+int bench_for_each_policy(bench_run_func run, void *arg);
+
+#endif /* __BENCH_COMMON_H__ */
@@ -0,0 +1,169 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Tiled Cholesky factorization A = L L^T, right looking: at step k, POTRF
+ * of the diagonal tile, TRSM of the tiles below it, then SYRK and GEMM
+ * updates of the trailing lower part. The dependencies come from the
+ * sequential consistency of the tiles.
+ */
+
+#include <stdio.h>
+
+#include "dense.h"
+
+#define TILE(h, m, k) starpu_data_get_sub_data(h, 2, m, k)
+
+static void potrf_cpu(void *descr[], void *arg)
+{
+	double *a = (double *) STARPU_MATRIX_GET_PTR(descr[0]);
+	int ret = dense_potrf(a, STARPU_MATRIX_GET_NX(descr[0]), STARPU_MATRIX_GET_LD(descr[0]));
+	STARPU_ASSERT_MSG(ret == 0, "matrix not positive definite");
+}
+
+static void trsm_cpu(void *descr[], void *arg)
+{
+	dense_trsm_rlt((double *) STARPU_MATRIX_GET_PTR(descr[0]), STARPU_MATRIX_GET_LD(descr[0]),
+		       (double *) STARPU_MATRIX_GET_PTR(descr[1]), STARPU_MATRIX_GET_NX(descr[1]),
+		       STARPU_MATRIX_GET_LD(descr[1]));
+}
+
+static void syrk_cpu(void *descr[], void *arg)
+{
+	dense_syrk_ln((double *) STARPU_MATRIX_GET_PTR(descr[0]), STARPU_MATRIX_GET_LD(descr[0]),
+		      (double *) STARPU_MATRIX_GET_PTR(descr[1]), STARPU_MATRIX_GET_NX(descr[1]),
+		      STARPU_MATRIX_GET_LD(descr[1]));
+}
+
+static void gemm_cpu(void *descr[], void *arg)
+{
+	dense_gemm(1, (double *) STARPU_MATRIX_GET_PTR(descr[0]), STARPU_MATRIX_GET_LD(descr[0]),
+		   (double *) STARPU_MATRIX_GET_PTR(descr[1]), STARPU_MATRIX_GET_LD(descr[1]),
+		   (double *) STARPU_MATRIX_GET_PTR(descr[2]), STARPU_MATRIX_GET_NX(descr[2]),
+		   STARPU_MATRIX_GET_LD(descr[2]));
+}
+
+static struct starpu_perfmodel potrf_model = { .type = STARPU_HISTORY_BASED, .symbol = "chol_potrf" };
+static struct starpu_perfmodel trsm_model = { .type = STARPU_HISTORY_BASED, .symbol = "chol_trsm" };
+static struct starpu_perfmodel syrk_model = { .type = STARPU_HISTORY_BASED, .symbol = "chol_syrk" };
+static struct starpu_perfmodel gemm_model = { .type = STARPU_HISTORY_BASED, .symbol = "chol_gemm" };
+
+static struct starpu_codelet potrf_cl =
+{
+	.cpu_funcs = {potrf_cpu},
+	.cpu_funcs_name = {"potrf_cpu"},
+	.nbuffers = 1,
+	.modes = {STARPU_RW},
+	.model = &potrf_model,
+	.name = "potrf"
+};
+
+static struct starpu_codelet trsm_cl =
+{
+	.cpu_funcs = {trsm_cpu},
+	.cpu_funcs_name = {"trsm_cpu"},
+	.nbuffers = 2,
+	.modes = {STARPU_R, STARPU_RW},
+	.model = &trsm_model,
+	.name = "trsm"
+};
+
+static struct starpu_codelet syrk_cl =
+{
+	.cpu_funcs = {syrk_cpu},
+	.cpu_funcs_name = {"syrk_cpu"},
+	.nbuffers = 2,
+	.modes = {STARPU_R, STARPU_RW},
+	.model = &syrk_model,
+	.name = "syrk"
+};
+
+static struct starpu_codelet gemm_cl =
+{
+	.cpu_funcs = {gemm_cpu},
+	.cpu_funcs_name = {"gemm_cpu"},
+	.nbuffers = 3,
+	.modes = {STARPU_R, STARPU_R, STARPU_RW},
+	.model = &gemm_model,
+	.name = "gemm"
+};
+
+static double cholesky_flops(unsigned n)
+{
+	return (double) n * n * n / 3.0;
+}
+
+static int cholesky_submit(starpu_data_handle_t h, unsigned nt, unsigned nb)
+{
+	double tile_flops = (double) nb * nb * nb;
+	unsigned k, m, j;
+	int ret;
+
+	for (k = 0; k < nt; k++)
+	{
+		ret = starpu_task_insert(&potrf_cl,
+					 STARPU_PRIORITY, dense_prio(nt, k, k, k),
+					 STARPU_RW, TILE(h, k, k),
+					 STARPU_FLOPS, tile_flops / 3.0,
+					 0);
+		if (ret)
+			return ret;
+
+		for (m = k + 1; m < nt; m++)
+		{
+			ret = starpu_task_insert(&trsm_cl,
+						 STARPU_PRIORITY, dense_prio(nt, k, m, k),
+						 STARPU_R, TILE(h, k, k),
+						 STARPU_RW, TILE(h, m, k),
+						 STARPU_FLOPS, tile_flops,
+						 0);
+			if (ret)
+				return ret;
+		}
+
+		for (m = k + 1; m < nt; m++)
+		{
+			ret = starpu_task_insert(&syrk_cl,
+						 STARPU_PRIORITY, dense_prio(nt, k, m, m),
+						 STARPU_R, TILE(h, m, k),
+						 STARPU_RW, TILE(h, m, m),
+						 STARPU_FLOPS, tile_flops,
+						 0);
+			if (ret)
+				return ret;
+
+			for (j = k + 1; j < m; j++)
+			{
+				ret = starpu_task_insert(&gemm_cl,
+							 STARPU_PRIORITY, dense_prio(nt, k, m, j),
+							 STARPU_R, TILE(h, m, k),
+							 STARPU_R, TILE(h, j, k),
+							 STARPU_RW, TILE(h, m, j),
+							 STARPU_FLOPS, 2.0 * tile_flops,
+							 0);
+				if (ret)
+					return ret;
+			}
+		}
+	}
+	return 0;
+}
+
+static const struct dense_algo cholesky =
+{
+	.name = "cholesky",
+	.flops = cholesky_flops,
+	.fill = dense_fill_spd,
+	.submit = cholesky_submit,
+	.check = dense_check_cholesky
+};
+
+int main(int argc, char **argv)
+{
+	return dense_main(argc, argv, &cholesky);
+}
@@ -0,0 +1,444 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "dense.h"
+
+#ifdef DENSE_HAVE_SIMD
+#include <immintrin.h>
+int dense_simd = 1;
+#else
+int dense_simd = 0;
+#endif
+
+static unsigned size = 4096;
+static unsigned tile = 256;
+static int use_prio;
+static int check;
+static int check_failed;
+
+/* Inner dimension of the GEMM blocks: a 64-column panel of a 256-row tile
+ * is 128 KB */
+#define DENSE_KB 64
+
+const char *dense_kernels_name(void)
+{
+#ifdef DENSE_HAVE_SIMD
+	if (dense_simd)
+		return "avx2";
+#endif
+	return "scalar";
+}
+
+/*
+ * Column updates
+ */
+
+/* y -= alpha * x */
+static void axpy_scalar(unsigned n, double alpha, const double *x, double *y)
+{
+	unsigned i;
+	for (i = 0; i < n; i++)
+		y[i] -= alpha * x[i];
+}
+
+/* y -= sum of alpha[q] * x[q * ldx], one pass over y for four columns */
+static void axpy4_scalar(unsigned n, const double alpha[4], const double *x, unsigned ldx, double *y)
+{
+	const double *x0 = x, *x1 = x + ldx, *x2 = x + 2 * ldx, *x3 = x + 3 * ldx;
+	unsigned i;
+	for (i = 0; i < n; i++)
+		y[i] -= alpha[0] * x0[i] + alpha[1] * x1[i] + alpha[2] * x2[i] + alpha[3] * x3[i];
+}
+
+#ifdef DENSE_HAVE_SIMD
+static void axpy_avx2(unsigned n, double alpha, const double *x, double *y)
+{
+	__m256d a = _mm256_set1_pd(alpha);
+	unsigned i;
+	for (i = 0; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(y + i, _mm256_fnmadd_pd(a, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+	for (; i < n; i++)
+		y[i] -= alpha * x[i];
+}
+
+static void axpy4_avx2(unsigned n, const double alpha[4], const double *x, unsigned ldx, double *y)
+{
+	const double *x0 = x, *x1 = x + ldx, *x2 = x + 2 * ldx, *x3 = x + 3 * ldx;
+	__m256d a0 = _mm256_set1_pd(alpha[0]);
+	__m256d a1 = _mm256_set1_pd(alpha[1]);
+	__m256d a2 = _mm256_set1_pd(alpha[2]);
+	__m256d a3 = _mm256_set1_pd(alpha[3]);
+	unsigned i;
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		__m256d v = _mm256_loadu_pd(y + i);
+		v = _mm256_fnmadd_pd(a0, _mm256_loadu_pd(x0 + i), v);
+		v = _mm256_fnmadd_pd(a1, _mm256_loadu_pd(x1 + i), v);
+		v = _mm256_fnmadd_pd(a2, _mm256_loadu_pd(x2 + i), v);
+		v = _mm256_fnmadd_pd(a3, _mm256_loadu_pd(x3 + i), v);
+		_mm256_storeu_pd(y + i, v);
+	}
+	for (; i < n; i++)
+		y[i] -= alpha[0] * x0[i] + alpha[1] * x1[i] + alpha[2] * x2[i] + alpha[3] * x3[i];
+}
+#endif
+
+static void axpy(unsigned n, double alpha, const double *x, double *y)
+{
+#ifdef DENSE_HAVE_SIMD
+	if (dense_simd)
+	{
+		axpy_avx2(n, alpha, x, y);
+		return;
+	}
+#endif
+	axpy_scalar(n, alpha, x, y);
+}
+
+/* y -= sum over k in [kbeg, kend) of coef[k * coefinc] * x[k * ldx], with
+ * x the first column and y of n rows */
+static void update_col(unsigned n, unsigned kbeg, unsigned kend, const double *x, unsigned ldx,
+		       const double *coef, unsigned coefinc, double *y)
+{
+	unsigned k = kbeg;
+
+	for (; k + 4 <= kend; k += 4)
+	{
+		double alpha[4] = {coef[k * coefinc], coef[(k + 1) * coefinc],
+				   coef[(k + 2) * coefinc], coef[(k + 3) * coefinc]};
+#ifdef DENSE_HAVE_SIMD
+		if (dense_simd)
+		{
+			axpy4_avx2(n, alpha, x + k * ldx, ldx, y);
+			continue;
+		}
+#endif
+		axpy4_scalar(n, alpha, x + k * ldx, ldx, y);
+	}
+	for (; k < kend; k++)
+		axpy(n, coef[k * coefinc], x + k * ldx, y);
+}
+
+static void scale_col(unsigned n, double alpha, double *y)
+{
+	unsigned i;
+	for (i = 0; i < n; i++)
+		y[i] *= alpha;
+}
+
+/*
+ * Cholesky
+ */
+
+int dense_potrf(double *a, unsigned nb, unsigned lda)
+{
+	unsigned j;
+
+	/* Left looking: column j gets the updates of the columns before it */
+	for (j = 0; j < nb; j++)
+	{
+		double *ajj = a + j + j * lda;
+		update_col(nb - j, 0, j, a + j, lda, a + j, lda, ajj);
+		if (!(*ajj > 0.0))
+			return -1;
+		*ajj = sqrt(*ajj);
+		scale_col(nb - j - 1, 1.0 / *ajj, ajj + 1);
+	}
+	return 0;
+}
+
+void dense_trsm_rlt(const double *l, unsigned ldl, double *b, unsigned nb, unsigned ldb)
+{
+	unsigned j;
+
+	/* X(:,j) = (B(:,j) - sum of L(j,k) X(:,k), k < j) / L(j,j) */
+	for (j = 0; j < nb; j++)
+	{
+		update_col(nb, 0, j, b, ldb, l + j, ldl, b + j * ldb);
+		scale_col(nb, 1.0 / l[j + j * ldl], b + j * ldb);
+	}
+}
+
+void dense_syrk_ln(const double *a, unsigned lda, double *c, unsigned nb, unsigned ldc)
+{
+	unsigned j;
+
+	for (j = 0; j < nb; j++)
+		update_col(nb - j, 0, nb, a + j, lda, a + j, lda, c + j + j * ldc);
+}
+
+void dense_gemm(int transb, const double *a, unsigned lda, const double *b, unsigned ldb,
+		double *c, unsigned nb, unsigned ldc)
+{
+	unsigned kk, j;
+
+	for (kk = 0; kk < nb; kk += DENSE_KB)
+	{
+		unsigned kend = STARPU_MIN(kk + DENSE_KB, nb);
+		for (j = 0; j < nb; j++)
+		{
+			/* op(B)(k,j) is B(k,j), or B(j,k) */
+			if (transb)
+				update_col(nb, kk, kend, a, lda, b + j, ldb, c + j * ldc);
+			else
+				update_col(nb, kk, kend, a, lda, b + j * ldb, 1, c + j * ldc);
+		}
+	}
+}
+
+/*
+ * LU
+ */
+
+int dense_getrf(double *a, unsigned nb, unsigned lda)
+{
+	unsigned j, k;
+
+	/* Left looking: U(0:j,j) by forward substitution with the unit L,
+	 * then the rest of column j */
+	for (j = 0; j < nb; j++)
+	{
+		double *aj = a + j * lda;
+		for (k = 0; k + 1 < j; k++)
+			axpy(j - k - 1, aj[k], a + k + 1 + k * lda, aj + k + 1);
+		update_col(nb - j, 0, j, a + j, lda, aj, 1, aj + j);
+		if (aj[j] == 0.0)
+			return -1;
+		scale_col(nb - j - 1, 1.0 / aj[j], aj + j + 1);
+	}
+	return 0;
+}
+
+void dense_trsm_llu(const double *l, unsigned ldl, double *b, unsigned nb, unsigned ldb)
+{
+	unsigned j, k;
+
+	for (j = 0; j < nb; j++)
+	{
+		double *bj = b + j * ldb;
+		for (k = 0; k + 1 < nb; k++)
+			axpy(nb - k - 1, bj[k], l + k + 1 + k * ldl, bj + k + 1);
+	}
+}
+
+void dense_trsm_run(const double *u, unsigned ldu, double *b, unsigned nb, unsigned ldb)
+{
+	unsigned j;
+
+	/* X(:,j) = (B(:,j) - sum of X(:,k) U(k,j), k < j) / U(j,j) */
+	for (j = 0; j < nb; j++)
+	{
+		update_col(nb, 0, j, b, ldb, u + j * ldu, 1, b + j * ldb);
+		scale_col(nb, 1.0 / u[j + j * ldu], b + j * ldb);
+	}
+}
+
+/*
+ * Matrices
+ */
+
+static double dense_rand(unsigned *state)
+{
+	*state = *state * 1103515245u + 12345u;
+	return ((*state >> 8) & 0xffffff) / (double) 0x1000000;
+}
+
+void dense_fill_spd(double *a, unsigned n, unsigned seed)
+{
+	unsigned i, j;
+
+	for (j = 0; j < n; j++)
+		for (i = j; i < n; i++)
+			a[i + j * n] = a[j + i * n] = dense_rand(&seed);
+	for (j = 0; j < n; j++)
+		a[j + j * n] += n;
+}
+
+void dense_fill_dd(double *a, unsigned n, unsigned seed)
+{
+	unsigned i, j;
+
+	for (j = 0; j < n; j++)
+		for (i = 0; i < n; i++)
+			a[i + j * n] = dense_rand(&seed) - 0.5;
+	for (j = 0; j < n; j++)
+		a[j + j * n] += n;
+}
+
+double dense_check_cholesky(const double *a, const double *f, unsigned n)
+{
+	double err = 0.0, norm = 0.0;
+	unsigned i, j, k;
+
+	for (j = 0; j < n; j++)
+		for (i = j; i < n; i++)
+		{
+			double s = 0.0;
+			for (k = 0; k <= j; k++)
+				s += f[i + k * n] * f[j + k * n];
+			err += (a[i + j * n] - s) * (a[i + j * n] - s);
+			norm += a[i + j * n] * a[i + j * n];
+		}
+	return sqrt(err / norm);
+}
+
+double dense_check_lu(const double *a, const double *f, unsigned n)
+{
+	double err = 0.0, norm = 0.0;
+	unsigned i, j, k;
+
+	for (j = 0; j < n; j++)
+		for (i = 0; i < n; i++)
+		{
+			unsigned kmax = STARPU_MIN(i, j);
+			/* L(i,i) is 1 */
+			double s = i <= j ? f[i + j * n] : 0.0;
+			for (k = 0; k < kmax; k++)
+				s += f[i + k * n] * f[k + j * n];
+			if (i > j)
+				s += f[i + j * n] * f[j + j * n];
+			err += (a[i + j * n] - s) * (a[i + j * n] - s);
+			norm += a[i + j * n] * a[i + j * n];
+		}
+	return sqrt(err / norm);
+}
+
+void dense_register(starpu_data_handle_t *handle, double *a, unsigned n, unsigned nb)
+{
+	/* Rows first: nx is the contiguous dimension */
+	struct starpu_data_filter rows =
+	{
+		.filter_func = starpu_matrix_filter_block,
+		.nchildren = n / nb
+	};
+	struct starpu_data_filter cols =
+	{
+		.filter_func = starpu_matrix_filter_vertical_block,
+		.nchildren = n / nb
+	};
+
+	starpu_matrix_data_register(handle, STARPU_MAIN_RAM, (uintptr_t) a, n, n, n, sizeof(double));
+	starpu_data_map_filters(*handle, 2, &rows, &cols);
+}
+
+void dense_unregister(starpu_data_handle_t handle)
+{
+	starpu_data_unpartition(handle, STARPU_MAIN_RAM);
+	starpu_data_unregister(handle);
+}
+
+int dense_prio(unsigned nt, unsigned k, unsigned m, unsigned j)
+{
+	if (!use_prio)
+		return STARPU_DEFAULT_PRIO;
+	return 2 * nt - 2 * k - (m > k ? m : 0) - (j > k ? j : 0);
+}
+
+/*
+ * Driver
+ */
+
+static int dense_run(const char *policy, void *arg)
+{
+	const struct dense_algo *algo = arg;
+	starpu_data_handle_t handle;
+	double *a;
+	int ret;
+
+	ret = starpu_malloc((void **) &a, (size_t) size * size * sizeof(*a));
+	if (ret)
+		return ret;
+	algo->fill(a, size, 1);
+	dense_register(&handle, a, size, tile);
+
+	double start = starpu_timing_now();
+	ret = algo->submit(handle, size / tile, tile);
+	starpu_task_wait_for_all();
+	double end = starpu_timing_now();
+	dense_unregister(handle);
+
+	if (ret == 0)
+	{
+		double timing = end - start;
+		printf("%-12s %6u %5u %12.1f %10.2f", policy, size, tile, timing / 1000.0,
+		       algo->flops(size) / timing / 1000.0);
+		if (check)
+		{
+			double *orig = malloc((size_t) size * size * sizeof(*orig));
+			STARPU_ASSERT(orig);
+			algo->fill(orig, size, 1);
+			double residual = algo->check(orig, a, size);
+			free(orig);
+			printf(" %10.2e", residual);
+			if (!(residual < 1e-10))
+			{
+				fprintf(stderr, "%s: %s check failed\n", policy, algo->name);
+				check_failed = 1;
+			}
+		}
+		printf("\n");
+	}
+	starpu_free(a);
+	return ret;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,"Usage: %s [options...]\n", argv0);
+	fprintf(stderr,"\n");
+	fprintf(stderr,"Options:\n");
+	fprintf(stderr,"-sched <name>[,<name>...]	policies to compare (default $STARPU_SCHED or hratio)\n");
+	fprintf(stderr,"-size <n>		matrix size (default 4096)\n");
+	fprintf(stderr,"-tile <nb>		tile size, dividing the matrix size (default 256)\n");
+	fprintf(stderr,"-prio			give the tasks their critical path priorities\n");
+	fprintf(stderr,"-nosimd			use the scalar kernels\n");
+	fprintf(stderr,"-check			check the factorization on the host\n");
+}
+
+int dense_main(int argc, char **argv, const struct dense_algo *algo)
+{
+	int i, ret;
+
+	bench_parse_policies(&argc, argv);
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-size") == 0 && i + 1 < argc)
+			size = strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-tile") == 0 && i + 1 < argc)
+			tile = strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-prio") == 0)
+			use_prio = 1;
+		else if (strcmp(argv[i], "-nosimd") == 0)
+			dense_simd = 0;
+		else if (strcmp(argv[i], "-check") == 0)
+			check = 1;
+		else
+		{
+			usage(argv[0]);
+			return strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0 ? 0 : 1;
+		}
+	}
+	if (tile == 0 || size < tile || size % tile)
+	{
+		fprintf(stderr, "the tile size %u must divide the matrix size %u\n", tile, size);
+		return 1;
+	}
+	fprintf(stderr, "%s of %ux%u in %ux%u tiles, %s kernels\n", algo->name, size, size,
+		size / tile, size / tile, dense_kernels_name());
+
+	printf("%-12s %6s %5s %12s %10s%s\n", "policy", "size", "tile", "time_ms", "GFlop/s",
+	       check ? "   residual" : "");
+	ret = bench_for_each_policy(dense_run, (void *) algo);
+	return ret ? ret : check_failed;
+}
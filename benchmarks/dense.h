@@ -0,0 +1,94 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Tile kernels and driver of the dense linear algebra benchmarks
+ * (cholesky.c, lu.c).
+ *
+ * Matrices are column-major doubles: element (i, j) of a matrix of leading
+ * dimension ld is a[i + j * ld]. The kernels work on square nb x nb tiles
+ * of a larger matrix, so each tile has its own leading dimension. They are
+ * column oriented, everything goes through y += alpha * x on contiguous
+ * columns, and the GEMM is blocked on its inner dimension so that a panel
+ * of A stays in cache while the columns of C are updated.
+ *
+ * When the compiler targets AVX2 with FMA (BENCH_NATIVE in CMakeLists.txt),
+ * SIMD variants of the column updates are built too and used unless
+ * dense_simd is cleared.
+ */
+
+#ifndef __DENSE_H__
+#define __DENSE_H__
+
+#include <starpu.h>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#define DENSE_HAVE_SIMD 1
+#endif
+
+/* Use the SIMD variants, when built */
+extern int dense_simd;
+
+/* "avx2" or "scalar", what the kernels currently run */
+const char *dense_kernels_name(void);
+
+/* A = L L^T, L overwrites the lower part of A. Returns -1 when A is not
+ * positive definite. */
+int dense_potrf(double *a, unsigned nb, unsigned lda);
+/* B = B L^-T, L lower */
+void dense_trsm_rlt(const double *l, unsigned ldl, double *b, unsigned nb, unsigned ldb);
+/* Lower part of C -= A A^T */
+void dense_syrk_ln(const double *a, unsigned lda, double *c, unsigned nb, unsigned ldc);
+/* C -= A B, or C -= A B^T when TRANSB */
+void dense_gemm(int transb, const double *a, unsigned lda, const double *b, unsigned ldb,
+		double *c, unsigned nb, unsigned ldc);
+
+/* A = L U without pivoting, L unit lower. Returns -1 on a zero pivot. */
+int dense_getrf(double *a, unsigned nb, unsigned lda);
+/* B = L^-1 B, L unit lower */
+void dense_trsm_llu(const double *l, unsigned ldl, double *b, unsigned nb, unsigned ldb);
+/* B = B U^-1, U upper */
+void dense_trsm_run(const double *u, unsigned ldu, double *b, unsigned nb, unsigned ldb);
+
+/* Same matrix on every call with the same SEED: symmetric positive
+ * definite, or diagonally dominant so that LU needs no pivoting */
+void dense_fill_spd(double *a, unsigned n, unsigned seed);
+void dense_fill_dd(double *a, unsigned n, unsigned seed);
+
+/* ||A - L L^T|| / ||A|| on the lower parts, and ||A - L U|| / ||A||, in
+ * Frobenius norm, A being the original matrix and F its factorization */
+double dense_check_cholesky(const double *a, const double *f, unsigned n);
+double dense_check_lu(const double *a, const double *f, unsigned n);
+
+/* Register A (n x n) and partition it in nt x nt tiles of nb x nb, tile
+ * (m, k) being starpu_data_get_sub_data(*handle, 2, m, k) */
+void dense_register(starpu_data_handle_t *handle, double *a, unsigned n, unsigned nb);
+void dense_unregister(starpu_data_handle_t handle);
+
+/* A tiled factorization: the driver fills the matrix, calls submit, waits
+ * for all the tasks and reports the GFlop/s of FLOPS(n) per policy */
+struct dense_algo
+{
+	const char *name;
+	double (*flops)(unsigned n);
+	void (*fill)(double *a, unsigned n, unsigned seed);
+	/* Submit the tasks on the nt x nt tiles of HANDLE, with the priorities
+	 * of dense_prio() */
+	int (*submit)(starpu_data_handle_t handle, unsigned nt, unsigned nb);
+	double (*check)(const double *a, const double *f, unsigned n);
+};
+
+/* Priority of the task of step k on tiles (m, j), when run with -prio: its
+ * distance to the end of the DAG, as in the StarPU Cholesky examples
+ * (m = j = k for the diagonal factorization, j = k for the solves). It
+ * gives the reference order of the rank-based policies. */
+int dense_prio(unsigned nt, unsigned k, unsigned m, unsigned j);
+
+int dense_main(int argc, char **argv, const struct dense_algo *algo);
+
+#endif /* __DENSE_H__ */
@@ -0,0 +1,168 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Tiled LU factorization A = L U without pivoting, right looking: at step
+ * k, GETRF of the diagonal tile, TRSM of the tiles of row k (U) and of
+ * column k (L), then GEMM updates of the trailing matrix. The matrix is
+ * diagonally dominant, so no pivoting is needed.
+ */
+
+#include <stdio.h>
+
+#include "dense.h"
+
+#define TILE(h, m, k) starpu_data_get_sub_data(h, 2, m, k)
+
+static void getrf_cpu(void *descr[], void *arg)
+{
+	double *a = (double *) STARPU_MATRIX_GET_PTR(descr[0]);
+	int ret = dense_getrf(a, STARPU_MATRIX_GET_NX(descr[0]), STARPU_MATRIX_GET_LD(descr[0]));
+	STARPU_ASSERT_MSG(ret == 0, "zero pivot");
+}
+
+/* Row k: U(k,m) = L(k,k)^-1 A(k,m) */
+static void trsm_u_cpu(void *descr[], void *arg)
+{
+	dense_trsm_llu((double *) STARPU_MATRIX_GET_PTR(descr[0]), STARPU_MATRIX_GET_LD(descr[0]),
+		       (double *) STARPU_MATRIX_GET_PTR(descr[1]), STARPU_MATRIX_GET_NX(descr[1]),
+		       STARPU_MATRIX_GET_LD(descr[1]));
+}
+
+/* Column k: L(m,k) = A(m,k) U(k,k)^-1 */
+static void trsm_l_cpu(void *descr[], void *arg)
+{
+	dense_trsm_run((double *) STARPU_MATRIX_GET_PTR(descr[0]), STARPU_MATRIX_GET_LD(descr[0]),
+		       (double *) STARPU_MATRIX_GET_PTR(descr[1]), STARPU_MATRIX_GET_NX(descr[1]),
+		       STARPU_MATRIX_GET_LD(descr[1]));
+}
+
+static void gemm_cpu(void *descr[], void *arg)
+{
+	dense_gemm(0, (double *) STARPU_MATRIX_GET_PTR(descr[0]), STARPU_MATRIX_GET_LD(descr[0]),
+		   (double *) STARPU_MATRIX_GET_PTR(descr[1]), STARPU_MATRIX_GET_LD(descr[1]),
+		   (double *) STARPU_MATRIX_GET_PTR(descr[2]), STARPU_MATRIX_GET_NX(descr[2]),
+		   STARPU_MATRIX_GET_LD(descr[2]));
+}
+
+static struct starpu_perfmodel getrf_model = { .type = STARPU_HISTORY_BASED, .symbol = "lu_getrf" };
+static struct starpu_perfmodel trsm_u_model = { .type = STARPU_HISTORY_BASED, .symbol = "lu_trsm_u" };
+static struct starpu_perfmodel trsm_l_model = { .type = STARPU_HISTORY_BASED, .symbol = "lu_trsm_l" };
+static struct starpu_perfmodel gemm_model = { .type = STARPU_HISTORY_BASED, .symbol = "lu_gemm" };
+
+static struct starpu_codelet getrf_cl =
+{
+	.cpu_funcs = {getrf_cpu},
+	.cpu_funcs_name = {"getrf_cpu"},
+	.nbuffers = 1,
+	.modes = {STARPU_RW},
+	.model = &getrf_model,
+	.name = "getrf"
+};
+
+static struct starpu_codelet trsm_u_cl =
+{
+	.cpu_funcs = {trsm_u_cpu},
+	.cpu_funcs_name = {"trsm_u_cpu"},
+	.nbuffers = 2,
+	.modes = {STARPU_R, STARPU_RW},
+	.model = &trsm_u_model,
+	.name = "trsm_u"
+};
+
+static struct starpu_codelet trsm_l_cl =
+{
+	.cpu_funcs = {trsm_l_cpu},
+	.cpu_funcs_name = {"trsm_l_cpu"},
+	.nbuffers = 2,
+	.modes = {STARPU_R, STARPU_RW},
+	.model = &trsm_l_model,
+	.name = "trsm_l"
+};
+
+static struct starpu_codelet gemm_cl =
+{
+	.cpu_funcs = {gemm_cpu},
+	.cpu_funcs_name = {"gemm_cpu"},
+	.nbuffers = 3,
+	.modes = {STARPU_R, STARPU_R, STARPU_RW},
+	.model = &gemm_model,
+	.name = "gemm"
+};
+
+static double lu_flops(unsigned n)
+{
+	return 2.0 * n * n * n / 3.0;
+}
+
+static int lu_submit(starpu_data_handle_t h, unsigned nt, unsigned nb)
+{
+	double tile_flops = (double) nb * nb * nb;
+	unsigned k, m, j;
+	int ret;
+
+	for (k = 0; k < nt; k++)
+	{
+		ret = starpu_task_insert(&getrf_cl,
+					 STARPU_PRIORITY, dense_prio(nt, k, k, k),
+					 STARPU_RW, TILE(h, k, k),
+					 STARPU_FLOPS, 2.0 * tile_flops / 3.0,
+					 0);
+		if (ret)
+			return ret;
+
+		for (m = k + 1; m < nt; m++)
+		{
+			ret = starpu_task_insert(&trsm_u_cl,
+						 STARPU_PRIORITY, dense_prio(nt, k, k, m),
+						 STARPU_R, TILE(h, k, k),
+						 STARPU_RW, TILE(h, k, m),
+						 STARPU_FLOPS, tile_flops,
+						 0);
+			if (ret)
+				return ret;
+			ret = starpu_task_insert(&trsm_l_cl,
+						 STARPU_PRIORITY, dense_prio(nt, k, m, k),
+						 STARPU_R, TILE(h, k, k),
+						 STARPU_RW, TILE(h, m, k),
+						 STARPU_FLOPS, tile_flops,
+						 0);
+			if (ret)
+				return ret;
+		}
+
+		for (m = k + 1; m < nt; m++)
+			for (j = k + 1; j < nt; j++)
+			{
+				ret = starpu_task_insert(&gemm_cl,
+							 STARPU_PRIORITY, dense_prio(nt, k, m, j),
+							 STARPU_R, TILE(h, m, k),
+							 STARPU_R, TILE(h, k, j),
+							 STARPU_RW, TILE(h, m, j),
+							 STARPU_FLOPS, 2.0 * tile_flops,
+							 0);
+				if (ret)
+					return ret;
+			}
+	}
+	return 0;
+}
+
+static const struct dense_algo lu =
+{
+	.name = "lu",
+	.flops = lu_flops,
+	.fill = dense_fill_dd,
+	.submit = lu_submit,
+	.check = dense_check_lu
+};
+
+int main(int argc, char **argv)
+{
+	return dense_main(argc, argv, &lu);
+}
@@ -0,0 +1,691 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Replay of a recorded StarPU run.
+ *
+ * The input is the tasks.rec file written by starpu_fxt_tool: one record per
+ * task, records separated by blank lines, with the fields
+ *   JobId, SubmitOrder, DependsOn	identity, submission order, predecessors
+ *   Name (or Model), Footprint		codelet and task class
+ *   Handles, Modes, Sizes		data accessed, one entry per buffer
+ *   MemoryNode, StartTime, EndTime	where and when it ran, times in ms
+ * Other fields are ignored. DependsOn already includes the implicit data
+ * dependencies, so the replay data handles have no sequential consistency.
+ *
+ * Each recorded codelet becomes a synthetic codelet of the same name, with a
+ * history-based perf model, whose implementations spin for the recorded
+ * duration. A task recorded on a CPU (memory node 0) gives its CPU duration,
+ * on an accelerator its CUDA one; the duration on the other arch is the
+ * average of its class (codelet and footprint), or of its codelet. A codelet
+ * only gets an implementation for the archs it was recorded on. Every
+ * recorded handle becomes a dummy vector of the largest size it was
+ * accessed with.
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <starpu.h>
+
+#include "bench_common.h"
+
+enum replay_arch
+{
+	REPLAY_CPU = 0,
+	REPLAY_CUDA,
+	REPLAY_NARCHS
+};
+
+/* Recorded durations of a codelet or of a task class, in us */
+struct replay_stats
+{
+	double sum[REPLAY_NARCHS];
+	unsigned n[REPLAY_NARCHS];
+};
+
+struct replay_class
+{
+	uint32_t footprint;
+	struct replay_stats stats;
+};
+
+struct replay_codelet
+{
+	char *name;
+	char *symbol;
+	struct replay_stats stats;
+	struct replay_class *classes;
+	unsigned nclasses;
+	struct starpu_perfmodel model;
+	struct starpu_codelet cl;
+};
+
+struct replay_handle
+{
+	unsigned long long addr;
+	size_t size;
+	void *ptr;
+	starpu_data_handle_t handle;
+};
+
+struct replay_task
+{
+	unsigned long job_id;
+	unsigned long submit_order;
+	char *name;
+	uint32_t footprint;
+
+	unsigned nbuffers;
+	unsigned long long *addrs;
+	size_t *sizes;
+	enum starpu_data_access_mode *modes;
+	unsigned *handles;		/* in replay.handles, once loaded */
+
+	unsigned ndeps;
+	unsigned long *deps;
+
+	int memory_node;
+	double start, end;		/* ms, NAN when it did not run */
+
+	/* What the synthetic implementations spin for, in us */
+	double duration[REPLAY_NARCHS];
+	struct replay_codelet *codelet;
+	struct starpu_task *task;
+};
+
+struct replay
+{
+	struct replay_task *tasks;
+	unsigned ntasks;
+	struct replay_codelet *codelets;
+	unsigned ncodelets;
+	struct replay_handle *handles;
+	unsigned nhandles;
+	/* Sorted by job id, for the dependencies */
+	struct replay_task **by_job;
+	double recorded_makespan;	/* ms */
+};
+
+static double replay_scale = 1.0;
+
+static void *replay_grow(void *array, unsigned n, size_t elemsize)
+{
+	/* Doubles the capacity at each power of two */
+	if (n == 0 || (n & (n - 1)) == 0)
+	{
+		array = realloc(array, (n ? 2 * n : 1) * elemsize);
+		STARPU_ASSERT(array);
+	}
+	return array;
+}
+
+/*
+ * Parsing
+ */
+
+static enum starpu_data_access_mode replay_parse_mode(const char *mode)
+{
+	if (strncmp(mode, "SCRATCH", 7) == 0)
+		return STARPU_SCRATCH;
+	if (strncmp(mode, "RW", 2) == 0 || strncmp(mode, "REDUX", 5) == 0)
+		return STARPU_RW;
+	if (mode[0] == 'W')
+		return STARPU_W;
+	if (mode[0] == 'R')
+		return STARPU_R;
+	return STARPU_RW;
+}
+
+/* Parse the space-separated VALUE into a new array of N elements */
+static unsigned replay_parse_list(char *value, void **array, size_t elemsize, int kind)
+{
+	char *saveptr;
+	char *tok;
+	unsigned n = 0;
+
+	*array = NULL;
+	for (tok = strtok_r(value, " \t", &saveptr); tok; tok = strtok_r(NULL, " \t", &saveptr))
+	{
+		*array = replay_grow(*array, n, elemsize);
+		switch (kind)
+		{
+		case 'j':
+			((unsigned long *) *array)[n] = strtoul(tok, NULL, 10);
+			break;
+		case 'a':
+			((unsigned long long *) *array)[n] = strtoull(tok, NULL, 16);
+			break;
+		case 's':
+			((size_t *) *array)[n] = strtoull(tok, NULL, 10);
+			break;
+		default:
+			((enum starpu_data_access_mode *) *array)[n] = replay_parse_mode(tok);
+			break;
+		}
+		n++;
+	}
+	return n;
+}
+
+static void replay_task_init(struct replay_task *rt)
+{
+	memset(rt, 0, sizeof(*rt));
+	rt->job_id = ULONG_MAX;
+	rt->submit_order = ULONG_MAX;
+	rt->start = NAN;
+	rt->end = NAN;
+}
+
+static void replay_task_clean(struct replay_task *rt)
+{
+	free(rt->name);
+	free(rt->addrs);
+	free(rt->sizes);
+	free(rt->modes);
+	free(rt->handles);
+	free(rt->deps);
+}
+
+/* A record is kept when it has a job id and a name; buffer lists are cut to
+ * the shortest of Handles, Modes and Sizes */
+static int replay_task_valid(struct replay_task *rt, unsigned nhandles, unsigned nmodes, unsigned nsizes)
+{
+	if (rt->job_id == ULONG_MAX || rt->name == NULL)
+		return 0;
+	rt->nbuffers = nhandles;
+	if (nmodes < rt->nbuffers)
+		rt->nbuffers = nmodes;
+	if (nsizes < rt->nbuffers)
+		rt->nbuffers = nsizes;
+	if (rt->submit_order == ULONG_MAX)
+		rt->submit_order = rt->job_id;
+	return 1;
+}
+
+static int replay_load(struct replay *r, const char *path)
+{
+	FILE *f = fopen(path, "r");
+	char *line = NULL;
+	size_t len = 0;
+	struct replay_task rt;
+	unsigned nhandles = 0, nmodes = 0, nsizes = 0;
+	int in_record = 0;
+
+	if (!f)
+		return -errno;
+
+	replay_task_init(&rt);
+	for (;;)
+	{
+		ssize_t n = getline(&line, &len, f);
+		if (n > 0 && line[n - 1] == '\n')
+			line[--n] = '\0';
+
+		if (n <= 0)
+		{
+			/* End of a record, or of the file */
+			if (in_record)
+			{
+				if (replay_task_valid(&rt, nhandles, nmodes, nsizes))
+				{
+					r->tasks = replay_grow(r->tasks, r->ntasks, sizeof(*r->tasks));
+					r->tasks[r->ntasks++] = rt;
+				}
+				else
+					replay_task_clean(&rt);
+				replay_task_init(&rt);
+				nhandles = nmodes = nsizes = 0;
+				in_record = 0;
+			}
+			if (n < 0)
+				break;
+			continue;
+		}
+
+		char *value = strchr(line, ':');
+		if (line[0] == '#' || !value)
+			continue;
+		*value++ = '\0';
+		while (isspace((unsigned char) *value))
+			value++;
+		in_record = 1;
+
+		if (strcmp(line, "JobId") == 0)
+			rt.job_id = strtoul(value, NULL, 10);
+		else if (strcmp(line, "SubmitOrder") == 0)
+			rt.submit_order = strtoul(value, NULL, 10);
+		else if (strcmp(line, "Name") == 0 || (strcmp(line, "Model") == 0 && rt.name == NULL))
+		{
+			free(rt.name);
+			rt.name = strdup(value);
+		}
+		else if (strcmp(line, "Footprint") == 0)
+			rt.footprint = strtoul(value, NULL, 16);
+		else if (strcmp(line, "DependsOn") == 0)
+			rt.ndeps = replay_parse_list(value, (void **) &rt.deps, sizeof(*rt.deps), 'j');
+		else if (strcmp(line, "Handles") == 0)
+			nhandles = replay_parse_list(value, (void **) &rt.addrs, sizeof(*rt.addrs), 'a');
+		else if (strcmp(line, "Modes") == 0)
+			nmodes = replay_parse_list(value, (void **) &rt.modes, sizeof(*rt.modes), 'm');
+		else if (strcmp(line, "Sizes") == 0)
+			nsizes = replay_parse_list(value, (void **) &rt.sizes, sizeof(*rt.sizes), 's');
+		else if (strcmp(line, "MemoryNode") == 0)
+			rt.memory_node = atoi(value);
+		else if (strcmp(line, "StartTime") == 0)
+			rt.start = strtod(value, NULL);
+		else if (strcmp(line, "EndTime") == 0)
+			rt.end = strtod(value, NULL);
+	}
+	free(line);
+	fclose(f);
+	return 0;
+}
+
+/*
+ * Tasks, codelets and handles
+ */
+
+static int replay_cmp_submit(const void *a, const void *b)
+{
+	const struct replay_task *ta = a, *tb = b;
+	return (ta->submit_order > tb->submit_order) - (ta->submit_order < tb->submit_order);
+}
+
+static int replay_cmp_job(const void *a, const void *b)
+{
+	const struct replay_task *ta = *(const struct replay_task **) a;
+	const struct replay_task *tb = *(const struct replay_task **) b;
+	return (ta->job_id > tb->job_id) - (ta->job_id < tb->job_id);
+}
+
+static int replay_cmp_handle(const void *a, const void *b)
+{
+	const struct replay_handle *ha = a, *hb = b;
+	return (ha->addr > hb->addr) - (ha->addr < hb->addr);
+}
+
+static struct replay_task *replay_find_job(struct replay *r, unsigned long job_id)
+{
+	struct replay_task key = { .job_id = job_id };
+	struct replay_task *keyp = &key;
+	struct replay_task **found = bsearch(&keyp, r->by_job, r->ntasks, sizeof(*r->by_job), replay_cmp_job);
+	return found ? *found : NULL;
+}
+
+static void replay_kernel(void *descr[] STARPU_ATTRIBUTE_UNUSED, void *arg)
+{
+	struct replay_task *rt = arg;
+	enum replay_arch arch = starpu_worker_get_type(starpu_worker_get_id()) == STARPU_CPU_WORKER ? REPLAY_CPU : REPLAY_CUDA;
+	double end = starpu_timing_now() + rt->duration[arch];
+
+	while (starpu_timing_now() < end)
+		;
+}
+
+static struct replay_codelet *replay_codelet_get(struct replay *r, const char *name)
+{
+	unsigned i;
+
+	for (i = 0; i < r->ncodelets; i++)
+		if (strcmp(r->codelets[i].name, name) == 0)
+			return &r->codelets[i];
+
+	r->codelets = replay_grow(r->codelets, r->ncodelets, sizeof(*r->codelets));
+	struct replay_codelet *c = &r->codelets[r->ncodelets++];
+	memset(c, 0, sizeof(*c));
+	c->name = strdup(name);
+	return c;
+}
+
+static struct replay_class *replay_class_get(struct replay_codelet *c, uint32_t footprint)
+{
+	unsigned i;
+
+	for (i = 0; i < c->nclasses; i++)
+		if (c->classes[i].footprint == footprint)
+			return &c->classes[i];
+
+	c->classes = replay_grow(c->classes, c->nclasses, sizeof(*c->classes));
+	struct replay_class *k = &c->classes[c->nclasses++];
+	memset(k, 0, sizeof(*k));
+	k->footprint = footprint;
+	return k;
+}
+
+static double replay_stats_avg(const struct replay_stats *s, enum replay_arch arch)
+{
+	return s->n[arch] ? s->sum[arch] / s->n[arch] : NAN;
+}
+
+/* Durations of each task on each arch, and the synthetic codelets */
+static void replay_build_codelets(struct replay *r)
+{
+	double first = INFINITY, last = -INFINITY;
+	unsigned i, c;
+	int arch;
+
+	/* Pointers into r->codelets are only taken once it is complete */
+	for (i = 0; i < r->ntasks; i++)
+	{
+		struct replay_task *rt = &r->tasks[i];
+		struct replay_codelet *codelet = replay_codelet_get(r, rt->name);
+		if (isnan(rt->start) || isnan(rt->end))
+			continue;
+
+		arch = rt->memory_node == STARPU_MAIN_RAM ? REPLAY_CPU : REPLAY_CUDA;
+		double duration = 1000.0 * (rt->end - rt->start);
+		struct replay_class *k = replay_class_get(codelet, rt->footprint);
+		k->stats.sum[arch] += duration;
+		k->stats.n[arch]++;
+		codelet->stats.sum[arch] += duration;
+		codelet->stats.n[arch]++;
+		first = STARPU_MIN(first, rt->start);
+		last = STARPU_MAX(last, rt->end);
+	}
+	r->recorded_makespan = last > first ? last - first : NAN;
+
+	for (i = 0; i < r->ntasks; i++)
+	{
+		struct replay_task *rt = &r->tasks[i];
+		struct replay_codelet *codelet = replay_codelet_get(r, rt->name);
+		struct replay_class *k = replay_class_get(codelet, rt->footprint);
+		int recorded = isnan(rt->start) || isnan(rt->end) ? -1
+			: rt->memory_node == STARPU_MAIN_RAM ? REPLAY_CPU : REPLAY_CUDA;
+
+		rt->codelet = codelet;
+		for (arch = 0; arch < REPLAY_NARCHS; arch++)
+		{
+			double duration;
+			if (arch == recorded)
+				duration = 1000.0 * (rt->end - rt->start);
+			else if (k->stats.n[arch])
+				duration = replay_stats_avg(&k->stats, arch);
+			else
+				duration = replay_stats_avg(&codelet->stats, arch);
+			rt->duration[arch] = replay_scale * duration;
+		}
+	}
+
+	for (c = 0; c < r->ncodelets; c++)
+	{
+		struct replay_codelet *codelet = &r->codelets[c];
+		int recorded = codelet->stats.n[REPLAY_CPU] || codelet->stats.n[REPLAY_CUDA];
+
+		if (asprintf(&codelet->symbol, "replay_%s", codelet->name) < 0)
+			codelet->symbol = NULL;
+		codelet->model.type = STARPU_HISTORY_BASED;
+		codelet->model.symbol = codelet->symbol;
+
+		codelet->cl.name = codelet->name;
+		codelet->cl.model = &codelet->model;
+		codelet->cl.nbuffers = STARPU_VARIABLE_NBUFFERS;
+		/* Never ran in the recording: a CPU task of no length */
+		if (codelet->stats.n[REPLAY_CPU] || !recorded)
+			codelet->cl.cpu_funcs[0] = replay_kernel;
+		if (codelet->stats.n[REPLAY_CUDA])
+			codelet->cl.cuda_funcs[0] = replay_kernel;
+	}
+	for (i = 0; i < r->ntasks; i++)
+	{
+		struct replay_task *rt = &r->tasks[i];
+		for (arch = 0; arch < REPLAY_NARCHS; arch++)
+			if (isnan(rt->duration[arch]))
+				rt->duration[arch] = 0.0;
+	}
+}
+
+/* One dummy buffer per recorded handle */
+static void replay_build_handles(struct replay *r)
+{
+	unsigned i, b, n = 0;
+
+	for (i = 0; i < r->ntasks; i++)
+		for (b = 0; b < r->tasks[i].nbuffers; b++)
+		{
+			r->handles = replay_grow(r->handles, n, sizeof(*r->handles));
+			r->handles[n].addr = r->tasks[i].addrs[b];
+			r->handles[n].size = r->tasks[i].sizes[b];
+			n++;
+		}
+
+	/* Unique addresses, with the largest size */
+	qsort(r->handles, n, sizeof(*r->handles), replay_cmp_handle);
+	r->nhandles = 0;
+	for (i = 0; i < n; i++)
+	{
+		if (r->nhandles > 0 && r->handles[r->nhandles - 1].addr == r->handles[i].addr)
+			r->handles[r->nhandles - 1].size = STARPU_MAX(r->handles[r->nhandles - 1].size, r->handles[i].size);
+		else
+			r->handles[r->nhandles++] = r->handles[i];
+	}
+
+	for (i = 0; i < r->nhandles; i++)
+	{
+		struct replay_handle *h = &r->handles[i];
+		h->size = STARPU_MAX(h->size, 1);
+		/* Never written by the kernels, pages are only touched by transfers */
+		h->ptr = malloc(h->size);
+		STARPU_ASSERT(h->ptr);
+	}
+
+	for (i = 0; i < r->ntasks; i++)
+	{
+		struct replay_task *rt = &r->tasks[i];
+		if (rt->nbuffers == 0)
+			continue;
+		rt->handles = malloc(rt->nbuffers * sizeof(*rt->handles));
+		STARPU_ASSERT(rt->handles);
+		for (b = 0; b < rt->nbuffers; b++)
+		{
+			struct replay_handle key = { .addr = rt->addrs[b] };
+			struct replay_handle *h = bsearch(&key, r->handles, r->nhandles, sizeof(*r->handles), replay_cmp_handle);
+			rt->handles[b] = h - r->handles;
+		}
+	}
+}
+
+static int replay_prepare(struct replay *r)
+{
+	unsigned i;
+
+	if (r->ntasks == 0)
+		return -ENOENT;
+
+	qsort(r->tasks, r->ntasks, sizeof(*r->tasks), replay_cmp_submit);
+	r->by_job = malloc(r->ntasks * sizeof(*r->by_job));
+	STARPU_ASSERT(r->by_job);
+	for (i = 0; i < r->ntasks; i++)
+		r->by_job[i] = &r->tasks[i];
+	qsort(r->by_job, r->ntasks, sizeof(*r->by_job), replay_cmp_job);
+
+	replay_build_codelets(r);
+	replay_build_handles(r);
+	return 0;
+}
+
+static void replay_free(struct replay *r)
+{
+	unsigned i;
+
+	for (i = 0; i < r->ntasks; i++)
+		replay_task_clean(&r->tasks[i]);
+	for (i = 0; i < r->ncodelets; i++)
+	{
+		free(r->codelets[i].name);
+		free(r->codelets[i].symbol);
+		free(r->codelets[i].classes);
+	}
+	for (i = 0; i < r->nhandles; i++)
+		free(r->handles[i].ptr);
+	free(r->tasks);
+	free(r->codelets);
+	free(r->handles);
+	free(r->by_job);
+}
+
+/*
+ * Replay under one policy
+ */
+
+/* Whether some worker can run the tasks of CODELET */
+static int replay_codelet_runnable(const struct replay_codelet *codelet)
+{
+	return (codelet->cl.cpu_funcs[0] && starpu_cpu_worker_get_count() > 0)
+		|| (codelet->cl.cuda_funcs[0] && starpu_cuda_worker_get_count() > 0);
+}
+
+static int replay_run(const char *policy, void *arg)
+{
+	struct replay *r = arg;
+	struct starpu_task **deps = NULL;
+	unsigned maxdeps = 0;
+	unsigned i, b, d;
+	int ret = 0;
+
+	/* Before any task exists: once the dependencies are declared, the
+	 * tasks can only be submitted all together */
+	for (i = 0; i < r->ncodelets; i++)
+	{
+		if (!replay_codelet_runnable(&r->codelets[i]))
+		{
+			/* e.g. a CUDA-only recording on a machine without GPU */
+			fprintf(stderr, "%s: no worker for %s\n", policy, r->codelets[i].name);
+			return -ENODEV;
+		}
+	}
+
+	for (i = 0; i < r->nhandles; i++)
+	{
+		struct replay_handle *h = &r->handles[i];
+		starpu_vector_data_register(&h->handle, STARPU_MAIN_RAM, (uintptr_t) h->ptr, h->size, 1);
+		/* DependsOn has them all */
+		starpu_data_set_sequential_consistency_flag(h->handle, 0);
+	}
+
+	/* All the tasks exist before the first submission, dependencies may
+	 * then be declared on any of them */
+	for (i = 0; i < r->ntasks; i++)
+	{
+		struct replay_task *rt = &r->tasks[i];
+		struct starpu_task *task = starpu_task_create();
+
+		task->cl = &rt->codelet->cl;
+		task->cl_arg = rt;
+		task->nbuffers = rt->nbuffers;
+		if (rt->nbuffers > STARPU_NMAXBUFS)
+		{
+			task->dyn_handles = malloc(rt->nbuffers * sizeof(*task->dyn_handles));
+			task->dyn_modes = malloc(rt->nbuffers * sizeof(*task->dyn_modes));
+		}
+		for (b = 0; b < rt->nbuffers; b++)
+		{
+			STARPU_TASK_SET_HANDLE(task, r->handles[rt->handles[b]].handle, b);
+			STARPU_TASK_SET_MODE(task, rt->modes[b], b);
+		}
+		rt->task = task;
+	}
+
+	for (i = 0; i < r->ntasks; i++)
+	{
+		struct replay_task *rt = &r->tasks[i];
+		unsigned ndeps = 0;
+
+		if (rt->ndeps > maxdeps)
+		{
+			maxdeps = rt->ndeps;
+			deps = realloc(deps, maxdeps * sizeof(*deps));
+			STARPU_ASSERT(deps);
+		}
+		for (d = 0; d < rt->ndeps; d++)
+		{
+			/* Predecessors outside of the recording are done */
+			struct replay_task *pred = replay_find_job(r, rt->deps[d]);
+			if (pred && pred != rt)
+				deps[ndeps++] = pred->task;
+		}
+		if (ndeps)
+			starpu_task_declare_deps_array(rt->task, ndeps, deps);
+	}
+	free(deps);
+
+	double start = starpu_timing_now();
+	for (i = 0; i < r->ntasks; i++)
+	{
+		ret = starpu_task_submit(r->tasks[i].task);
+		STARPU_CHECK_RETURN_VALUE(ret, "starpu_task_submit");
+	}
+	starpu_task_wait_for_all();
+	double end = starpu_timing_now();
+
+	for (i = 0; i < r->nhandles; i++)
+		starpu_data_unregister(r->handles[i].handle);
+
+	printf("%-12s %8u %12.1f %12.1f %12.1f\n", policy, r->ntasks, (end - start) / 1000.0,
+	       r->recorded_makespan * replay_scale, 1e6 * r->ntasks / (end - start));
+	return 0;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,"Usage: %s [options...] tasks.rec\n", argv0);
+	fprintf(stderr,"\n");
+	fprintf(stderr,"Options:\n");
+	fprintf(stderr,"-sched <name>[,<name>...]	policies to compare (default $STARPU_SCHED or hratio)\n");
+	fprintf(stderr,"-scale <f>		multiply the recorded durations by f (default 1)\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct replay r;
+	const char *path = NULL;
+	int i, ret;
+
+	bench_parse_policies(&argc, argv);
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-scale") == 0 && i + 1 < argc)
+			replay_scale = strtod(argv[++i], NULL);
+		else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)
+		{
+			usage(argv[0]);
+			return 0;
+		}
+		else
+			path = argv[i];
+	}
+	if (!path || replay_scale < 0.0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	memset(&r, 0, sizeof(r));
+	ret = replay_load(&r, path);
+	if (ret == 0)
+		ret = replay_prepare(&r);
+	if (ret)
+	{
+		fprintf(stderr, "%s: %s\n", path, ret == -ENOENT ? "no task record" : strerror(-ret));
+		replay_free(&r);
+		return 1;
+	}
+	fprintf(stderr, "%u tasks of %u codelets on %u data handles\n", r.ntasks, r.ncodelets, r.nhandles);
+
+	printf("%-12s %8s %12s %12s %12s\n", "policy", "tasks", "time_ms", "recorded_ms", "tasks/s");
+	ret = bench_for_each_policy(replay_run, &r);
+
+	replay_free(&r);
+	return ret;
+}
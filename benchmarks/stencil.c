@@ -0,0 +1,387 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Iterative Jacobi stencil on a 2-D (5 points) or 3-D (7 points) grid.
+ *
+ * The grid is a stack of planes (lines of size points in 2-D, size x size
+ * planes in 3-D), split along the stack into tiles of whole planes with a
+ * starpu_data_filter, as test-pi/pi.c splits its counters. Two copies of
+ * the grid alternate between the iterations. Each tile also has two halo
+ * handles, its first and last planes, written by its update along with the
+ * tile: the update of tile i at an iteration reads tile i, the last plane of
+ * tile i-1 and the first plane of tile i+1 of the previous one. The halos
+ * are double-buffered too, so only they move between neighbours, and a
+ * tile only moves when the policy runs it elsewhere.
+ *
+ * The bottom of the grid is held at 1, the other borders at 0.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <starpu.h>
+
+#include "bench_common.h"
+
+static unsigned dim = 2;
+static unsigned size;
+static unsigned ntiles = 16;
+static unsigned niter = 50;
+
+/* Points of a plane: nx x ny, ny being 1 in 2-D */
+static unsigned nx, ny;
+
+struct stencil_tile
+{
+	/* Memory node of the last update, and how many times it changed */
+	int node;
+	unsigned moves;
+};
+
+struct stencil
+{
+	double *grid[2];
+	starpu_data_handle_t grid_handle[2];
+	double *halo[2][2];		/* [copy][lo/hi], ntiles planes each */
+	starpu_data_handle_t *halo_handle[2][2];
+	double *border[2];		/* hot bottom, cold top */
+	starpu_data_handle_t border_handle[2];
+	struct stencil_tile *tiles;
+};
+
+static size_t stencil_plane_size(void)
+{
+	return (size_t) nx * ny;
+}
+
+static void stencil_track(struct stencil_tile *t)
+{
+	int node = starpu_worker_get_memory_node(starpu_worker_get_id());
+	/* Updates of a tile are serialized by their dependencies */
+	if (t->node >= 0 && t->node != node)
+		t->moves++;
+	t->node = node;
+}
+
+static void stencil_plane(const double *prev, const double *cur, const double *next, double *out)
+{
+	double inv = ny > 1 ? 1.0 / 7.0 : 1.0 / 5.0;
+	unsigned x, y;
+
+	for (y = 0; y < ny; y++)
+	{
+		const double *c = cur + (size_t) y * nx;
+		const double *p = prev + (size_t) y * nx;
+		const double *n = next + (size_t) y * nx;
+		double *o = out + (size_t) y * nx;
+		for (x = 0; x < nx; x++)
+		{
+			double s = c[x] + p[x] + n[x];
+			if (x > 0)
+				s += c[x - 1];
+			if (x + 1 < nx)
+				s += c[x + 1];
+			if (y > 0)
+				s += c[(long) x - nx];
+			if (y + 1 < ny)
+				s += c[x + nx];
+			o[x] = s * inv;
+		}
+	}
+}
+
+/* Buffers: tile, halo below, halo above (R), next tile, its first and last
+ * planes (W) */
+static void stencil_cpu(void *descr[], void *arg)
+{
+	size_t plane = stencil_plane_size();
+	const double *cur = (double *) STARPU_VECTOR_GET_PTR(descr[0]);
+	const double *below = (double *) STARPU_VECTOR_GET_PTR(descr[1]);
+	const double *above = (double *) STARPU_VECTOR_GET_PTR(descr[2]);
+	double *next = (double *) STARPU_VECTOR_GET_PTR(descr[3]);
+	unsigned nplanes = STARPU_VECTOR_GET_NX(descr[0]);
+	unsigned p;
+
+	stencil_track(arg);
+	for (p = 0; p < nplanes; p++)
+		stencil_plane(p ? cur + (p - 1) * plane : below,
+			      cur + p * plane,
+			      p + 1 < nplanes ? cur + (p + 1) * plane : above,
+			      next + p * plane);
+	memcpy((double *) STARPU_VECTOR_GET_PTR(descr[4]), next, plane * sizeof(double));
+	memcpy((double *) STARPU_VECTOR_GET_PTR(descr[5]), next + (nplanes - 1) * plane, plane * sizeof(double));
+}
+
+#if defined(STARPU_USE_CUDA) && defined(BENCH_USE_CUDA)
+void stencil_cuda_update(const double *cur, const double *below, const double *above, double *next,
+			 unsigned nplanes, unsigned nx, unsigned ny, cudaStream_t stream);
+
+static void stencil_cuda(void *descr[], void *arg)
+{
+	size_t plane = stencil_plane_size();
+	double *next = (double *) STARPU_VECTOR_GET_PTR(descr[3]);
+	unsigned nplanes = STARPU_VECTOR_GET_NX(descr[0]);
+	cudaStream_t stream = starpu_cuda_get_local_stream();
+
+	stencil_track(arg);
+	stencil_cuda_update((double *) STARPU_VECTOR_GET_PTR(descr[0]),
+			    (double *) STARPU_VECTOR_GET_PTR(descr[1]),
+			    (double *) STARPU_VECTOR_GET_PTR(descr[2]),
+			    next, nplanes, nx, ny, stream);
+	cudaMemcpyAsync((double *) STARPU_VECTOR_GET_PTR(descr[4]), next,
+			plane * sizeof(double), cudaMemcpyDeviceToDevice, stream);
+	cudaMemcpyAsync((double *) STARPU_VECTOR_GET_PTR(descr[5]), next + (nplanes - 1) * plane,
+			plane * sizeof(double), cudaMemcpyDeviceToDevice, stream);
+}
+#endif
+
+static struct starpu_perfmodel stencil_model =
+{
+	.type = STARPU_HISTORY_BASED
+};
+
+static struct starpu_codelet stencil_cl =
+{
+	.cpu_funcs = {stencil_cpu},
+	.cpu_funcs_name = {"stencil_cpu"},
+#if defined(STARPU_USE_CUDA) && defined(BENCH_USE_CUDA)
+	.cuda_funcs = {stencil_cuda},
+	.cuda_flags = {STARPU_CUDA_ASYNC},
+#endif
+	.nbuffers = 6,
+	.modes = {STARPU_R, STARPU_R, STARPU_R, STARPU_W, STARPU_W, STARPU_W},
+	.model = &stencil_model,
+	.name = "jacobi"
+};
+
+/*
+ * Data
+ */
+
+static void stencil_register(struct stencil *s)
+{
+	size_t plane = stencil_plane_size();
+	unsigned planes = size;
+	unsigned c, side, i;
+
+	/* Vectors of planes: the filter cuts between planes */
+	struct starpu_data_filter f =
+	{
+		.filter_func = starpu_vector_filter_block,
+		.nchildren = ntiles
+	};
+
+	for (c = 0; c < 2; c++)
+	{
+		starpu_malloc((void **) &s->grid[c], plane * planes * sizeof(double));
+		STARPU_ASSERT(s->grid[c]);
+		memset(s->grid[c], 0, plane * planes * sizeof(double));
+		starpu_vector_data_register(&s->grid_handle[c], STARPU_MAIN_RAM, (uintptr_t) s->grid[c],
+					    planes, plane * sizeof(double));
+		starpu_data_partition(s->grid_handle[c], &f);
+
+		for (side = 0; side < 2; side++)
+		{
+			starpu_malloc((void **) &s->halo[c][side], plane * ntiles * sizeof(double));
+			STARPU_ASSERT(s->halo[c][side]);
+			memset(s->halo[c][side], 0, plane * ntiles * sizeof(double));
+			s->halo_handle[c][side] = malloc(ntiles * sizeof(starpu_data_handle_t));
+			STARPU_ASSERT(s->halo_handle[c][side]);
+			for (i = 0; i < ntiles; i++)
+				starpu_vector_data_register(&s->halo_handle[c][side][i], STARPU_MAIN_RAM,
+							    (uintptr_t) (s->halo[c][side] + i * plane), plane, sizeof(double));
+		}
+	}
+
+	for (side = 0; side < 2; side++)
+	{
+		unsigned p;
+		starpu_malloc((void **) &s->border[side], plane * sizeof(double));
+		STARPU_ASSERT(s->border[side]);
+		for (p = 0; p < plane; p++)
+			s->border[side][p] = side == 0 ? 1.0 : 0.0;
+		starpu_vector_data_register(&s->border_handle[side], STARPU_MAIN_RAM, (uintptr_t) s->border[side],
+					    plane, sizeof(double));
+	}
+
+	s->tiles = malloc(ntiles * sizeof(*s->tiles));
+	STARPU_ASSERT(s->tiles);
+	for (i = 0; i < ntiles; i++)
+	{
+		s->tiles[i].node = -1;
+		s->tiles[i].moves = 0;
+	}
+}
+
+static void stencil_unregister(struct stencil *s)
+{
+	unsigned c, side, i;
+
+	for (c = 0; c < 2; c++)
+	{
+		starpu_data_unpartition(s->grid_handle[c], STARPU_MAIN_RAM);
+		starpu_data_unregister(s->grid_handle[c]);
+		for (side = 0; side < 2; side++)
+		{
+			for (i = 0; i < ntiles; i++)
+				starpu_data_unregister(s->halo_handle[c][side][i]);
+			free(s->halo_handle[c][side]);
+		}
+	}
+	for (side = 0; side < 2; side++)
+		starpu_data_unregister(s->border_handle[side]);
+}
+
+static void stencil_free(struct stencil *s)
+{
+	unsigned c, side;
+
+	for (c = 0; c < 2; c++)
+	{
+		starpu_free(s->grid[c]);
+		for (side = 0; side < 2; side++)
+			starpu_free(s->halo[c][side]);
+	}
+	for (side = 0; side < 2; side++)
+		starpu_free(s->border[side]);
+	free(s->tiles);
+}
+
+/* Bytes moved on all the buses since profiling was enabled */
+static unsigned long long stencil_transferred(void)
+{
+	unsigned long long bytes = 0;
+	int busid, nbus = starpu_bus_get_count();
+
+	for (busid = 0; busid < nbus; busid++)
+	{
+		struct starpu_profiling_bus_info info;
+		if (starpu_bus_get_profiling_info(busid, &info) == 0)
+			bytes += info.transferred_bytes;
+	}
+	return bytes;
+}
+
+/*
+ * Driver
+ */
+
+static int stencil_run(const char *policy, void *arg)
+{
+	struct stencil s;
+	unsigned it, i;
+	int ret = 0;
+
+	memset(&s, 0, sizeof(s));
+	stencil_register(&s);
+	starpu_profiling_status_set(STARPU_PROFILING_ENABLE);
+
+	double start = starpu_timing_now();
+	for (it = 0; it < niter && ret == 0; it++)
+	{
+		unsigned src = it % 2, dst = 1 - src;
+		for (i = 0; i < ntiles; i++)
+		{
+			struct starpu_task *task = starpu_task_create();
+
+			task->cl = &stencil_cl;
+			task->cl_arg = &s.tiles[i];
+			task->handles[0] = starpu_data_get_sub_data(s.grid_handle[src], 1, i);
+			task->handles[1] = i > 0 ? s.halo_handle[src][1][i - 1] : s.border_handle[0];
+			task->handles[2] = i + 1 < ntiles ? s.halo_handle[src][0][i + 1] : s.border_handle[1];
+			task->handles[3] = starpu_data_get_sub_data(s.grid_handle[dst], 1, i);
+			task->handles[4] = s.halo_handle[dst][0][i];
+			task->handles[5] = s.halo_handle[dst][1][i];
+
+			ret = starpu_task_submit(task);
+			if (ret)
+			{
+				starpu_task_destroy(task);
+				break;
+			}
+		}
+	}
+	starpu_task_wait_for_all();
+	double end = starpu_timing_now();
+	unsigned long long bytes = stencil_transferred();
+	starpu_profiling_status_set(STARPU_PROFILING_DISABLE);
+	stencil_unregister(&s);
+
+	if (ret == 0)
+	{
+		double timing = end - start;
+		double cells = (double) stencil_plane_size() * size * niter;
+		double checksum = 0.0;
+		unsigned moves = 0;
+		size_t p, n = stencil_plane_size() * size;
+
+		/* Same for all the policies */
+		for (p = 0; p < n; p++)
+			checksum += s.grid[niter % 2][p];
+		for (i = 0; i < ntiles; i++)
+			moves += s.tiles[i].moves;
+
+		printf("%-12s %3u %6u %5u %5u %12.1f %10.1f %12.1f %6u %14.6e\n", policy, dim, size, ntiles, niter,
+		       timing / 1000.0, cells / timing, bytes / 1e6, moves, checksum);
+	}
+	stencil_free(&s);
+	return ret;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,"Usage: %s [options...]\n", argv0);
+	fprintf(stderr,"\n");
+	fprintf(stderr,"Options:\n");
+	fprintf(stderr,"-sched <name>[,<name>...]	policies to compare (default $STARPU_SCHED or hratio)\n");
+	fprintf(stderr,"-dim <2|3>		grid dimension (default 2)\n");
+	fprintf(stderr,"-size <n>		points per dimension (default 4096 in 2-D, 256 in 3-D)\n");
+	fprintf(stderr,"-tiles <n>		number of tiles, dividing the size (default 16)\n");
+	fprintf(stderr,"-iter <n>		number of iterations (default 50)\n");
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	bench_parse_policies(&argc, argv);
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-dim") == 0 && i + 1 < argc)
+			dim = strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-size") == 0 && i + 1 < argc)
+			size = strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-tiles") == 0 && i + 1 < argc)
+			ntiles = strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-iter") == 0 && i + 1 < argc)
+			niter = strtoul(argv[++i], NULL, 10);
+		else
+		{
+			usage(argv[0]);
+			return strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0 ? 0 : 1;
+		}
+	}
+	if (size == 0)
+		size = dim == 2 ? 4096 : 256;
+	if ((dim != 2 && dim != 3) || ntiles == 0 || size % ntiles || niter == 0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	nx = size;
+	ny = dim == 2 ? 1 : size;
+	stencil_model.symbol = dim == 2 ? "stencil_jacobi2d" : "stencil_jacobi3d";
+
+	fprintf(stderr, "%u-D grid of %u^%u points in %u tiles, %u iterations\n", dim, size, dim, ntiles, niter);
+	printf("%-12s %3s %6s %5s %5s %12s %10s %12s %6s %14s\n", "policy", "dim", "size", "tiles", "iter",
+	       "time_ms", "Mcells/s", "transfer_MB", "moves", "checksum");
+	return bench_for_each_policy(stencil_run, NULL);
+}
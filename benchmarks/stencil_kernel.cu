@@ -0,0 +1,53 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/* CUDA implementation of the Jacobi update of stencil.c: one thread per
+ * point of the tile */
+
+#include <starpu.h>
+
+#define THREADSPERBLOCK	256
+
+static __global__ void jacobi(const double *cur, const double *below, const double *above, double *next,
+			      unsigned nplanes, unsigned nx, unsigned ny)
+{
+	size_t plane = (size_t) nx * ny;
+	size_t i = blockIdx.x * (size_t) blockDim.x + threadIdx.x;
+	if (i >= plane * nplanes)
+		return;
+
+	unsigned p = i / plane;
+	unsigned y = (i % plane) / nx;
+	unsigned x = i % nx;
+	const double *c = cur + i;
+	double s = *c;
+
+	s += p > 0 ? c[-(long) plane] : below[i % plane];
+	s += p + 1 < nplanes ? c[plane] : above[i % plane];
+	if (x > 0)
+		s += c[-1];
+	if (x + 1 < nx)
+		s += c[1];
+	if (y > 0)
+		s += c[-(long) nx];
+	if (y + 1 < ny)
+		s += c[nx];
+	next[i] = s * (ny > 1 ? 1.0 / 7.0 : 1.0 / 5.0);
+}
+
+extern "C" void stencil_cuda_update(const double *cur, const double *below, const double *above, double *next,
+				    unsigned nplanes, unsigned nx, unsigned ny, cudaStream_t stream)
+{
+	size_t n = (size_t) nx * ny * nplanes;
+	unsigned nblocks = (n + THREADSPERBLOCK - 1) / THREADSPERBLOCK;
+
+	jacobi<<<nblocks, THREADSPERBLOCK, 0, stream>>>(cur, below, above, next, nplanes, nx, ny);
+	cudaError_t status = cudaGetLastError();
+	if (status != cudaSuccess)
+		STARPU_CUDA_REPORT_ERROR(status);
+}
@@ -0,0 +1,418 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Open-loop streaming benchmark.
+ *
+ * Requests arrive on a schedule that does not depend on their completion:
+ * Poisson arrivals at the target rate, or the arrival times of a trace file
+ * scaled to it. Each request is one task of a synthetic codelet spinning for
+ * its work, shorter on CUDA workers by -speedup. The submit to completion
+ * latency of each request is taken by its callback.
+ *
+ * With -deadline, each request must complete within that time of its
+ * submission. The deadline is given to the H-Ratio policy (see hr_sched.h)
+ * and the fraction of requests missing it is reported for every policy.
+ *
+ * With -sweep, the rate doubles from -rate until the policy saturates, then
+ * the saturation point is bisected. A rate saturates when the requests
+ * complete at less than 95% of the rate they arrive at: the queues grow
+ * without bound.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <starpu.h>
+
+#include "bench_common.h"
+#include "hr_sched.h"
+
+#define STREAM_SATURATED 0.95
+#define STREAM_BISECTIONS 3
+#define STREAM_MAXDOUBLINGS 20
+
+static double rate = 1000.0;		/* requests/s */
+static unsigned ntasks = 2000;
+static double work = 200.0;		/* us */
+static double speedup = 4.0;
+static double warmup = 0.1;
+static double deadline;		/* us after submission, 0 for none */
+static int sweep;
+static const char *trace_path;
+
+/* Arrivals of the trace, in us from the first, and their work when given */
+static double *trace_time;
+static double *trace_work;
+static unsigned trace_len;
+
+struct stream_req
+{
+	double work;
+	double submit;
+	double end;
+	double deadline;
+};
+
+struct stream_result
+{
+	double offered;
+	double achieved;
+	double p50, p99, p999;
+	double missed;			/* fraction */
+};
+
+static void stream_kernel(void *descr[] STARPU_ATTRIBUTE_UNUSED, void *arg)
+{
+	struct stream_req *req = arg;
+	double duration = req->work;
+	if (starpu_worker_get_type(starpu_worker_get_id()) != STARPU_CPU_WORKER)
+		duration /= speedup;
+
+	double end = starpu_timing_now() + duration;
+	while (starpu_timing_now() < end)
+		;
+}
+
+static void stream_done(void *arg)
+{
+	struct stream_req *req = arg;
+	req->end = starpu_timing_now();
+}
+
+/* The footprint is the work, so that the history tells requests apart */
+static size_t stream_size_base(struct starpu_task *task, unsigned nimpl)
+{
+	struct stream_req *req = task->cl_arg;
+	return (size_t) req->work;
+}
+
+static uint32_t stream_footprint(struct starpu_task *task)
+{
+	return starpu_hash_crc32c_be((uint32_t) stream_size_base(task, 0), 0);
+}
+
+static struct starpu_perfmodel stream_model =
+{
+	.type = STARPU_HISTORY_BASED,
+	.size_base = stream_size_base,
+	.footprint = stream_footprint,
+	.symbol = "stream_request"
+};
+
+static struct starpu_codelet stream_cl =
+{
+	.cpu_funcs = {stream_kernel},
+	.cpu_funcs_name = {"stream_kernel"},
+	/* Spins on the host too, for the time the device would take */
+	.cuda_funcs = {stream_kernel},
+	.nbuffers = 0,
+	.model = &stream_model,
+	.name = "request"
+};
+
+/*
+ * Arrivals
+ */
+
+static int stream_load_trace(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	double t, w;
+	char line[256];
+
+	if (!f)
+		return -errno;
+	while (fgets(line, sizeof(line), f))
+	{
+		int n = sscanf(line, "%lf %lf", &t, &w);
+		if (line[0] == '#' || n < 1)
+			continue;
+		if ((trace_len & (trace_len - 1)) == 0)
+		{
+			trace_time = realloc(trace_time, (trace_len ? 2 * trace_len : 1) * sizeof(*trace_time));
+			trace_work = realloc(trace_work, (trace_len ? 2 * trace_len : 1) * sizeof(*trace_work));
+			STARPU_ASSERT(trace_time && trace_work);
+		}
+		/* Times in ms */
+		trace_time[trace_len] = 1000.0 * t;
+		trace_work[trace_len] = n > 1 ? w : work;
+		trace_len++;
+	}
+	fclose(f);
+	if (trace_len < 2)
+		return -ENOENT;
+
+	unsigned i;
+	for (i = trace_len; i-- > 0; )
+		trace_time[i] -= trace_time[0];
+	return 0;
+}
+
+/* Arrival of each request, in us from the first, at RATE requests/s. The
+ * Poisson arrivals are the same for every policy. */
+static void stream_arrivals(struct stream_req *reqs, double *arrival, unsigned n, double r)
+{
+	unsigned i;
+
+	if (trace_len)
+	{
+		/* Scale the trace to the rate, replaying it as needed */
+		double period = trace_time[trace_len - 1] * trace_len / (trace_len - 1);
+		double scale = (trace_len - 1) / (trace_time[trace_len - 1] / 1e6) / r;
+		for (i = 0; i < n; i++)
+		{
+			arrival[i] = scale * ((i / trace_len) * period + trace_time[i % trace_len]);
+			reqs[i].work = trace_work[i % trace_len];
+		}
+		return;
+	}
+
+	unsigned short seed[3] = {1, 2, 3};
+	double t = 0.0;
+	for (i = 0; i < n; i++)
+	{
+		arrival[i] = t;
+		reqs[i].work = work;
+		t += -log(1.0 - erand48(seed)) / r * 1e6;
+	}
+}
+
+static void stream_wait_until(double t)
+{
+	double now = starpu_timing_now();
+
+	/* Sleep when far, spin the last 100 us */
+	if (t - now > 200.0)
+	{
+		double us = t - now - 100.0;
+		struct timespec ts = { .tv_sec = us / 1e6, .tv_nsec = fmod(us, 1e6) * 1000.0 };
+		nanosleep(&ts, NULL);
+	}
+	while (starpu_timing_now() < t)
+		;
+}
+
+/*
+ * Runs
+ */
+
+static int stream_cmp_double(const void *a, const void *b)
+{
+	double da = *(const double *) a, db = *(const double *) b;
+	return (da > db) - (da < db);
+}
+
+static double stream_percentile(const double *sorted, unsigned n, double q)
+{
+	unsigned i = (unsigned) ceil(q * n);
+	return sorted[i ? i - 1 : 0];
+}
+
+/* Submit ntasks requests at rate R, wait for them all */
+static int stream_rate(double r, struct stream_result *res)
+{
+	struct stream_req *reqs = calloc(ntasks, sizeof(*reqs));
+	double *arrival = malloc(ntasks * sizeof(*arrival));
+	unsigned i, first, n;
+	int ret = 0;
+
+	STARPU_ASSERT(reqs && arrival);
+	stream_arrivals(reqs, arrival, ntasks, r);
+
+	double start = starpu_timing_now();
+	for (i = 0; i < ntasks; i++)
+	{
+		struct starpu_task *task = starpu_task_create();
+
+		task->cl = &stream_cl;
+		task->cl_arg = &reqs[i];
+		task->callback_func = stream_done;
+		task->callback_arg = &reqs[i];
+
+		stream_wait_until(start + arrival[i]);
+		reqs[i].submit = starpu_timing_now();
+		if (deadline > 0.0)
+		{
+			/* Tasks go to the initial context 0; other policies
+			 * ignore the deadline, it is still checked */
+			reqs[i].deadline = reqs[i].submit + deadline;
+			hr_sched_set_deadline(0, task, reqs[i].deadline);
+		}
+		ret = starpu_task_submit(task);
+		if (ret)
+		{
+			if (deadline > 0.0)
+				hr_sched_clear_deadline(0, task);
+			starpu_task_destroy(task);
+			break;
+		}
+	}
+	starpu_task_wait_for_all();
+
+	if (ret == 0)
+	{
+		/* The first requests meet an empty machine */
+		first = ntasks * warmup;
+		n = ntasks - first;
+		double last_end = 0.0;
+		unsigned missed = 0;
+		for (i = first; i < ntasks; i++)
+		{
+			arrival[i - first] = reqs[i].end - reqs[i].submit;
+			last_end = STARPU_MAX(last_end, reqs[i].end);
+			if (deadline > 0.0 && reqs[i].end > reqs[i].deadline)
+				missed++;
+		}
+		res->missed = (double) missed / n;
+		qsort(arrival, n, sizeof(*arrival), stream_cmp_double);
+
+		res->offered = (n - 1) / ((reqs[ntasks - 1].submit - reqs[first].submit) / 1e6);
+		res->achieved = n / ((last_end - reqs[first].submit) / 1e6);
+		res->p50 = stream_percentile(arrival, n, 0.50);
+		res->p99 = stream_percentile(arrival, n, 0.99);
+		res->p999 = stream_percentile(arrival, n, 0.999);
+	}
+	free(arrival);
+	free(reqs);
+	return ret;
+}
+
+static int stream_saturated(const struct stream_result *res)
+{
+	return res->achieved < STREAM_SATURATED * res->offered;
+}
+
+static int stream_report(const char *policy, double r)
+{
+	struct stream_result res;
+	int ret = stream_rate(r, &res);
+
+	if (ret)
+		return ret;
+	printf("%-12s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f", policy, r, res.offered, res.achieved,
+	       res.p50, res.p99, res.p999);
+	if (deadline > 0.0)
+		printf(" %8.2f", 100.0 * res.missed);
+	printf(" %s\n", stream_saturated(&res) ? "saturated" : "");
+	fflush(stdout);
+	return stream_saturated(&res);
+}
+
+static int stream_run(const char *policy, void *arg)
+{
+	double ok = 0.0, sat = rate;
+	int ret, i;
+
+	ret = stream_report(policy, rate);
+	if (ret < 0 || !sweep)
+		return ret < 0 ? ret : 0;
+
+	/* Doubling up to the first saturated rate */
+	for (i = 0; ret == 0 && i < STREAM_MAXDOUBLINGS; i++)
+	{
+		ok = sat;
+		sat *= 2.0;
+		ret = stream_report(policy, sat);
+	}
+	if (ret < 0)
+		return ret;
+	if (ret == 0)
+	{
+		printf("%-12s not saturated at %.1f requests/s\n", policy, sat);
+		return 0;
+	}
+
+	/* Then between the last sustained rate and it */
+	for (i = 0; i < STREAM_BISECTIONS && ok > 0.0; i++)
+	{
+		double mid = (ok + sat) / 2.0;
+		ret = stream_report(policy, mid);
+		if (ret < 0)
+			return ret;
+		if (ret)
+			sat = mid;
+		else
+			ok = mid;
+	}
+	printf("%-12s sustains %.1f requests/s, saturated at %.1f\n", policy, ok, sat);
+	return 0;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,"Usage: %s [options...]\n", argv0);
+	fprintf(stderr,"\n");
+	fprintf(stderr,"Options:\n");
+	fprintf(stderr,"-sched <name>[,<name>...]	policies to compare (default $STARPU_SCHED or hratio)\n");
+	fprintf(stderr,"-rate <r>		arrival rate in requests/s (default 1000)\n");
+	fprintf(stderr,"-ntasks <n>		requests per rate (default 2000)\n");
+	fprintf(stderr,"-work <us>		work of a request on a CPU (default 200)\n");
+	fprintf(stderr,"-speedup <f>		CUDA workers do it f times faster (default 4)\n");
+	fprintf(stderr,"-trace <file>		arrival times in ms, and optionally work in us, one request per line\n");
+	fprintf(stderr,"-deadline <us>		deadline of each request after its submission (default none)\n");
+	fprintf(stderr,"-warmup <f>		fraction of the requests left out of the statistics (default 0.1)\n");
+	fprintf(stderr,"-sweep			double the rate until saturation, then bisect\n");
+}
+
+int main(int argc, char **argv)
+{
+	int i, ret;
+
+	bench_parse_policies(&argc, argv);
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-rate") == 0 && i + 1 < argc)
+			rate = strtod(argv[++i], NULL);
+		else if (strcmp(argv[i], "-ntasks") == 0 && i + 1 < argc)
+			ntasks = strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-work") == 0 && i + 1 < argc)
+			work = strtod(argv[++i], NULL);
+		else if (strcmp(argv[i], "-speedup") == 0 && i + 1 < argc)
+			speedup = strtod(argv[++i], NULL);
+		else if (strcmp(argv[i], "-trace") == 0 && i + 1 < argc)
+			trace_path = argv[++i];
+		else if (strcmp(argv[i], "-deadline") == 0 && i + 1 < argc)
+			deadline = strtod(argv[++i], NULL);
+		else if (strcmp(argv[i], "-warmup") == 0 && i + 1 < argc)
+			warmup = strtod(argv[++i], NULL);
+		else if (strcmp(argv[i], "-sweep") == 0)
+			sweep = 1;
+		else
+		{
+			usage(argv[0]);
+			return strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0 ? 0 : 1;
+		}
+	}
+	if (rate <= 0.0 || speedup <= 0.0 || warmup < 0.0 || warmup >= 1.0 || ntasks * (1.0 - warmup) < 2)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	if (trace_path)
+	{
+		ret = stream_load_trace(trace_path);
+		if (ret)
+		{
+			fprintf(stderr, "%s: %s\n", trace_path, ret == -ENOENT ? "less than two arrivals" : strerror(-ret));
+			return 1;
+		}
+	}
+
+	printf("%-12s %10s %10s %10s %10s %10s %10s%s\n", "policy", "rate", "offered/s", "achieved/s",
+	       "p50_us", "p99_us", "p99.9_us", deadline > 0.0 ? "   missed%" : "");
+	ret = bench_for_each_policy(stream_run, NULL);
+
+	free(trace_time);
+	free(trace_work);
+	return ret;
+}
@@ -0,0 +1,25 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/* Mock of the StarPU internal helpers used by the policies */
+
+#ifndef __MOCK_COMMON_UTILS_H__
+#define __MOCK_COMMON_UTILS_H__
+
+#include <starpu.h>
+
+#define _STARPU_IS_ZERO(a)	(fpclassify(a) == FP_ZERO)
+#define _STARPU_DISP(fmt, ...)	fprintf(stderr, "[starpu] " fmt, ## __VA_ARGS__)
+#define _STARPU_MSG(fmt, ...)	fprintf(stderr, "[starpu] " fmt, ## __VA_ARGS__)
+#define _STARPU_DEBUG(fmt, ...)	do { } while (0)
+
+#define _STARPU_MALLOC(ptr, size) do { ptr = malloc(size); STARPU_ASSERT(ptr != NULL); } while (0)
+#define _STARPU_CALLOC(ptr, nmemb, size) do { ptr = calloc(nmemb, size); STARPU_ASSERT(ptr != NULL); } while (0)
+#define _STARPU_REALLOC(ptr, size) do { ptr = realloc(ptr, size); STARPU_ASSERT(ptr != NULL); } while (0)
+
+#endif /* __MOCK_COMMON_UTILS_H__ */
@@ -0,0 +1,16 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/* Nothing of this StarPU internal header is used besides common/utils.h */
+
+#ifndef __MOCK_CORE_DEBUG_H__
+#define __MOCK_CORE_DEBUG_H__
+
+#include <common/utils.h>
+
+#endif /* __MOCK_CORE_DEBUG_H__ */
@@ -0,0 +1,18 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/* StarPU reaches the data internals from here */
+
+#ifndef __MOCK_CORE_TASK_H__
+#define __MOCK_CORE_TASK_H__
+
+#include <common/utils.h>
+
+size_t _starpu_data_get_size(starpu_data_handle_t handle);
+
+#endif /* __MOCK_CORE_TASK_H__ */
@@ -0,0 +1,989 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <starpu.h>
+#include <common/utils.h>
+#include <sched_policies/fifo_queues.h>
+#include <sched_policies/detect_combined_workers.h>
+
+#include "mock_starpu.h"
+
+struct mock_worker
+{
+	enum starpu_worker_archtype type;
+	unsigned memory_node;
+	struct starpu_perfmodel_device device;
+	struct starpu_perfmodel_arch arch;
+	starpu_pthread_mutex_t sched_mutex;
+	starpu_pthread_cond_t sched_cond;
+};
+
+struct mock_combined
+{
+	int size;
+	int members[STARPU_NMAXWORKERS];
+	struct starpu_perfmodel_device device;
+	struct starpu_perfmodel_arch arch;
+};
+
+struct mock_ctx
+{
+	int used;
+	struct starpu_sched_policy *policy;
+	void *policy_data;
+	struct starpu_worker_collection *collection;
+	int min_priority, max_priority;
+	int min_priority_set, max_priority_set;
+};
+
+/* Private part of a task, starpu_private */
+struct mock_job
+{
+	unsigned long id;
+	unsigned impl;
+	unsigned nsuccs;
+	unsigned maxsuccs;
+	struct starpu_task **succs;
+};
+
+struct _starpu_data_state
+{
+	size_t size;
+};
+
+static struct mock_worker workers[STARPU_NMAXWORKERS];
+static unsigned nworkers;
+static struct starpu_perfmodel_device cpu_device = { STARPU_CPU_WORKER, 0, 1 };
+static struct starpu_perfmodel_arch cpu_arch = { 1, &cpu_device };
+
+static struct mock_combined combined[STARPU_NMAX_COMBINEDWORKERS];
+static unsigned ncombined;
+static unsigned combined_size;
+
+static struct mock_ctx ctxs[STARPU_NMAX_SCHED_CTXS];
+static unsigned long next_job_id = 1;
+static __thread int current_worker = -1;
+
+unsigned mock_starpu_init(unsigned ncpus, unsigned ncuda, unsigned size)
+{
+	unsigned i;
+
+	STARPU_ASSERT(ncpus + ncuda <= STARPU_NMAXWORKERS && ncuda < STARPU_MAXNODES);
+	nworkers = ncpus + ncuda;
+	ncombined = 0;
+	combined_size = size;
+
+	for (i = 0; i < nworkers; i++)
+	{
+		struct mock_worker *w = &workers[i];
+		if (i < ncpus)
+		{
+			/* All the CPUs share the same perf arch, like in StarPU */
+			w->type = STARPU_CPU_WORKER;
+			w->memory_node = STARPU_MAIN_RAM;
+		}
+		else
+		{
+			w->type = STARPU_CUDA_WORKER;
+			w->memory_node = 1 + i - ncpus;
+			w->device.type = STARPU_CUDA_WORKER;
+			w->device.devid = i - ncpus;
+			w->device.ncores = 1;
+			w->arch.ndevices = 1;
+			w->arch.devices = &w->device;
+		}
+		STARPU_PTHREAD_MUTEX_INIT(&w->sched_mutex, NULL);
+		pthread_cond_init(&w->sched_cond, NULL);
+	}
+	return nworkers;
+}
+
+void mock_starpu_shutdown(void)
+{
+	unsigned i;
+
+	for (i = 0; i < nworkers; i++)
+	{
+		STARPU_PTHREAD_MUTEX_DESTROY(&workers[i].sched_mutex);
+		pthread_cond_destroy(&workers[i].sched_cond);
+	}
+	nworkers = 0;
+	ncombined = 0;
+}
+
+unsigned mock_starpu_ctx_create(struct starpu_sched_policy *policy)
+{
+	int ids[STARPU_NMAXWORKERS];
+	unsigned id, i;
+
+	for (id = 0; id < STARPU_NMAX_SCHED_CTXS; id++)
+		if (!ctxs[id].used)
+			break;
+	STARPU_ASSERT(id < STARPU_NMAX_SCHED_CTXS);
+
+	memset(&ctxs[id], 0, sizeof(ctxs[id]));
+	ctxs[id].used = 1;
+	ctxs[id].policy = policy;
+	policy->init_sched(id);
+
+	for (i = 0; i < nworkers; i++)
+	{
+		ids[i] = i;
+		ctxs[id].collection->add(ctxs[id].collection, i);
+	}
+	if (policy->add_workers)
+		policy->add_workers(id, ids, nworkers);
+	return id;
+}
+
+void mock_starpu_ctx_delete(unsigned sched_ctx_id)
+{
+	struct mock_ctx *ctx = &ctxs[sched_ctx_id];
+
+	ctx->policy->deinit_sched(sched_ctx_id);
+	ctx->used = 0;
+}
+
+void mock_starpu_set_worker(int workerid)
+{
+	current_worker = workerid;
+}
+
+starpu_data_handle_t mock_starpu_data_create(size_t size)
+{
+	starpu_data_handle_t handle;
+
+	_STARPU_MALLOC(handle, sizeof(*handle));
+	handle->size = size;
+	return handle;
+}
+
+void mock_starpu_data_destroy(starpu_data_handle_t handle)
+{
+	free(handle);
+}
+
+static struct mock_job *mock_job_create(void)
+{
+	struct mock_job *job;
+
+	_STARPU_CALLOC(job, 1, sizeof(*job));
+	job->id = __atomic_fetch_add(&next_job_id, 1, __ATOMIC_RELAXED);
+	return job;
+}
+
+void mock_starpu_task_init(struct starpu_task *task, struct starpu_codelet *cl, unsigned sched_ctx_id)
+{
+	unsigned i;
+
+	memset(task, 0, sizeof(*task));
+	task->cl = cl;
+	task->sched_ctx = sched_ctx_id;
+	task->predicted = NAN;
+	task->predicted_transfer = NAN;
+	task->starpu_private = mock_job_create();
+
+	if (cl && cl->where == 0)
+	{
+		/* As StarPU does at submission */
+		for (i = 0; i < STARPU_MAXIMPLEMENTATIONS; i++)
+		{
+			if (cl->cpu_funcs[i])
+				cl->where |= STARPU_CPU;
+			if (cl->cuda_funcs[i])
+				cl->where |= STARPU_CUDA;
+			if (cl->opencl_funcs[i])
+				cl->where |= STARPU_OPENCL;
+		}
+	}
+}
+
+void mock_starpu_task_add_succ(struct starpu_task *task, struct starpu_task *succ)
+{
+	struct mock_job *job = task->starpu_private;
+
+	if (job->nsuccs == job->maxsuccs)
+	{
+		job->maxsuccs = job->maxsuccs ? 2 * job->maxsuccs : 4;
+		_STARPU_REALLOC(job->succs, job->maxsuccs * sizeof(*job->succs));
+	}
+	job->succs[job->nsuccs++] = succ;
+}
+
+void mock_starpu_task_clean(struct starpu_task *task)
+{
+	struct mock_job *job = task->starpu_private;
+
+	if (job)
+	{
+		free(job->succs);
+		free(job);
+	}
+	task->starpu_private = NULL;
+}
+
+enum starpu_worker_archtype mock_starpu_arch_type(struct starpu_perfmodel_arch *arch)
+{
+	return arch->devices[0].type;
+}
+
+int mock_starpu_arch_ncores(struct starpu_perfmodel_arch *arch)
+{
+	return arch->devices[0].ncores;
+}
+
+/*
+ * Task lists, as the StarPU inline ones
+ */
+
+void starpu_task_list_init(struct starpu_task_list *list)
+{
+	list->head = NULL;
+	list->tail = NULL;
+}
+
+void starpu_task_list_push_front(struct starpu_task_list *list, struct starpu_task *task)
+{
+	if (list->tail == NULL)
+		list->tail = task;
+	else
+		list->head->prev = task;
+
+	task->prev = NULL;
+	task->next = list->head;
+	list->head = task;
+}
+
+void starpu_task_list_push_back(struct starpu_task_list *list, struct starpu_task *task)
+{
+	if (list->head == NULL)
+		list->head = task;
+	else
+		list->tail->next = task;
+
+	task->next = NULL;
+	task->prev = list->tail;
+	list->tail = task;
+}
+
+struct starpu_task *starpu_task_list_front(const struct starpu_task_list *list)
+{
+	return list->head;
+}
+
+struct starpu_task *starpu_task_list_back(const struct starpu_task_list *list)
+{
+	return list->tail;
+}
+
+int starpu_task_list_empty(const struct starpu_task_list *list)
+{
+	return list->head == NULL;
+}
+
+void starpu_task_list_erase(struct starpu_task_list *list, struct starpu_task *task)
+{
+	struct starpu_task *p = task->prev;
+
+	if (p)
+		p->next = task->next;
+	else
+		list->head = task->next;
+
+	if (task->next)
+		task->next->prev = p;
+	else
+		list->tail = p;
+
+	task->prev = NULL;
+	task->next = NULL;
+}
+
+struct starpu_task *starpu_task_list_pop_front(struct starpu_task_list *list)
+{
+	struct starpu_task *task = list->head;
+
+	if (task)
+		starpu_task_list_erase(list, task);
+	return task;
+}
+
+struct starpu_task *starpu_task_list_pop_back(struct starpu_task_list *list)
+{
+	struct starpu_task *task = list->tail;
+
+	if (task)
+		starpu_task_list_erase(list, task);
+	return task;
+}
+
+struct starpu_task *starpu_task_list_begin(const struct starpu_task_list *list)
+{
+	return list->head;
+}
+
+struct starpu_task *starpu_task_list_end(const struct starpu_task_list *list STARPU_ATTRIBUTE_UNUSED)
+{
+	return NULL;
+}
+
+struct starpu_task *starpu_task_list_next(const struct starpu_task *task)
+{
+	return task->next;
+}
+
+/*
+ * Worker queues, as sched_policies/fifo_queues.c
+ */
+
+struct _starpu_fifo_taskq *_starpu_create_fifo(void)
+{
+	struct _starpu_fifo_taskq *fifo;
+
+	_STARPU_CALLOC(fifo, 1, sizeof(*fifo));
+	starpu_task_list_init(&fifo->taskq);
+	fifo->exp_start = starpu_timing_now();
+	fifo->exp_len = 0.0;
+	fifo->exp_end = fifo->exp_start;
+	return fifo;
+}
+
+void _starpu_destroy_fifo(struct _starpu_fifo_taskq *fifo)
+{
+	free(fifo);
+}
+
+int _starpu_fifo_empty(struct _starpu_fifo_taskq *fifo)
+{
+	return fifo->ntasks == 0;
+}
+
+double _starpu_fifo_get_exp_len_prev_task_list(struct _starpu_fifo_taskq *fifo_queue, struct starpu_task *task,
+					       int workerid STARPU_ATTRIBUTE_UNUSED, int nimpl STARPU_ATTRIBUTE_UNUSED, int *fifo_ntasks)
+{
+	struct starpu_task *t;
+	double exp_len = 0.0;
+
+	*fifo_ntasks = 0;
+	for (t = fifo_queue->taskq.head; t; t = t->next)
+	{
+		if (t->priority < task->priority)
+			break;
+		if (!isnan(t->predicted))
+			exp_len += t->predicted;
+		(*fifo_ntasks)++;
+	}
+	return exp_len;
+}
+
+int _starpu_fifo_push_sorted_task(struct _starpu_fifo_taskq *fifo_queue, struct starpu_task *task)
+{
+	struct starpu_task_list *list = &fifo_queue->taskq;
+	struct starpu_task *t = list->head;
+
+	/* Decreasing priorities, equal ones in submission order */
+	while (t && t->priority >= task->priority)
+		t = t->next;
+
+	if (t == NULL)
+		starpu_task_list_push_back(list, task);
+	else if (t->prev == NULL)
+		starpu_task_list_push_front(list, task);
+	else
+	{
+		task->prev = t->prev;
+		task->next = t;
+		t->prev->next = task;
+		t->prev = task;
+	}
+	fifo_queue->ntasks++;
+	fifo_queue->nprocessed++;
+	return 0;
+}
+
+struct starpu_task *_starpu_fifo_pop_local_task(struct _starpu_fifo_taskq *fifo)
+{
+	struct starpu_task *task = starpu_task_list_pop_front(&fifo->taskq);
+
+	if (task)
+	{
+		STARPU_ASSERT(fifo->ntasks);
+		fifo->ntasks--;
+	}
+	return task;
+}
+
+struct starpu_task *_starpu_fifo_pop_every_task(struct _starpu_fifo_taskq *fifo, int workerid STARPU_ATTRIBUTE_UNUSED)
+{
+	struct starpu_task *head = fifo->taskq.head;
+
+	/* Every queued task was placed for this worker, they are returned
+	 * linked by next */
+	starpu_task_list_init(&fifo->taskq);
+	fifo->ntasks = 0;
+	return head;
+}
+
+/*
+ * Tasks and perf models
+ */
+
+struct starpu_task *starpu_task_dup(struct starpu_task *task)
+{
+	struct starpu_task *copy;
+
+	_STARPU_MALLOC(copy, sizeof(*copy));
+	*copy = *task;
+	copy->prev = NULL;
+	copy->next = NULL;
+	copy->starpu_private = mock_job_create();
+	return copy;
+}
+
+int starpu_task_get_task_succs(struct starpu_task *task, unsigned ndeps, struct starpu_task *task_array[])
+{
+	struct mock_job *job = task->starpu_private;
+
+	if (ndeps > 0)
+		memcpy(task_array, job->succs, STARPU_MIN(ndeps, job->nsuccs) * sizeof(*task_array));
+	return job->nsuccs;
+}
+
+unsigned long starpu_task_get_job_id(struct starpu_task *task)
+{
+	return ((struct mock_job *) task->starpu_private)->id;
+}
+
+const char *starpu_task_get_name(struct starpu_task *task)
+{
+	if (task->name)
+		return task->name;
+	if (task->cl && task->cl->name)
+		return task->cl->name;
+	return "unknown";
+}
+
+unsigned starpu_task_get_implementation(struct starpu_task *task)
+{
+	return ((struct mock_job *) task->starpu_private)->impl;
+}
+
+void starpu_task_set_implementation(struct starpu_task *task, unsigned impl)
+{
+	((struct mock_job *) task->starpu_private)->impl = impl;
+}
+
+uint32_t starpu_task_footprint(struct starpu_perfmodel *model, struct starpu_task *task,
+			       struct starpu_perfmodel_arch *arch STARPU_ATTRIBUTE_UNUSED, unsigned nimpl)
+{
+	uint32_t footprint = 2166136261U;
+	unsigned i;
+
+	if (model && model->footprint)
+		return model->footprint(task);
+	if (model && model->size_base)
+		return (uint32_t) model->size_base(task, nimpl);
+
+	/* FNV-1a over the data sizes, where StarPU hashes the interfaces */
+	for (i = 0; i < STARPU_TASK_GET_NBUFFERS(task); i++)
+	{
+		footprint ^= (uint32_t) STARPU_TASK_GET_HANDLE(task, i)->size;
+		footprint *= 16777619U;
+	}
+	return footprint;
+}
+
+static double mock_model_expected(struct starpu_task *task, struct starpu_perfmodel *model,
+				  struct starpu_perfmodel_arch *arch, unsigned nimpl)
+{
+	if (model == NULL)
+		return 0.0;
+	if (model->arch_cost_function)
+		return model->arch_cost_function(task, arch, nimpl);
+	if (model->type == STARPU_COMMON && model->cost_function)
+		return model->cost_function(task, nimpl) / starpu_worker_get_relative_speedup(arch);
+	/* A history which never calibrates */
+	return NAN;
+}
+
+double starpu_task_expected_length(struct starpu_task *task, struct starpu_perfmodel_arch *arch, unsigned nimpl)
+{
+	if (!task->cl)
+		return 0.0;
+	return mock_model_expected(task, task->cl->model, arch, nimpl);
+}
+
+double starpu_task_expected_energy(struct starpu_task *task, struct starpu_perfmodel_arch *arch, unsigned nimpl)
+{
+	if (!task->cl)
+		return 0.0;
+	return mock_model_expected(task, task->cl->energy_model, arch, nimpl);
+}
+
+double starpu_task_expected_conversion_time(struct starpu_task *task STARPU_ATTRIBUTE_UNUSED,
+					    struct starpu_perfmodel_arch *arch STARPU_ATTRIBUTE_UNUSED,
+					    unsigned nimpl STARPU_ATTRIBUTE_UNUSED)
+{
+	return 0.0;
+}
+
+double starpu_transfer_predict(unsigned src_node, unsigned dst_node, size_t size)
+{
+	if (src_node == dst_node)
+		return 0.0;
+	return MOCK_TRANSFER_LATENCY + size / MOCK_TRANSFER_BANDWIDTH;
+}
+
+double starpu_task_expected_data_transfer_time(unsigned memory_node, struct starpu_task *task)
+{
+	double penalty = 0.0;
+	unsigned i;
+
+	if (!task->cl)
+		return 0.0;
+	for (i = 0; i < STARPU_TASK_GET_NBUFFERS(task); i++)
+		penalty += starpu_transfer_predict(STARPU_MAIN_RAM, memory_node, STARPU_TASK_GET_HANDLE(task, i)->size);
+	return penalty;
+}
+
+/* Bundles are not supported, the policies only call these when a task has one */
+double starpu_task_bundle_expected_length(starpu_task_bundle_t bundle STARPU_ATTRIBUTE_UNUSED,
+					  struct starpu_perfmodel_arch *arch STARPU_ATTRIBUTE_UNUSED,
+					  unsigned nimpl STARPU_ATTRIBUTE_UNUSED)
+{
+	return NAN;
+}
+
+double starpu_task_bundle_expected_data_transfer_time(starpu_task_bundle_t bundle STARPU_ATTRIBUTE_UNUSED,
+						      unsigned memory_node STARPU_ATTRIBUTE_UNUSED)
+{
+	return NAN;
+}
+
+double starpu_task_bundle_expected_energy(starpu_task_bundle_t bundle STARPU_ATTRIBUTE_UNUSED,
+					  struct starpu_perfmodel_arch *arch STARPU_ATTRIBUTE_UNUSED,
+					  unsigned nimpl STARPU_ATTRIBUTE_UNUSED)
+{
+	return NAN;
+}
+
+size_t _starpu_data_get_size(starpu_data_handle_t handle)
+{
+	return handle->size;
+}
+
+void starpu_data_query_status(starpu_data_handle_t handle STARPU_ATTRIBUTE_UNUSED, int memory_node,
+			      int *is_allocated, int *is_valid, int *is_requested)
+{
+	if (is_allocated)
+		*is_allocated = memory_node == STARPU_MAIN_RAM;
+	if (is_valid)
+		*is_valid = memory_node == STARPU_MAIN_RAM;
+	if (is_requested)
+		*is_requested = 0;
+}
+
+int starpu_get_prefetch_flag(void)
+{
+	return 0;
+}
+
+int starpu_prefetch_task_input_on_node(struct starpu_task *task STARPU_ATTRIBUTE_UNUSED, unsigned node STARPU_ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+/*
+ * Environment and time
+ */
+
+double starpu_timing_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e6 + now.tv_nsec * 1e-3;
+}
+
+double starpu_get_env_float_default(const char *str, double defval)
+{
+	const char *value = getenv(str);
+	char *end;
+
+	if (!value || !value[0])
+		return defval;
+	double ret = strtod(value, &end);
+	return *end ? defval : ret;
+}
+
+int starpu_get_env_number_default(const char *str, int defval)
+{
+	const char *value = getenv(str);
+	char *end;
+
+	if (!value || !value[0])
+		return defval;
+	long ret = strtol(value, &end, 10);
+	return *end ? defval : (int) ret;
+}
+
+/*
+ * Workers
+ */
+
+unsigned starpu_worker_get_count(void)
+{
+	return nworkers;
+}
+
+int starpu_worker_get_id(void)
+{
+	return current_worker;
+}
+
+unsigned starpu_worker_get_id_check(void)
+{
+	STARPU_ASSERT_MSG(current_worker >= 0, "not called from a worker, see mock_starpu_set_worker\n");
+	return current_worker;
+}
+
+enum starpu_worker_archtype starpu_worker_get_type(int id)
+{
+	if (id >= (int) nworkers)
+		/* Combined workers are made of CPUs */
+		return STARPU_CPU_WORKER;
+	return workers[id].type;
+}
+
+unsigned starpu_worker_get_memory_node(unsigned workerid)
+{
+	if (workerid >= nworkers)
+		return STARPU_MAIN_RAM;
+	return workers[workerid].memory_node;
+}
+
+struct starpu_perfmodel_arch *starpu_worker_get_perf_archtype(int workerid, unsigned sched_ctx_id STARPU_ATTRIBUTE_UNUSED)
+{
+	if (workerid >= (int) nworkers)
+		return &combined[workerid - nworkers].arch;
+	if (workers[workerid].type == STARPU_CPU_WORKER)
+		return &cpu_arch;
+	return &workers[workerid].arch;
+}
+
+double starpu_worker_get_relative_speedup(struct starpu_perfmodel_arch *perf_arch)
+{
+	if (perf_arch->devices[0].type == STARPU_CUDA_WORKER)
+		return MOCK_CUDA_SPEEDUP;
+	return perf_arch->devices[0].ncores;
+}
+
+static int mock_can_execute(unsigned workerid, struct starpu_task *task, unsigned nimpl)
+{
+	struct starpu_codelet *cl = task->cl;
+	int has_func;
+
+	switch (starpu_worker_get_type(workerid))
+	{
+	case STARPU_CPU_WORKER:
+		has_func = cl->cpu_funcs[nimpl] != NULL;
+		break;
+	case STARPU_CUDA_WORKER:
+		has_func = cl->cuda_funcs[nimpl] != NULL;
+		break;
+	case STARPU_OPENCL_WORKER:
+		has_func = cl->opencl_funcs[nimpl] != NULL;
+		break;
+	default:
+		has_func = 0;
+		break;
+	}
+	return has_func && (!cl->can_execute || cl->can_execute(workerid, task, nimpl));
+}
+
+int starpu_worker_can_execute_task_impl(unsigned workerid, struct starpu_task *task, unsigned *impl_mask)
+{
+	unsigned mask = 0;
+	unsigned nimpl;
+
+	if (!task->cl)
+		mask = 1;
+	else
+		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
+			if (mock_can_execute(workerid, task, nimpl))
+				mask |= 1U << nimpl;
+	if (impl_mask)
+		*impl_mask = mask;
+	return mask != 0;
+}
+
+int starpu_worker_can_execute_task_first_impl(unsigned workerid, struct starpu_task *task, unsigned *nimpl)
+{
+	unsigned i;
+
+	for (i = 0; i < STARPU_MAXIMPLEMENTATIONS; i++)
+		if (!task->cl || mock_can_execute(workerid, task, i))
+		{
+			if (nimpl)
+				*nimpl = i;
+			return 1;
+		}
+	return 0;
+}
+
+void starpu_worker_get_sched_condition(int workerid, starpu_pthread_mutex_t **sched_mutex, starpu_pthread_cond_t **sched_cond)
+{
+	*sched_mutex = &workers[workerid].sched_mutex;
+	*sched_cond = &workers[workerid].sched_cond;
+}
+
+int starpu_wakeup_worker_locked(int workerid STARPU_ATTRIBUTE_UNUSED, starpu_pthread_cond_t *cond STARPU_ATTRIBUTE_UNUSED,
+				starpu_pthread_mutex_t *mutex STARPU_ATTRIBUTE_UNUSED)
+{
+	/* Nobody sleeps */
+	return 0;
+}
+
+/* Groups of combined_size consecutive CPU workers among WORKERIDS. As in
+ * StarPU, combinations are created once and never removed. */
+void _starpu_sched_find_worker_combinations(int *workerids, int n)
+{
+	struct mock_combined *c = NULL;
+	int i;
+
+	if (combined_size < 2 || ncombined > 0)
+		return;
+
+	for (i = 0; i < n && ncombined < STARPU_NMAX_COMBINEDWORKERS; i++)
+	{
+		if (starpu_worker_get_type(workerids[i]) != STARPU_CPU_WORKER)
+			continue;
+		if (c == NULL)
+		{
+			c = &combined[ncombined];
+			c->size = 0;
+		}
+		c->members[c->size++] = workerids[i];
+		if (c->size == (int) combined_size)
+		{
+			c->device.type = STARPU_CPU_WORKER;
+			c->device.devid = 0;
+			c->device.ncores = c->size;
+			c->arch.ndevices = 1;
+			c->arch.devices = &c->device;
+			ncombined++;
+			c = NULL;
+		}
+	}
+}
+
+unsigned starpu_combined_worker_get_count(void)
+{
+	return ncombined;
+}
+
+int starpu_combined_worker_get_size(void)
+{
+	/* Aliases of parallel tasks are not executed */
+	return 1;
+}
+
+int starpu_combined_worker_get_description(int workerid, int *worker_size, int **combined_workerid)
+{
+	int i = workerid - nworkers;
+
+	if (i < 0 || i >= (int) ncombined)
+		return -EINVAL;
+	*worker_size = combined[i].size;
+	*combined_workerid = combined[i].members;
+	return 0;
+}
+
+int starpu_combined_worker_can_execute_task(unsigned workerid, struct starpu_task *task, unsigned nimpl)
+{
+	struct starpu_codelet *cl = task->cl;
+
+	if (workerid < nworkers)
+		return cl == NULL || mock_can_execute(workerid, task, nimpl);
+	return cl != NULL && cl->type != STARPU_SEQ && cl->cpu_funcs[nimpl] != NULL
+		&& (cl->max_parallelism <= 0 || combined[workerid - nworkers].size <= cl->max_parallelism);
+}
+
+void starpu_parallel_task_barrier_init(struct starpu_task *task STARPU_ATTRIBUTE_UNUSED, int workerid STARPU_ATTRIBUTE_UNUSED)
+{
+}
+
+/*
+ * Scheduling contexts, with list worker collections
+ */
+
+void starpu_push_task_end(struct starpu_task *task STARPU_ATTRIBUTE_UNUSED)
+{
+}
+
+void starpu_sched_task_break(struct starpu_task *task STARPU_ATTRIBUTE_UNUSED)
+{
+}
+
+static unsigned mock_list_has_next(struct starpu_worker_collection *collection, struct starpu_sched_ctx_iterator *it)
+{
+	return it->cursor < (int) collection->nworkers;
+}
+
+static int mock_list_get_next(struct starpu_worker_collection *collection, struct starpu_sched_ctx_iterator *it)
+{
+	return collection->workerids[it->cursor++];
+}
+
+static int mock_list_add(struct starpu_worker_collection *collection, int worker)
+{
+	unsigned i;
+
+	for (i = 0; i < collection->nworkers; i++)
+		if (collection->workerids[i] == worker)
+			return -1;
+	collection->workerids[collection->nworkers++] = worker;
+	return worker;
+}
+
+static int mock_list_remove(struct starpu_worker_collection *collection, int worker)
+{
+	unsigned i;
+
+	for (i = 0; i < collection->nworkers; i++)
+		if (collection->workerids[i] == worker)
+		{
+			memmove(&collection->workerids[i], &collection->workerids[i + 1],
+				(collection->nworkers - i - 1) * sizeof(int));
+			collection->nworkers--;
+			return worker;
+		}
+	return -1;
+}
+
+static void mock_list_init(struct starpu_worker_collection *collection)
+{
+	_STARPU_MALLOC(collection->workerids, STARPU_NMAXWORKERS * sizeof(int));
+	collection->nworkers = 0;
+}
+
+static void mock_list_deinit(struct starpu_worker_collection *collection)
+{
+	free(collection->workerids);
+}
+
+static void mock_list_init_iterator(struct starpu_worker_collection *collection STARPU_ATTRIBUTE_UNUSED,
+				    struct starpu_sched_ctx_iterator *it)
+{
+	it->cursor = 0;
+}
+
+struct starpu_worker_collection *starpu_sched_ctx_create_worker_collection(unsigned sched_ctx_id,
+									    enum starpu_worker_collection_type type STARPU_ATTRIBUTE_UNUSED)
+{
+	struct starpu_worker_collection *collection;
+
+	_STARPU_CALLOC(collection, 1, sizeof(*collection));
+	/* Trees are only worth it with hierarchical contexts */
+	collection->type = STARPU_WORKER_LIST;
+	collection->has_next = mock_list_has_next;
+	collection->get_next = mock_list_get_next;
+	collection->has_next_master = mock_list_has_next;
+	collection->get_next_master = mock_list_get_next;
+	collection->add = mock_list_add;
+	collection->remove = mock_list_remove;
+	collection->init = mock_list_init;
+	collection->deinit = mock_list_deinit;
+	collection->init_iterator = mock_list_init_iterator;
+	collection->init(collection);
+
+	ctxs[sched_ctx_id].collection = collection;
+	return collection;
+}
+
+void starpu_sched_ctx_delete_worker_collection(unsigned sched_ctx_id)
+{
+	struct starpu_worker_collection *collection = ctxs[sched_ctx_id].collection;
+
+	collection->deinit(collection);
+	free(collection);
+	ctxs[sched_ctx_id].collection = NULL;
+}
+
+struct starpu_worker_collection *starpu_sched_ctx_get_worker_collection(unsigned sched_ctx_id)
+{
+	return ctxs[sched_ctx_id].collection;
+}
+
+struct starpu_sched_policy *starpu_sched_ctx_get_sched_policy(unsigned sched_ctx_id)
+{
+	return ctxs[sched_ctx_id].policy;
+}
+
+void starpu_sched_ctx_set_policy_data(unsigned sched_ctx_id, void *policy_data)
+{
+	ctxs[sched_ctx_id].policy_data = policy_data;
+}
+
+void *starpu_sched_ctx_get_policy_data(unsigned sched_ctx_id)
+{
+	return ctxs[sched_ctx_id].policy_data;
+}
+
+int starpu_sched_ctx_get_min_priority(unsigned sched_ctx_id)
+{
+	return ctxs[sched_ctx_id].min_priority;
+}
+
+int starpu_sched_ctx_get_max_priority(unsigned sched_ctx_id)
+{
+	return ctxs[sched_ctx_id].max_priority;
+}
+
+int starpu_sched_ctx_set_min_priority(unsigned sched_ctx_id, int min_prio)
+{
+	ctxs[sched_ctx_id].min_priority = min_prio;
+	ctxs[sched_ctx_id].min_priority_set = 1;
+	return 0;
+}
+
+int starpu_sched_ctx_set_max_priority(unsigned sched_ctx_id, int max_prio)
+{
+	ctxs[sched_ctx_id].max_priority = max_prio;
+	ctxs[sched_ctx_id].max_priority_set = 1;
+	return 0;
+}
+
+int starpu_sched_ctx_min_priority_is_set(unsigned sched_ctx_id)
+{
+	return ctxs[sched_ctx_id].min_priority_set;
+}
+
+int starpu_sched_ctx_max_priority_is_set(unsigned sched_ctx_id)
+{
+	return ctxs[sched_ctx_id].max_priority_set;
+}
+
+unsigned starpu_sched_ctx_worker_is_master_for_child_ctx(int workerid STARPU_ATTRIBUTE_UNUSED, unsigned sched_ctx_id STARPU_ATTRIBUTE_UNUSED)
+{
+	/* No nested contexts */
+	return STARPU_NMAX_SCHED_CTXS;
+}
+
+void starpu_sched_ctx_revert_task_counters(unsigned sched_ctx_id STARPU_ATTRIBUTE_UNUSED, double flops STARPU_ATTRIBUTE_UNUSED)
+{
+}
+
+void starpu_sched_ctx_move_task_to_ctx(struct starpu_task *task STARPU_ATTRIBUTE_UNUSED, unsigned sched_ctx STARPU_ATTRIBUTE_UNUSED)
+{
+}
@@ -0,0 +1,63 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Control of the mock StarPU runtime.
+ *
+ * The machine is made of NCPUS CPU workers on the main memory node followed
+ * by NCUDA CUDA workers, each on its own memory node. Nothing executes: the
+ * caller plays the drivers, choosing which worker the current thread is with
+ * mock_starpu_set_worker() before calling pop_task or the hooks.
+ *
+ * Perf models give what their cost functions return, they never calibrate.
+ * Transfers cost a latency plus the size over a fixed bandwidth between two
+ * distinct memory nodes, data are always valid on the main memory node only.
+ */
+
+#ifndef __MOCK_STARPU_RUNTIME_H__
+#define __MOCK_STARPU_RUNTIME_H__
+
+#include <starpu.h>
+
+/* Transfer model between two distinct memory nodes */
+#define MOCK_TRANSFER_LATENCY	10.0	/* us */
+#define MOCK_TRANSFER_BANDWIDTH	8000.0	/* bytes per us */
+
+/* Relative speedup reported for a CUDA worker, a CPU worker being 1 */
+#define MOCK_CUDA_SPEEDUP	13.33
+
+/* Set up the workers. With COMBINED_SIZE > 1, the CPU workers are also
+ * grouped into combined workers of that size, once a policy looks for
+ * combinations. Returns the number of workers. */
+unsigned mock_starpu_init(unsigned ncpus, unsigned ncuda, unsigned combined_size);
+void mock_starpu_shutdown(void);
+
+/* Create a context with POLICY over all the workers, as starpu_sched_ctx_create
+ * does: init_sched then add_workers */
+unsigned mock_starpu_ctx_create(struct starpu_sched_policy *policy);
+void mock_starpu_ctx_delete(unsigned sched_ctx_id);
+
+/* Worker the calling thread plays, -1 for an application thread */
+void mock_starpu_set_worker(int workerid);
+
+/* Data handle of SIZE bytes, home on the main memory node */
+starpu_data_handle_t mock_starpu_data_create(size_t size);
+void mock_starpu_data_destroy(starpu_data_handle_t handle);
+
+/* Initialize TASK for CL in SCHED_CTX_ID, with a fresh job id. SUCC tasks
+ * declared with mock_starpu_task_add_succ() are what
+ * starpu_task_get_task_succs() returns. */
+void mock_starpu_task_init(struct starpu_task *task, struct starpu_codelet *cl, unsigned sched_ctx_id);
+void mock_starpu_task_add_succ(struct starpu_task *task, struct starpu_task *succ);
+void mock_starpu_task_clean(struct starpu_task *task);
+
+/* Type and number of cores of ARCH, for the cost functions */
+enum starpu_worker_archtype mock_starpu_arch_type(struct starpu_perfmodel_arch *arch);
+int mock_starpu_arch_ncores(struct starpu_perfmodel_arch *arch);
+
+#endif /* __MOCK_STARPU_RUNTIME_H__ */
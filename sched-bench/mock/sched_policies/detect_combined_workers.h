@@ -0,0 +1,17 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+#ifndef __MOCK_DETECT_COMBINED_WORKERS_H__
+#define __MOCK_DETECT_COMBINED_WORKERS_H__
+
+#include <starpu.h>
+
+/* Groups of CPU workers, see mock_starpu_set_combined() */
+void _starpu_sched_find_worker_combinations(int *workerids, int nworkers);
+
+#endif /* __MOCK_DETECT_COMBINED_WORKERS_H__ */
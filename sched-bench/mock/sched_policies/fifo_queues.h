@@ -0,0 +1,39 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/* Mock of the StarPU worker queues, same fields and semantics */
+
+#ifndef __MOCK_FIFO_QUEUES_H__
+#define __MOCK_FIFO_QUEUES_H__
+
+#include <common/utils.h>
+
+struct _starpu_fifo_taskq
+{
+	struct starpu_task_list taskq;
+	unsigned ntasks;
+	unsigned *ntasks_per_priority;
+	unsigned nprocessed;
+
+	/* Expected start, length and end of the queued work, in us */
+	double exp_start;
+	double exp_end;
+	double exp_len;
+	double *exp_len_per_priority;
+	double pipeline_len;
+};
+
+struct _starpu_fifo_taskq *_starpu_create_fifo(void);
+void _starpu_destroy_fifo(struct _starpu_fifo_taskq *fifo);
+int _starpu_fifo_empty(struct _starpu_fifo_taskq *fifo);
+double _starpu_fifo_get_exp_len_prev_task_list(struct _starpu_fifo_taskq *fifo_queue, struct starpu_task *task, int workerid, int nimpl, int *fifo_ntasks);
+int _starpu_fifo_push_sorted_task(struct _starpu_fifo_taskq *fifo_queue, struct starpu_task *task);
+struct starpu_task *_starpu_fifo_pop_local_task(struct _starpu_fifo_taskq *fifo);
+struct starpu_task *_starpu_fifo_pop_every_task(struct _starpu_fifo_taskq *fifo, int workerid);
+
+#endif /* __MOCK_FIFO_QUEUES_H__ */
@@ -0,0 +1,307 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Mock of the StarPU 1.2 scheduler API, for the micro-benchmarks.
+ *
+ * Only what the policies use is declared, with the layout of StarPU where the
+ * policies access the fields. The runtime behind it is in mock_starpu.c: no
+ * driver, no data management, workers and perf models are made up, see
+ * mock_starpu.h.
+ */
+
+#ifndef __MOCK_STARPU_H__
+#define __MOCK_STARPU_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+
+#define STARPU_MAXIMPLEMENTATIONS	4
+#define STARPU_NMAXWORKERS		64
+#define STARPU_NMAX_COMBINEDWORKERS	64
+#define STARPU_MAXNODES			16
+#define STARPU_NMAXBUFS			8
+#define STARPU_NMAX_SCHED_CTXS		10
+#define STARPU_MAIN_RAM			0
+#define STARPU_HAVE_UNSETENV		1
+
+#define STARPU_CPU	((1ULL)<<1)
+#define STARPU_CUDA	((1ULL)<<3)
+#define STARPU_OPENCL	((1ULL)<<6)
+
+#define STARPU_ATTRIBUTE_UNUSED	__attribute__((unused))
+#define STARPU_UNLIKELY(x)	__builtin_expect(!!(x), 0)
+#define STARPU_LIKELY(x)	__builtin_expect(!!(x), 1)
+#define STARPU_MAX(a, b)	((a) > (b) ? (a) : (b))
+#define STARPU_MIN(a, b)	((a) < (b) ? (a) : (b))
+
+#define STARPU_ASSERT(x) do { if (STARPU_UNLIKELY(!(x))) { fprintf(stderr, "%s:%d: assertion %s failed\n", __FILE__, __LINE__, #x); abort(); } } while (0)
+#define STARPU_ASSERT_MSG(x, msg, ...) do { if (STARPU_UNLIKELY(!(x))) { fprintf(stderr, "%s:%d: " msg, __FILE__, __LINE__, ## __VA_ARGS__); abort(); } } while (0)
+#define STARPU_CHECK_RETURN_VALUE(err, msg) do { if (STARPU_UNLIKELY(err != 0)) { fprintf(stderr, "%s failed\n", msg); abort(); } } while (0)
+#define STARPU_HG_DISABLE_CHECKING(x)	((void)0)
+#define STARPU_AYU_ADDTOTASKQUEUE(job_id, workerid)	((void)0)
+
+typedef pthread_mutex_t starpu_pthread_mutex_t;
+typedef pthread_cond_t starpu_pthread_cond_t;
+#define STARPU_PTHREAD_MUTEX_INIT(m, a)		pthread_mutex_init(m, a)
+#define STARPU_PTHREAD_MUTEX_DESTROY(m)		pthread_mutex_destroy(m)
+#define STARPU_PTHREAD_MUTEX_LOCK(m)		pthread_mutex_lock(m)
+#define STARPU_PTHREAD_MUTEX_UNLOCK(m)		pthread_mutex_unlock(m)
+#define STARPU_PTHREAD_MUTEX_LOCK_SCHED(m)	pthread_mutex_lock(m)
+#define STARPU_PTHREAD_MUTEX_UNLOCK_SCHED(m)	pthread_mutex_unlock(m)
+
+enum starpu_data_access_mode
+{
+	STARPU_NONE = 0,
+	STARPU_R = (1 << 0),
+	STARPU_W = (1 << 1),
+	STARPU_RW = (STARPU_R | STARPU_W)
+};
+
+enum starpu_worker_archtype
+{
+	STARPU_ANY_WORKER,
+	STARPU_CPU_WORKER,
+	STARPU_CUDA_WORKER,
+	STARPU_OPENCL_WORKER
+};
+
+enum starpu_worker_collection_type
+{
+	STARPU_WORKER_TREE,
+	STARPU_WORKER_LIST
+};
+
+enum starpu_codelet_type
+{
+	STARPU_SEQ = 0,
+	STARPU_SPMD,
+	STARPU_FORKJOIN
+};
+
+enum starpu_perfmodel_type
+{
+	STARPU_PER_ARCH,
+	STARPU_COMMON,
+	STARPU_HISTORY_BASED,
+	STARPU_REGRESSION_BASED,
+	STARPU_NL_REGRESSION_BASED
+};
+
+typedef struct _starpu_data_state *starpu_data_handle_t;
+typedef struct _starpu_task_bundle *starpu_task_bundle_t;
+struct starpu_task;
+
+typedef void (*starpu_cpu_func_t)(void **, void *);
+typedef void (*starpu_cuda_func_t)(void **, void *);
+typedef void (*starpu_opencl_func_t)(void **, void *);
+
+struct starpu_perfmodel_device
+{
+	enum starpu_worker_archtype type;
+	int devid;
+	int ncores;
+};
+
+struct starpu_perfmodel_arch
+{
+	int ndevices;
+	struct starpu_perfmodel_device *devices;
+};
+
+struct starpu_perfmodel
+{
+	enum starpu_perfmodel_type type;
+	/* STARPU_COMMON: length on a CPU, scaled by the relative speedup */
+	double (*cost_function)(struct starpu_task *, unsigned nimpl);
+	/* STARPU_PER_ARCH, and the history of the other types in the mock */
+	double (*arch_cost_function)(struct starpu_task *, struct starpu_perfmodel_arch *arch, unsigned nimpl);
+	size_t (*size_base)(struct starpu_task *, unsigned nimpl);
+	uint32_t (*footprint)(struct starpu_task *);
+	const char *symbol;
+	unsigned is_loaded;
+	unsigned benchmarking;
+	unsigned is_init;
+};
+
+struct starpu_codelet
+{
+	uint32_t where;
+	int (*can_execute)(unsigned workerid, struct starpu_task *task, unsigned nimpl);
+	enum starpu_codelet_type type;
+	int max_parallelism;
+	starpu_cpu_func_t cpu_funcs[STARPU_MAXIMPLEMENTATIONS];
+	starpu_cuda_func_t cuda_funcs[STARPU_MAXIMPLEMENTATIONS];
+	starpu_opencl_func_t opencl_funcs[STARPU_MAXIMPLEMENTATIONS];
+	int nbuffers;
+	enum starpu_data_access_mode modes[STARPU_NMAXBUFS];
+	unsigned specific_nodes;
+	int nodes[STARPU_NMAXBUFS];
+	struct starpu_perfmodel *model;
+	struct starpu_perfmodel *energy_model;
+	const char *name;
+};
+
+struct starpu_task
+{
+	const char *name;
+	struct starpu_codelet *cl;
+	starpu_data_handle_t handles[STARPU_NMAXBUFS];
+	void *cl_arg;
+	int priority;
+	unsigned execute_on_a_specific_worker;
+	unsigned workerid;
+	starpu_task_bundle_t bundle;
+	unsigned destroy;
+	unsigned sched_ctx;
+	double flops;
+	double predicted;
+	double predicted_transfer;
+	struct starpu_task *prev;
+	struct starpu_task *next;
+	/* struct mock_job */
+	void *starpu_private;
+};
+
+#define STARPU_TASK_GET_NBUFFERS(task)		((unsigned)((task)->cl->nbuffers))
+#define STARPU_TASK_GET_HANDLE(task, i)		((task)->handles[i])
+#define STARPU_TASK_GET_MODE(task, i)		((task)->cl->modes[i])
+#define STARPU_TASK_SET_HANDLE(task, handle, i)	do { (task)->handles[i] = (handle); } while (0)
+#define STARPU_CODELET_GET_NODE(codelet, i)	((codelet)->nodes[i])
+
+struct starpu_task_list
+{
+	struct starpu_task *head;
+	struct starpu_task *tail;
+};
+
+void starpu_task_list_init(struct starpu_task_list *list);
+void starpu_task_list_push_front(struct starpu_task_list *list, struct starpu_task *task);
+void starpu_task_list_push_back(struct starpu_task_list *list, struct starpu_task *task);
+struct starpu_task *starpu_task_list_front(const struct starpu_task_list *list);
+struct starpu_task *starpu_task_list_back(const struct starpu_task_list *list);
+int starpu_task_list_empty(const struct starpu_task_list *list);
+void starpu_task_list_erase(struct starpu_task_list *list, struct starpu_task *task);
+struct starpu_task *starpu_task_list_pop_front(struct starpu_task_list *list);
+struct starpu_task *starpu_task_list_pop_back(struct starpu_task_list *list);
+struct starpu_task *starpu_task_list_begin(const struct starpu_task_list *list);
+struct starpu_task *starpu_task_list_end(const struct starpu_task_list *list);
+struct starpu_task *starpu_task_list_next(const struct starpu_task *task);
+
+struct starpu_sched_ctx_iterator
+{
+	int cursor;
+};
+
+struct starpu_worker_collection
+{
+	int *workerids;
+	void *collection_private;
+	unsigned nworkers;
+	enum starpu_worker_collection_type type;
+	unsigned (*has_next)(struct starpu_worker_collection *workers, struct starpu_sched_ctx_iterator *it);
+	int (*get_next)(struct starpu_worker_collection *workers, struct starpu_sched_ctx_iterator *it);
+	unsigned (*has_next_master)(struct starpu_worker_collection *workers, struct starpu_sched_ctx_iterator *it);
+	int (*get_next_master)(struct starpu_worker_collection *workers, struct starpu_sched_ctx_iterator *it);
+	int (*add)(struct starpu_worker_collection *workers, int worker);
+	int (*remove)(struct starpu_worker_collection *workers, int worker);
+	void (*init)(struct starpu_worker_collection *workers);
+	void (*deinit)(struct starpu_worker_collection *workers);
+	void (*init_iterator)(struct starpu_worker_collection *workers, struct starpu_sched_ctx_iterator *it);
+};
+
+struct starpu_sched_policy
+{
+	void (*init_sched)(unsigned sched_ctx_id);
+	void (*deinit_sched)(unsigned sched_ctx_id);
+	int (*push_task)(struct starpu_task *);
+	double (*simulate_push_task)(struct starpu_task *);
+	void (*push_task_notify)(struct starpu_task *, int workerid, int perf_workerid, unsigned sched_ctx_id);
+	struct starpu_task *(*pop_task)(unsigned sched_ctx_id);
+	struct starpu_task *(*pop_every_task)(unsigned sched_ctx_id);
+	void (*submit_hook)(struct starpu_task *task);
+	void (*pre_exec_hook)(struct starpu_task *);
+	void (*post_exec_hook)(struct starpu_task *);
+	void (*do_schedule)(unsigned sched_ctx_id);
+	void (*add_workers)(unsigned sched_ctx_id, int *workerids, unsigned nworkers);
+	void (*remove_workers)(unsigned sched_ctx_id, int *workerids, unsigned nworkers);
+	const char *policy_name;
+	const char *policy_description;
+};
+
+/* Tasks */
+struct starpu_task *starpu_task_dup(struct starpu_task *task);
+int starpu_task_get_task_succs(struct starpu_task *task, unsigned ndeps, struct starpu_task *task_array[]);
+unsigned long starpu_task_get_job_id(struct starpu_task *task);
+const char *starpu_task_get_name(struct starpu_task *task);
+unsigned starpu_task_get_implementation(struct starpu_task *task);
+void starpu_task_set_implementation(struct starpu_task *task, unsigned impl);
+
+/* Performance models */
+uint32_t starpu_task_footprint(struct starpu_perfmodel *model, struct starpu_task *task, struct starpu_perfmodel_arch *arch, unsigned nimpl);
+double starpu_task_expected_length(struct starpu_task *task, struct starpu_perfmodel_arch *arch, unsigned nimpl);
+double starpu_task_expected_energy(struct starpu_task *task, struct starpu_perfmodel_arch *arch, unsigned nimpl);
+double starpu_task_expected_conversion_time(struct starpu_task *task, struct starpu_perfmodel_arch *arch, unsigned nimpl);
+double starpu_task_expected_data_transfer_time(unsigned memory_node, struct starpu_task *task);
+double starpu_task_bundle_expected_length(starpu_task_bundle_t bundle, struct starpu_perfmodel_arch *arch, unsigned nimpl);
+double starpu_task_bundle_expected_data_transfer_time(starpu_task_bundle_t bundle, unsigned memory_node);
+double starpu_task_bundle_expected_energy(starpu_task_bundle_t bundle, struct starpu_perfmodel_arch *arch, unsigned nimpl);
+double starpu_transfer_predict(unsigned src_node, unsigned dst_node, size_t size);
+
+/* Data */
+void starpu_data_query_status(starpu_data_handle_t handle, int memory_node, int *is_allocated, int *is_valid, int *is_requested);
+int starpu_get_prefetch_flag(void);
+int starpu_prefetch_task_input_on_node(struct starpu_task *task, unsigned node);
+
+/* Environment and time */
+double starpu_timing_now(void);
+double starpu_get_env_float_default(const char *str, double defval);
+int starpu_get_env_number_default(const char *str, int defval);
+
+/* Workers */
+unsigned starpu_worker_get_count(void);
+int starpu_worker_get_id(void);
+unsigned starpu_worker_get_id_check(void);
+enum starpu_worker_archtype starpu_worker_get_type(int id);
+unsigned starpu_worker_get_memory_node(unsigned workerid);
+struct starpu_perfmodel_arch *starpu_worker_get_perf_archtype(int workerid, unsigned sched_ctx_id);
+double starpu_worker_get_relative_speedup(struct starpu_perfmodel_arch *perf_arch);
+int starpu_worker_can_execute_task_impl(unsigned workerid, struct starpu_task *task, unsigned *impl_mask);
+int starpu_worker_can_execute_task_first_impl(unsigned workerid, struct starpu_task *task, unsigned *nimpl);
+void starpu_worker_get_sched_condition(int workerid, starpu_pthread_mutex_t **sched_mutex, starpu_pthread_cond_t **sched_cond);
+int starpu_wakeup_worker_locked(int workerid, starpu_pthread_cond_t *cond, starpu_pthread_mutex_t *mutex);
+unsigned starpu_combined_worker_get_count(void);
+int starpu_combined_worker_get_size(void);
+int starpu_combined_worker_get_description(int workerid, int *worker_size, int **combined_workerid);
+int starpu_combined_worker_can_execute_task(unsigned workerid, struct starpu_task *task, unsigned nimpl);
+void starpu_parallel_task_barrier_init(struct starpu_task *task, int workerid);
+
+/* Scheduling contexts */
+void starpu_push_task_end(struct starpu_task *task);
+void starpu_sched_task_break(struct starpu_task *task);
+struct starpu_worker_collection *starpu_sched_ctx_create_worker_collection(unsigned sched_ctx_id, enum starpu_worker_collection_type type);
+void starpu_sched_ctx_delete_worker_collection(unsigned sched_ctx_id);
+struct starpu_worker_collection *starpu_sched_ctx_get_worker_collection(unsigned sched_ctx_id);
+struct starpu_sched_policy *starpu_sched_ctx_get_sched_policy(unsigned sched_ctx_id);
+void starpu_sched_ctx_set_policy_data(unsigned sched_ctx_id, void *policy_data);
+void *starpu_sched_ctx_get_policy_data(unsigned sched_ctx_id);
+int starpu_sched_ctx_get_min_priority(unsigned sched_ctx_id);
+int starpu_sched_ctx_get_max_priority(unsigned sched_ctx_id);
+int starpu_sched_ctx_set_min_priority(unsigned sched_ctx_id, int min_prio);
+int starpu_sched_ctx_set_max_priority(unsigned sched_ctx_id, int max_prio);
+int starpu_sched_ctx_min_priority_is_set(unsigned sched_ctx_id);
+int starpu_sched_ctx_max_priority_is_set(unsigned sched_ctx_id);
+unsigned starpu_sched_ctx_worker_is_master_for_child_ctx(int workerid, unsigned sched_ctx_id);
+void starpu_sched_ctx_revert_task_counters(unsigned sched_ctx_id, double flops);
+void starpu_sched_ctx_move_task_to_ctx(struct starpu_task *task, unsigned sched_ctx);
+
+#endif /* __MOCK_STARPU_H__ */
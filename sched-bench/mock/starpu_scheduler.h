@@ -0,0 +1,16 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/* The scheduler API is declared with the rest in the mock starpu.h */
+
+#ifndef __MOCK_STARPU_SCHEDULER_H__
+#define __MOCK_STARPU_SCHEDULER_H__
+
+#include <starpu.h>
+
+#endif /* __MOCK_STARPU_SCHEDULER_H__ */
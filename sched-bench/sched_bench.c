@@ -0,0 +1,367 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Micro-benchmarks of the H-Ratio hot paths, against the mock runtime of
+ * mock/: time per operation of push, pop, ratio and rank computation and
+ * dispatch, for several machines, workloads and orderings.
+ *
+ * The policy is compiled in, so that the static functions of pi.c can be
+ * timed on their own:
+ * - push: push_task of the policy, with dispatch while the worker queues
+ *   hold at most thr tasks;
+ * - pop: pop_task of the policy until the worker queues are empty, the
+ *   backlog being released between two rounds of pops;
+ * - ratio: get_task_heter_ratio(), rank: hr_task_rank() with transfers;
+ * - dispatch: hr_dispatch() of tasks taken from the main list.
+ * Nothing executes: queues are emptied by the pops, the pre and post
+ * execution hooks are not called.
+ */
+
+#include "../test-pi/pi.c"
+
+#include "mock_starpu.h"
+
+/* Kernels, one per GPU affinity: the length on a CUDA worker is the CPU one
+ * divided by bench_gpu_speedup */
+#define BENCH_NKERNELS	4
+static const double bench_gpu_speedup[BENCH_NKERNELS] = { 0.5, 2.0, 8.0, 30.0 };
+
+/* Data sizes of the tasks, in bytes: the CPU length is one us per KiB */
+#define BENCH_NSIZES	4
+static const size_t bench_sizes[BENCH_NSIZES] = { 64 << 10, 256 << 10, 1 << 20, 4 << 20 };
+
+/* Successors of each task, for the rank */
+#define BENCH_FANOUT	2
+
+struct bench_machine
+{
+	const char *name;
+	unsigned ncpus;
+	unsigned ncuda;
+};
+
+static const struct bench_machine bench_machines[] =
+{
+	{ "4c+1g", 4, 1 },
+	{ "16c+2g", 16, 2 },
+	{ "56c+8g", 56, 8 },
+};
+
+enum bench_workload
+{
+	BENCH_UNIFORM = 0,	/* one kernel, one size */
+	BENCH_MIXED,		/* all kernels and sizes */
+	BENCH_PARALLEL,		/* parallel kernel, CPUs combined by 4 */
+	BENCH_NWORKLOADS
+};
+
+static const char *bench_workload_names[BENCH_NWORKLOADS] =
+{
+	[BENCH_UNIFORM] = "uniform",
+	[BENCH_MIXED] = "mixed",
+	[BENCH_PARALLEL] = "parallel",
+};
+
+#define BENCH_COMBINED_SIZE 4
+
+enum bench_op
+{
+	BENCH_PUSH = 0,
+	BENCH_POP,
+	BENCH_RATIO,
+	BENCH_RANK,
+	BENCH_DISPATCH,
+	BENCH_NOPS
+};
+
+static const char *bench_op_names[BENCH_NOPS] =
+{
+	[BENCH_PUSH] = "push",
+	[BENCH_POP] = "pop",
+	[BENCH_RATIO] = "ratio",
+	[BENCH_RANK] = "rank",
+	[BENCH_DISPATCH] = "dispatch",
+};
+
+static unsigned bench_ntasks = 4096;
+static unsigned bench_rounds = 3;
+
+/* Keeps the computed keys alive */
+static volatile double bench_sink;
+
+static void bench_kernel(void *descr[] STARPU_ATTRIBUTE_UNUSED, void *cl_arg STARPU_ATTRIBUTE_UNUSED)
+{
+}
+
+static struct starpu_codelet bench_cl[BENCH_NKERNELS + 1];
+static struct starpu_perfmodel bench_model;
+
+static double bench_cost(struct starpu_task *task, struct starpu_perfmodel_arch *arch, unsigned nimpl STARPU_ATTRIBUTE_UNUSED)
+{
+	double length = _starpu_data_get_size(STARPU_TASK_GET_HANDLE(task, 0)) / 1024.0;
+	int kernel = task->cl - bench_cl;
+
+	if (mock_starpu_arch_type(arch) == STARPU_CUDA_WORKER)
+		return length / bench_gpu_speedup[kernel % BENCH_NKERNELS];
+	/* Combined workers do not scale perfectly */
+	return length / pow(mock_starpu_arch_ncores(arch), 0.9);
+}
+
+static void bench_init_codelets(void)
+{
+	int i;
+
+	bench_model.type = STARPU_PER_ARCH;
+	bench_model.arch_cost_function = bench_cost;
+	bench_model.symbol = "sched_bench";
+
+	for (i = 0; i <= BENCH_NKERNELS; i++)
+	{
+		bench_cl[i].cpu_funcs[0] = bench_kernel;
+		bench_cl[i].cuda_funcs[0] = bench_kernel;
+		bench_cl[i].nbuffers = 1;
+		bench_cl[i].modes[0] = STARPU_RW;
+		bench_cl[i].model = &bench_model;
+		bench_cl[i].name = "bench_kernel";
+	}
+	/* The last one is the parallel kernel, on CPUs only */
+	bench_cl[BENCH_NKERNELS].cuda_funcs[0] = NULL;
+	bench_cl[BENCH_NKERNELS].type = STARPU_SPMD;
+	bench_cl[BENCH_NKERNELS].max_parallelism = INT_MAX;
+	bench_cl[BENCH_NKERNELS].name = "bench_parallel_kernel";
+}
+
+static void bench_tasks_init(struct starpu_task *tasks, starpu_data_handle_t *handles,
+			     enum bench_workload workload, unsigned sched_ctx_id)
+{
+	unsigned i, j;
+
+	for (i = 0; i < bench_ntasks; i++)
+	{
+		struct starpu_codelet *cl;
+		starpu_data_handle_t handle;
+
+		switch (workload)
+		{
+		case BENCH_UNIFORM:
+			cl = &bench_cl[BENCH_NKERNELS - 1];
+			handle = handles[1];
+			break;
+		case BENCH_MIXED:
+			cl = &bench_cl[i % BENCH_NKERNELS];
+			handle = handles[(i / BENCH_NKERNELS) % BENCH_NSIZES];
+			break;
+		default:
+			/* Half of the tasks are parallel */
+			cl = &bench_cl[i % 2 ? BENCH_NKERNELS : i % BENCH_NKERNELS];
+			handle = handles[(i / 2) % BENCH_NSIZES];
+			break;
+		}
+		mock_starpu_task_init(&tasks[i], cl, sched_ctx_id);
+		STARPU_TASK_SET_HANDLE(&tasks[i], handle, 0);
+	}
+
+	for (i = 0; i < bench_ntasks; i++)
+		for (j = 1; j <= BENCH_FANOUT && i + j < bench_ntasks; j++)
+			mock_starpu_task_add_succ(&tasks[i], &tasks[i + j]);
+}
+
+static void bench_tasks_clean(struct starpu_task *tasks)
+{
+	unsigned i;
+
+	for (i = 0; i < bench_ntasks; i++)
+		mock_starpu_task_clean(&tasks[i]);
+}
+
+/* Pop every queued task, as the workers would, and release the backlog
+ * between the rounds. Returns the time spent in pop_task, in us. */
+static double bench_drain(struct _starpu_dmda_data *dt, unsigned sched_ctx_id, unsigned long *npopped)
+{
+	double elapsed = 0.0;
+	unsigned i;
+
+	for (;;)
+	{
+		double start = starpu_timing_now();
+		for (i = 0; i < dt->workers.nworkers; i++)
+		{
+			struct starpu_task *task;
+
+			mock_starpu_set_worker(dt->workers.ids[i]);
+			while ((task = hratio_sched_policy.pop_task(sched_ctx_id)) != NULL)
+			{
+				(*npopped)++;
+				if (task->destroy)
+				{
+					/* Alias of a parallel task */
+					mock_starpu_task_clean(task);
+					free(task);
+				}
+			}
+		}
+		elapsed += starpu_timing_now() - start;
+		mock_starpu_set_worker(-1);
+
+		if (dt->main_list_len == 0)
+			break;
+		STARPU_PTHREAD_MUTEX_LOCK(&dt->policy_mutex);
+		hr_release(dt, sched_ctx_id);
+		STARPU_PTHREAD_MUTEX_UNLOCK(&dt->policy_mutex);
+	}
+	return elapsed;
+}
+
+/* The queues were emptied without executing anything */
+static void bench_reset_queues(struct _starpu_dmda_data *dt)
+{
+	double now = starpu_timing_now();
+	unsigned i;
+
+	for (i = 0; i < dt->workers.nworkers; i++)
+	{
+		struct _starpu_fifo_taskq *fifo = dt->queue_array[dt->workers.ids[i]];
+		fifo->exp_start = now;
+		fifo->exp_len = 0.0;
+		fifo->exp_end = now;
+	}
+}
+
+/* One round of each operation over bench_ntasks tasks, adds the time spent
+ * in us and the number of operations to ELAPSED and COUNT */
+static void bench_round(unsigned sched_ctx_id, struct starpu_task *tasks, starpu_data_handle_t *handles,
+			enum bench_workload workload, double *elapsed, unsigned long *count)
+{
+	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
+	double start;
+	unsigned i;
+
+	bench_tasks_init(tasks, handles, workload, sched_ctx_id);
+
+	start = starpu_timing_now();
+	for (i = 0; i < bench_ntasks; i++)
+		bench_sink = get_task_heter_ratio(sched_ctx_id, &tasks[i]);
+	elapsed[BENCH_RATIO] += starpu_timing_now() - start;
+	count[BENCH_RATIO] += bench_ntasks;
+
+	start = starpu_timing_now();
+	for (i = 0; i < bench_ntasks; i++)
+		bench_sink = hr_task_rank(dt, sched_ctx_id, &tasks[i], 1);
+	elapsed[BENCH_RANK] += starpu_timing_now() - start;
+	count[BENCH_RANK] += bench_ntasks;
+
+	start = starpu_timing_now();
+	for (i = 0; i < bench_ntasks; i++)
+		hratio_sched_policy.push_task(&tasks[i]);
+	elapsed[BENCH_PUSH] += starpu_timing_now() - start;
+	count[BENCH_PUSH] += bench_ntasks;
+
+	elapsed[BENCH_POP] += bench_drain(dt, sched_ctx_id, &count[BENCH_POP]);
+	bench_reset_queues(dt);
+
+	/* The same tasks again, as if they were all in the main list */
+	STARPU_PTHREAD_MUTEX_LOCK(&dt->policy_mutex);
+	for (i = 0; i < bench_ntasks; i++)
+		hr_uniform_enter(dt, &tasks[i]);
+	start = starpu_timing_now();
+	for (i = 0; i < bench_ntasks; i++)
+		hr_dispatch(dt, &tasks[i], sched_ctx_id);
+	elapsed[BENCH_DISPATCH] += starpu_timing_now() - start;
+	count[BENCH_DISPATCH] += bench_ntasks;
+	STARPU_PTHREAD_MUTEX_UNLOCK(&dt->policy_mutex);
+
+	unsigned long npopped = 0;
+	bench_drain(dt, sched_ctx_id, &npopped);
+	bench_reset_queues(dt);
+
+	bench_tasks_clean(tasks);
+}
+
+static void bench_run(const struct bench_machine *machine, enum bench_workload workload, enum hr_mode mode,
+		      struct starpu_task *tasks, starpu_data_handle_t *handles)
+{
+	double elapsed[BENCH_NOPS] = { 0.0 };
+	unsigned long count[BENCH_NOPS] = { 0 };
+	unsigned round;
+	int op;
+
+	/* Read by initialize_dmda_policy */
+	setenv("STARPU_HR_MODE", hr_mode_names[mode], 1);
+	setenv("STARPU_HR_COMBINED", workload == BENCH_PARALLEL ? "1" : "0", 1);
+
+	mock_starpu_init(machine->ncpus, machine->ncuda, workload == BENCH_PARALLEL ? BENCH_COMBINED_SIZE : 0);
+	unsigned sched_ctx_id = mock_starpu_ctx_create(&hratio_sched_policy);
+
+	for (round = 0; round < bench_rounds; round++)
+		bench_round(sched_ctx_id, tasks, handles, workload, elapsed, count);
+
+	mock_starpu_ctx_delete(sched_ctx_id);
+	mock_starpu_shutdown();
+
+	printf("%-8s %-9s %-8s", machine->name, bench_workload_names[workload], hr_mode_names[mode]);
+	for (op = 0; op < BENCH_NOPS; op++)
+		printf(" %9.1f", count[op] ? 1000.0 * elapsed[op] / count[op] : 0.0);
+	printf("\n");
+}
+
+static void parse_args(int argc, char **argv)
+{
+	int i;
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-ntasks") == 0 && i + 1 < argc)
+			bench_ntasks = strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-rounds") == 0 && i + 1 < argc)
+			bench_rounds = strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr,"Usage: %s [options...]\n", argv[0]);
+			fprintf(stderr,"\n");
+			fprintf(stderr,"Options:\n");
+			fprintf(stderr,"-ntasks <n>		tasks per round (default 4096)\n");
+			fprintf(stderr,"-rounds <n>		rounds per configuration (default 3)\n");
+			exit(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0 ? 0 : 1);
+		}
+	}
+	if (bench_ntasks == 0 || bench_rounds == 0)
+	{
+		fprintf(stderr, "-ntasks and -rounds must be positive\n");
+		exit(1);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	starpu_data_handle_t handles[BENCH_NSIZES];
+	struct starpu_task *tasks;
+	unsigned m, i;
+	int workload, mode, op;
+
+	parse_args(argc, argv);
+	bench_init_codelets();
+	for (i = 0; i < BENCH_NSIZES; i++)
+		handles[i] = mock_starpu_data_create(bench_sizes[i]);
+	_STARPU_CALLOC(tasks, bench_ntasks, sizeof(*tasks));
+
+	printf("# %u tasks x %u rounds per configuration, ns/op\n", bench_ntasks, bench_rounds);
+	printf("%-8s %-9s %-8s", "machine", "workload", "mode");
+	for (op = 0; op < BENCH_NOPS; op++)
+		printf(" %9s", bench_op_names[op]);
+	printf("\n");
+
+	for (m = 0; m < sizeof(bench_machines) / sizeof(bench_machines[0]); m++)
+		for (workload = 0; workload < BENCH_NWORKLOADS; workload++)
+			for (mode = 0; mode < HR_NMODES; mode++)
+				bench_run(&bench_machines[m], workload, mode, tasks, handles);
+
+	free(tasks);
+	for (i = 0; i < BENCH_NSIZES; i++)
+		mock_starpu_data_destroy(handles[i]);
+	return 0;
+}
@@ -0,0 +1,180 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+#include <starpu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include "sched_energy.h"
+
+#define SCHED_ENERGY_ROOT	"/sys/class/powercap"
+/* Package domains of a machine, one per socket */
+#define SCHED_ENERGY_MAX_DOMAINS	16
+
+struct sched_energy_domain
+{
+	int fd;
+	unsigned long long last;	/* energy_uj at the last read */
+	unsigned long long range;	/* max_energy_range_uj, where it wraps */
+};
+
+static struct sched_energy_domain domains[SCHED_ENERGY_MAX_DOMAINS];
+static unsigned ndomains;
+static unsigned energy_users;
+static pthread_mutex_t energy_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Microjoules since init, and the last power sample */
+static double total_uj;
+static double sample_uj;
+static double sample_date;
+static double power = NAN;
+
+static int energy_read_ull(int fd, unsigned long long *value)
+{
+	char buf[32];
+	ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+	if (n <= 0)
+		return -1;
+	buf[n] = '\0';
+	*value = strtoull(buf, NULL, 10);
+	return 0;
+}
+
+static int energy_open_domain(const char *name)
+{
+	char path[256];
+	struct sched_energy_domain *d = &domains[ndomains];
+	int fd;
+
+	snprintf(path, sizeof(path), SCHED_ENERGY_ROOT "/%s/max_energy_range_uj", name);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (energy_read_ull(fd, &d->range) != 0)
+		d->range = 0;
+	close(fd);
+
+	snprintf(path, sizeof(path), SCHED_ENERGY_ROOT "/%s/energy_uj", name);
+	d->fd = open(path, O_RDONLY);
+	if (d->fd < 0)
+		return -1;
+	if (energy_read_ull(d->fd, &d->last) != 0)
+	{
+		close(d->fd);
+		return -1;
+	}
+	ndomains++;
+	return 0;
+}
+
+/* energy_mutex held */
+static void energy_update(void)
+{
+	unsigned i;
+	for (i = 0; i < ndomains; i++)
+	{
+		struct sched_energy_domain *d = &domains[i];
+		unsigned long long value;
+		if (energy_read_ull(d->fd, &value) != 0)
+			continue;
+		if (value >= d->last)
+			total_uj += value - d->last;
+		else if (d->range > 0)
+			/* Wrapped around */
+			total_uj += d->range - d->last + value;
+		d->last = value;
+	}
+}
+
+unsigned sched_energy_init(void)
+{
+	pthread_mutex_lock(&energy_mutex);
+	if (energy_users++ == 0)
+	{
+		DIR *dir = opendir(SCHED_ENERGY_ROOT);
+		struct dirent *entry;
+		unsigned unreadable = 0;
+
+		while (dir && (entry = readdir(dir)) && ndomains < SCHED_ENERGY_MAX_DOMAINS)
+		{
+			unsigned n;
+			char end;
+			/* intel-rapl:N are the packages, intel-rapl:N:M their
+			 * core, uncore and dram subdomains */
+			if (sscanf(entry->d_name, "intel-rapl:%u%c", &n, &end) != 1)
+				continue;
+			if (energy_open_domain(entry->d_name) != 0)
+				unreadable++;
+		}
+		if (dir)
+			closedir(dir);
+		if (unreadable > 0 && ndomains == 0)
+			/* Only opened when asked for, so always shown */
+			fprintf(stderr, "[sched_energy] cannot read the RAPL counters of %s, CPU energy is not measured\n", SCHED_ENERGY_ROOT);
+
+		total_uj = 0.0;
+		sample_uj = 0.0;
+		sample_date = starpu_timing_now();
+		power = NAN;
+	}
+	unsigned n = ndomains;
+	pthread_mutex_unlock(&energy_mutex);
+	return n;
+}
+
+void sched_energy_release(void)
+{
+	pthread_mutex_lock(&energy_mutex);
+	if (--energy_users == 0)
+	{
+		unsigned i;
+		for (i = 0; i < ndomains; i++)
+			close(domains[i].fd);
+		ndomains = 0;
+	}
+	pthread_mutex_unlock(&energy_mutex);
+}
+
+double sched_energy_cpu_joules(void)
+{
+	double joules = NAN;
+
+	pthread_mutex_lock(&energy_mutex);
+	if (ndomains > 0)
+	{
+		energy_update();
+		joules = total_uj / 1000000.0;
+	}
+	pthread_mutex_unlock(&energy_mutex);
+	return joules;
+}
+
+double sched_energy_cpu_power(void)
+{
+	double now = starpu_timing_now();
+	double watts;
+
+	pthread_mutex_lock(&energy_mutex);
+	if (ndomains > 0 && now - sample_date >= SCHED_ENERGY_PERIOD)
+	{
+		energy_update();
+		/* uJ per us */
+		power = (total_uj - sample_uj) / (now - sample_date);
+		sample_uj = total_uj;
+		sample_date = now;
+	}
+	watts = power;
+	pthread_mutex_unlock(&energy_mutex);
+	return watts;
+}
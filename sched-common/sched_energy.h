@@ -0,0 +1,39 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * CPU package energy from the Linux powercap interface (RAPL).
+ *
+ * The package domains /sys/class/powercap/intel-rapl:N (also exposed for
+ * AMD processors) are opened at policy init, when the policy uses them.
+ * Their energy_uj counters are summed, with wraparound at
+ * max_energy_range_uj, into the joules consumed since init and an average
+ * power refreshed at most every SCHED_ENERGY_PERIOD us.
+ *
+ * Recent kernels only let root read energy_uj; elsewhere, or without
+ * powercap, both values are NAN.
+ */
+
+#ifndef __SCHED_ENERGY_H__
+#define __SCHED_ENERGY_H__
+
+/* Shortest interval in us over which the power is averaged */
+#define SCHED_ENERGY_PERIOD	10000.0
+
+/* Open the package domains, called at policy init. Returns how many are
+ * readable. */
+unsigned sched_energy_init(void);
+/* Close them, called at policy deinit */
+void sched_energy_release(void);
+
+/* Joules consumed by the CPU packages since the first sched_energy_init */
+double sched_energy_cpu_joules(void);
+/* Their power in W, averaged over the last period */
+double sched_energy_cpu_power(void);
+
+#endif /* __SCHED_ENERGY_H__ */
@@ -0,0 +1,109 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sched_log.h"
+
+#define SCHED_LOG_BUFFER_SIZE	(64*1024)
+/* A message longer than that is truncated */
+#define SCHED_LOG_LINE_MAX	1024
+
+struct sched_log_buffer
+{
+	size_t len;
+	char data[SCHED_LOG_BUFFER_SIZE];
+};
+
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_key_t log_key;
+static int log_fd = 2;
+static __thread struct sched_log_buffer *local_buffer;
+
+static const char level_letters[] = "?EWIDT";
+
+static void sched_log_write_buffer(struct sched_log_buffer *buffer)
+{
+	size_t done = 0;
+	while (done < buffer->len)
+	{
+		ssize_t ret = write(log_fd, buffer->data + done, buffer->len - done);
+		if (ret <= 0)
+			break;
+		done += ret;
+	}
+	buffer->len = 0;
+}
+
+static void sched_log_thread_exit(void *arg)
+{
+	struct sched_log_buffer *buffer = arg;
+	sched_log_write_buffer(buffer);
+	free(buffer);
+}
+
+static void sched_log_init_once(void)
+{
+	const char *path = getenv("STARPU_HR_LOG");
+	if (path && path[0])
+	{
+		int fd = open(path, O_WRONLY|O_CREAT|O_TRUNC|O_APPEND, 0644);
+		if (fd >= 0)
+			log_fd = fd;
+		else
+			perror(path);
+	}
+	pthread_key_create(&log_key, sched_log_thread_exit);
+	/* The main thread does not go through the key destructor */
+	atexit(sched_log_flush);
+}
+
+void sched_log_flush(void)
+{
+	if (local_buffer)
+		sched_log_write_buffer(local_buffer);
+}
+
+void sched_log_write(int level, const char *fmt, ...)
+{
+	struct sched_log_buffer *buffer = local_buffer;
+	if (__builtin_expect(!buffer, 0))
+	{
+		pthread_once(&log_once, sched_log_init_once);
+		buffer = local_buffer = calloc(1, sizeof(*buffer));
+		if (!buffer)
+			return;
+		pthread_setspecific(log_key, buffer);
+	}
+
+	if (SCHED_LOG_BUFFER_SIZE - buffer->len < SCHED_LOG_LINE_MAX)
+		sched_log_write_buffer(buffer);
+
+	char *p = buffer->data + buffer->len;
+	int n = snprintf(p, SCHED_LOG_LINE_MAX, "[%c] ", level_letters[level < 0 || level > SCHED_LOG_LEVEL_TRACE ? 0 : level]);
+
+	va_list args;
+	va_start(args, fmt);
+	int m = vsnprintf(p + n, SCHED_LOG_LINE_MAX - n, fmt, args);
+	va_end(args);
+
+	if (m < 0)
+		return;
+	if (n + m >= SCHED_LOG_LINE_MAX)
+	{
+		/* Truncated, keep the line terminated */
+		m = SCHED_LOG_LINE_MAX - n - 1;
+		p[n + m - 1] = '\n';
+	}
+	buffer->len += n + m;
+}
@@ -0,0 +1,76 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Leveled debug messages for the policies.
+ *
+ * The level is chosen at compile time with SCHED_LOG_LEVEL (0, the default,
+ * disables everything). Messages above that level compile to nothing: their
+ * arguments are not even evaluated, only the format is checked. Enabled
+ * messages are formatted into a per-thread buffer, which is written with a
+ * single write() when it gets full and when the thread exits, so that the
+ * hot paths never take a lock nor block on the terminal.
+ *
+ * Messages go to stderr, or to the file named by STARPU_HR_LOG.
+ */
+
+#ifndef __SCHED_LOG_H__
+#define __SCHED_LOG_H__
+
+#define SCHED_LOG_LEVEL_ERROR	1
+#define SCHED_LOG_LEVEL_WARN	2
+#define SCHED_LOG_LEVEL_INFO	3
+#define SCHED_LOG_LEVEL_DEBUG	4
+#define SCHED_LOG_LEVEL_TRACE	5	/* per worker and per implementation */
+
+#ifndef SCHED_LOG_LEVEL
+#define SCHED_LOG_LEVEL 0
+#endif
+
+void sched_log_write(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+/* Write the buffer of the calling thread */
+void sched_log_flush(void);
+
+static inline __attribute__((format(printf, 1, 2))) void sched_log_nop(const char *fmt, ...)
+{
+	(void) fmt;
+}
+
+#define _SCHED_LOG_OFF(fmt, ...) do { if (0) sched_log_nop(fmt, ## __VA_ARGS__); } while (0)
+
+#if SCHED_LOG_LEVEL >= SCHED_LOG_LEVEL_ERROR
+#define SCHED_LOG_ERROR(fmt, ...) sched_log_write(SCHED_LOG_LEVEL_ERROR, fmt, ## __VA_ARGS__)
+#else
+#define SCHED_LOG_ERROR(fmt, ...) _SCHED_LOG_OFF(fmt, ## __VA_ARGS__)
+#endif
+
+#if SCHED_LOG_LEVEL >= SCHED_LOG_LEVEL_WARN
+#define SCHED_LOG_WARN(fmt, ...) sched_log_write(SCHED_LOG_LEVEL_WARN, fmt, ## __VA_ARGS__)
+#else
+#define SCHED_LOG_WARN(fmt, ...) _SCHED_LOG_OFF(fmt, ## __VA_ARGS__)
+#endif
+
+#if SCHED_LOG_LEVEL >= SCHED_LOG_LEVEL_INFO
+#define SCHED_LOG_INFO(fmt, ...) sched_log_write(SCHED_LOG_LEVEL_INFO, fmt, ## __VA_ARGS__)
+#else
+#define SCHED_LOG_INFO(fmt, ...) _SCHED_LOG_OFF(fmt, ## __VA_ARGS__)
+#endif
+
+#if SCHED_LOG_LEVEL >= SCHED_LOG_LEVEL_DEBUG
+#define SCHED_LOG_DEBUG(fmt, ...) sched_log_write(SCHED_LOG_LEVEL_DEBUG, fmt, ## __VA_ARGS__)
+#else
+#define SCHED_LOG_DEBUG(fmt, ...) _SCHED_LOG_OFF(fmt, ## __VA_ARGS__)
+#endif
+
+#if SCHED_LOG_LEVEL >= SCHED_LOG_LEVEL_TRACE
+#define SCHED_LOG_TRACE(fmt, ...) sched_log_write(SCHED_LOG_LEVEL_TRACE, fmt, ## __VA_ARGS__)
+#else
+#define SCHED_LOG_TRACE(fmt, ...) _SCHED_LOG_OFF(fmt, ## __VA_ARGS__)
+#endif
+
+#endif /* __SCHED_LOG_H__ */
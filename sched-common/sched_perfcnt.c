@@ -0,0 +1,285 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+#include <starpu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "sched_perfcnt.h"
+
+/* Number of (codelet, footprint) classes a worker can accumulate, classes
+ * seen once the table is full are dropped */
+#define SCHED_PERFCNT_TABLE_SIZE	256
+
+struct sched_perfcnt_entry
+{
+	struct starpu_codelet *cl;
+	uint32_t footprint;
+	int worker;
+	char name[64];
+	uint64_t ntasks;
+	uint64_t counts[SCHED_PERFCNT_NCOUNTERS];
+};
+
+struct sched_perfcnt_thread
+{
+	struct sched_perfcnt_thread *next;
+	int fds[SCHED_PERFCNT_NCOUNTERS];
+	/* 0 when this thread does not count: not a CPU worker, or the
+	 * kernel refused the events */
+	int usable;
+	int running;
+	unsigned nentries;
+	uint64_t ndropped;
+	struct sched_perfcnt_entry table[SCHED_PERFCNT_TABLE_SIZE];
+};
+
+int sched_perfcnt_enabled = 0;
+
+static char *perfcnt_path;
+static unsigned perfcnt_users;
+static struct sched_perfcnt_thread *perfcnt_threads;
+static pthread_mutex_t perfcnt_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Bumped at each dump, see sched_trace.c */
+static unsigned perfcnt_generation;
+static __thread struct sched_perfcnt_thread *local_thread;
+static __thread unsigned local_generation;
+
+static const char *counter_names[SCHED_PERFCNT_NCOUNTERS] =
+{
+	[SCHED_PERFCNT_CYCLES] = "cycles",
+	[SCHED_PERFCNT_INSTRUCTIONS] = "instructions",
+	[SCHED_PERFCNT_LLC_MISSES] = "llc_misses",
+	[SCHED_PERFCNT_BRANCH_MISSES] = "branch_misses",
+};
+
+void sched_perfcnt_init(void)
+{
+	pthread_mutex_lock(&perfcnt_mutex);
+	if (perfcnt_users++ == 0)
+	{
+		const char *path = getenv("STARPU_HR_PERFCNT");
+		if (path && path[0])
+		{
+#ifdef __linux__
+			perfcnt_path = strdup(path);
+			sched_perfcnt_enabled = 1;
+#else
+			fprintf(stderr, "[sched_perfcnt] hardware counters are only supported on Linux\n");
+#endif
+		}
+	}
+	pthread_mutex_unlock(&perfcnt_mutex);
+}
+
+#ifdef __linux__
+static int perfcnt_open(uint64_t config, int group)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.disabled = group == -1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP;
+
+	/* This thread, any CPU */
+	return syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static void perfcnt_open_group(struct sched_perfcnt_thread *thread)
+{
+	static const uint64_t configs[SCHED_PERFCNT_NCOUNTERS] =
+	{
+		[SCHED_PERFCNT_CYCLES] = PERF_COUNT_HW_CPU_CYCLES,
+		[SCHED_PERFCNT_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS,
+		[SCHED_PERFCNT_LLC_MISSES] = PERF_COUNT_HW_CACHE_MISSES,
+		[SCHED_PERFCNT_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES,
+	};
+	int i;
+
+	for (i = 0; i < SCHED_PERFCNT_NCOUNTERS; i++)
+	{
+		thread->fds[i] = perfcnt_open(configs[i], i == 0 ? -1 : thread->fds[0]);
+		if (thread->fds[i] < 0)
+		{
+			fprintf(stderr, "[sched_perfcnt] cannot open the %s counter, worker %d is not counted\n",
+				counter_names[i], starpu_worker_get_id());
+			while (i-- > 0)
+				close(thread->fds[i]);
+			return;
+		}
+	}
+	thread->usable = 1;
+}
+#endif
+
+static struct sched_perfcnt_thread *sched_perfcnt_new_thread(void)
+{
+	struct sched_perfcnt_thread *thread;
+	int workerid = starpu_worker_get_id();
+
+	thread = calloc(1, sizeof(*thread));
+	STARPU_ASSERT(thread);
+#ifdef __linux__
+	if (workerid >= 0 && starpu_worker_get_type(workerid) == STARPU_CPU_WORKER)
+		perfcnt_open_group(thread);
+#endif
+
+	pthread_mutex_lock(&perfcnt_mutex);
+	thread->next = perfcnt_threads;
+	perfcnt_threads = thread;
+	pthread_mutex_unlock(&perfcnt_mutex);
+
+	return thread;
+}
+
+void sched_perfcnt_start(void)
+{
+	struct sched_perfcnt_thread *thread = local_thread;
+	if (STARPU_UNLIKELY(!thread || local_generation != perfcnt_generation))
+	{
+		thread = local_thread = sched_perfcnt_new_thread();
+		local_generation = perfcnt_generation;
+	}
+	if (!thread->usable)
+		return;
+
+#ifdef __linux__
+	ioctl(thread->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(thread->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	thread->running = 1;
+#endif
+}
+
+static struct sched_perfcnt_entry *perfcnt_lookup(struct sched_perfcnt_thread *thread, struct starpu_codelet *cl, uint32_t footprint, int worker)
+{
+	unsigned hash = ((uintptr_t) cl >> 4) ^ footprint ^ ((unsigned) worker << 16);
+	unsigned i;
+
+	for (i = 0; i < SCHED_PERFCNT_TABLE_SIZE; i++)
+	{
+		struct sched_perfcnt_entry *entry = &thread->table[(hash + i) % SCHED_PERFCNT_TABLE_SIZE];
+		if (entry->ntasks == 0)
+		{
+			const char *name = cl->name;
+			if (!name && cl->model)
+				name = cl->model->symbol;
+			entry->cl = cl;
+			entry->footprint = footprint;
+			entry->worker = worker;
+			snprintf(entry->name, sizeof(entry->name), "%s", name ? name : "unknown");
+			thread->nentries++;
+			return entry;
+		}
+		if (entry->cl == cl && entry->footprint == footprint && entry->worker == worker)
+			return entry;
+	}
+	return NULL;
+}
+
+void sched_perfcnt_stop(struct starpu_codelet *cl, uint32_t footprint, int worker)
+{
+	struct sched_perfcnt_thread *thread = local_thread;
+	if (!thread || !thread->running || local_generation != perfcnt_generation)
+		return;
+	thread->running = 0;
+
+#ifdef __linux__
+	struct
+	{
+		uint64_t nr;
+		uint64_t values[SCHED_PERFCNT_NCOUNTERS];
+	} group;
+	ioctl(thread->fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+	if (read(thread->fds[0], &group, sizeof(group)) != sizeof(group) || !cl)
+		return;
+
+	struct sched_perfcnt_entry *entry = perfcnt_lookup(thread, cl, footprint, worker);
+	if (!entry)
+	{
+		thread->ndropped++;
+		return;
+	}
+
+	int i;
+	entry->ntasks++;
+	for (i = 0; i < SCHED_PERFCNT_NCOUNTERS; i++)
+		entry->counts[i] += group.values[i];
+#endif
+}
+
+void sched_perfcnt_dump(void)
+{
+	pthread_mutex_lock(&perfcnt_mutex);
+	if (--perfcnt_users > 0 || !sched_perfcnt_enabled)
+	{
+		pthread_mutex_unlock(&perfcnt_mutex);
+		return;
+	}
+	sched_perfcnt_enabled = 0;
+
+	FILE *f = fopen(perfcnt_path, "w");
+	if (!f)
+		fprintf(stderr, "[sched_perfcnt] cannot open %s, counters are lost\n", perfcnt_path);
+	else
+		fprintf(f, "codelet,footprint,worker,ntasks,cycles,instructions,llc_misses,branch_misses,ipc,llc_mpki\n");
+
+	struct sched_perfcnt_thread *thread = perfcnt_threads;
+	while (thread)
+	{
+		struct sched_perfcnt_thread *next = thread->next;
+		unsigned i;
+		int c;
+
+		for (i = 0; f && i < SCHED_PERFCNT_TABLE_SIZE; i++)
+		{
+			struct sched_perfcnt_entry *entry = &thread->table[i];
+			if (entry->ntasks == 0)
+				continue;
+
+			uint64_t cycles = entry->counts[SCHED_PERFCNT_CYCLES];
+			uint64_t instructions = entry->counts[SCHED_PERFCNT_INSTRUCTIONS];
+			fprintf(f, "%s,%08x,%d,%llu", entry->name, entry->footprint, entry->worker,
+				(unsigned long long) entry->ntasks);
+			for (c = 0; c < SCHED_PERFCNT_NCOUNTERS; c++)
+				fprintf(f, ",%llu", (unsigned long long) entry->counts[c]);
+			fprintf(f, ",%.3f,%.3f\n",
+				cycles ? (double) instructions / cycles : 0.0,
+				instructions ? 1000.0 * entry->counts[SCHED_PERFCNT_LLC_MISSES] / instructions : 0.0);
+		}
+		if (thread->ndropped)
+			fprintf(stderr, "[sched_perfcnt] %llu executions dropped, more than %d codelet/footprint classes\n",
+				(unsigned long long) thread->ndropped, SCHED_PERFCNT_TABLE_SIZE);
+
+		if (thread->usable)
+			for (c = 0; c < SCHED_PERFCNT_NCOUNTERS; c++)
+				close(thread->fds[c]);
+		free(thread);
+		thread = next;
+	}
+
+	if (f)
+		fclose(f);
+	perfcnt_threads = NULL;
+	perfcnt_generation++;
+	free(perfcnt_path);
+	perfcnt_path = NULL;
+	pthread_mutex_unlock(&perfcnt_mutex);
+}
@@ -0,0 +1,59 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Optional hardware performance counters around CPU codelet executions.
+ *
+ * When STARPU_HR_PERFCNT is set to an output file name, each CPU worker opens
+ * a perf_event_open group (cycles, instructions, LLC misses, branch misses)
+ * for its own thread. The group is reset and enabled in the pre_exec hook and
+ * read in the post_exec hook. Counts are aggregated per codelet, footprint and
+ * worker in per-thread tables, and written as CSV at policy deinit, along with
+ * IPC and LLC misses per kilo-instruction.
+ *
+ * Only Linux is supported; elsewhere, or when the kernel refuses the events
+ * (see /proc/sys/kernel/perf_event_paranoid), nothing is collected.
+ */
+
+#ifndef __SCHED_PERFCNT_H__
+#define __SCHED_PERFCNT_H__
+
+#include <stdint.h>
+
+struct starpu_codelet;
+
+enum sched_perfcnt_counter
+{
+	SCHED_PERFCNT_CYCLES = 0,
+	SCHED_PERFCNT_INSTRUCTIONS,
+	SCHED_PERFCNT_LLC_MISSES,
+	SCHED_PERFCNT_BRANCH_MISSES,
+	SCHED_PERFCNT_NCOUNTERS
+};
+
+extern int sched_perfcnt_enabled;
+
+/* Read STARPU_HR_PERFCNT, called at policy init */
+void sched_perfcnt_init(void);
+/* Write the aggregated counts and close the counters, called at policy deinit */
+void sched_perfcnt_dump(void);
+
+void sched_perfcnt_start(void);
+void sched_perfcnt_stop(struct starpu_codelet *cl, uint32_t footprint, int worker);
+
+#define SCHED_PERFCNT_START() do { \
+	if (__builtin_expect(sched_perfcnt_enabled, 0)) \
+		sched_perfcnt_start(); \
+} while (0)
+
+#define SCHED_PERFCNT_STOP(cl, footprint, worker) do { \
+	if (__builtin_expect(sched_perfcnt_enabled, 0)) \
+		sched_perfcnt_stop((cl), (footprint), (worker)); \
+} while (0)
+
+#endif /* __SCHED_PERFCNT_H__ */
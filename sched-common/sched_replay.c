@@ -0,0 +1,160 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+#include <starpu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "sched_replay.h"
+
+int sched_replay_recording;
+
+static unsigned replay_users;
+static pthread_mutex_t replay_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Recorded decisions, in decision order */
+static char *record_path;
+static struct sched_replay_decision *recorded;
+static unsigned long nrecorded;
+static unsigned long record_size;
+
+/* Loaded decisions, sorted by job id */
+static struct sched_replay_decision *loaded;
+static unsigned long nloaded;
+
+static int replay_job_cmp(const void *a, const void *b)
+{
+	const struct sched_replay_decision *da = a;
+	const struct sched_replay_decision *db = b;
+	return da->job_id < db->job_id ? -1 : da->job_id > db->job_id;
+}
+
+static void replay_load(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	unsigned long size = 0;
+	char line[256];
+
+	if (!f)
+	{
+		fprintf(stderr, "[sched_replay] cannot open %s, nothing is replayed\n", path);
+		return;
+	}
+	while (fgets(line, sizeof(line), f))
+	{
+		unsigned long long order, job_id;
+		int worker;
+		unsigned impl;
+
+		if (line[0] == '#' || sscanf(line, "%llu %llu %d %u", &order, &job_id, &worker, &impl) != 4)
+			continue;
+		if (nloaded == size)
+		{
+			size = size ? 2 * size : 1024;
+			loaded = realloc(loaded, size * sizeof(*loaded));
+			STARPU_ASSERT(loaded);
+		}
+		loaded[nloaded].order = order;
+		loaded[nloaded].job_id = job_id;
+		loaded[nloaded].worker = worker;
+		loaded[nloaded].impl = impl;
+		nloaded++;
+	}
+	fclose(f);
+	qsort(loaded, nloaded, sizeof(*loaded), replay_job_cmp);
+}
+
+static void replay_write(void)
+{
+	FILE *f = fopen(record_path, "w");
+	unsigned long i;
+
+	if (!f)
+	{
+		fprintf(stderr, "[sched_replay] cannot write %s, the decisions are not recorded\n", record_path);
+		return;
+	}
+	fprintf(f, "# order job_id worker impl\n");
+	for (i = 0; i < nrecorded; i++)
+		fprintf(f, "%llu %llu %d %u\n", (unsigned long long) recorded[i].order,
+			(unsigned long long) recorded[i].job_id, recorded[i].worker, recorded[i].impl);
+	fclose(f);
+}
+
+unsigned long sched_replay_init(void)
+{
+	pthread_mutex_lock(&replay_mutex);
+	if (replay_users++ == 0)
+	{
+		const char *path = getenv("STARPU_HR_RECORD");
+		if (path && path[0])
+		{
+			record_path = strdup(path);
+			nrecorded = 0;
+			sched_replay_recording = 1;
+		}
+		path = getenv("STARPU_HR_REPLAY");
+		if (path && path[0])
+			replay_load(path);
+	}
+	unsigned long n = nloaded;
+	pthread_mutex_unlock(&replay_mutex);
+	return n;
+}
+
+void sched_replay_release(void)
+{
+	pthread_mutex_lock(&replay_mutex);
+	if (--replay_users == 0)
+	{
+		if (sched_replay_recording)
+		{
+			sched_replay_recording = 0;
+			replay_write();
+			free(record_path);
+			record_path = NULL;
+		}
+		free(recorded);
+		recorded = NULL;
+		nrecorded = record_size = 0;
+		free(loaded);
+		loaded = NULL;
+		nloaded = 0;
+	}
+	pthread_mutex_unlock(&replay_mutex);
+}
+
+void sched_replay_record(uint64_t job_id, int worker, unsigned impl)
+{
+	pthread_mutex_lock(&replay_mutex);
+	if (nrecorded == record_size)
+	{
+		record_size = record_size ? 2 * record_size : 4096;
+		recorded = realloc(recorded, record_size * sizeof(*recorded));
+		STARPU_ASSERT(recorded);
+	}
+	/* The order is taken under the lock, as the slot */
+	recorded[nrecorded].order = nrecorded;
+	recorded[nrecorded].job_id = job_id;
+	recorded[nrecorded].worker = worker;
+	recorded[nrecorded].impl = impl;
+	nrecorded++;
+	pthread_mutex_unlock(&replay_mutex);
+}
+
+const struct sched_replay_decision *sched_replay_find(uint64_t job_id)
+{
+	struct sched_replay_decision key = { .job_id = job_id };
+
+	/* Read-only between init and release */
+	if (nloaded == 0)
+		return NULL;
+	return bsearch(&key, loaded, nloaded, sizeof(*loaded), replay_job_cmp);
+}
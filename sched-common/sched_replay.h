@@ -0,0 +1,56 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Record and replay of placement decisions.
+ *
+ * With STARPU_HR_RECORD=<file>, every task placed on a worker queue is
+ * logged, and the log is written at policy deinit as text, one decision per
+ * line in decision order:
+ *   <order> <job id> <worker> <implementation>
+ * Lines starting with '#' are comments. With STARPU_HR_REPLAY=<file>, such
+ * a log is loaded at policy init, and the policy looks the decision of each
+ * task up by job id. Lines may be edited, or removed, to change a single
+ * decision of the replayed run.
+ *
+ * Job ids are given by StarPU at submission: they only match between runs
+ * which submit the same tasks in the same order.
+ */
+
+#ifndef __SCHED_REPLAY_H__
+#define __SCHED_REPLAY_H__
+
+#include <stdint.h>
+
+struct sched_replay_decision
+{
+	uint64_t order;
+	uint64_t job_id;
+	int worker;			/* combined workers included */
+	unsigned impl;
+};
+
+extern int sched_replay_recording;
+
+/* Read STARPU_HR_RECORD and STARPU_HR_REPLAY, called at policy init.
+ * Returns the number of decisions to replay. */
+unsigned long sched_replay_init(void);
+/* Write the recorded decisions and release the loaded ones, called at
+ * policy deinit */
+void sched_replay_release(void);
+
+void sched_replay_record(uint64_t job_id, int worker, unsigned impl);
+/* The loaded decision of JOB_ID, NULL when there is none */
+const struct sched_replay_decision *sched_replay_find(uint64_t job_id);
+
+#define SCHED_REPLAY_RECORD(job_id, worker, impl) do { \
+	if (__builtin_expect(sched_replay_recording, 0)) \
+		sched_replay_record((job_id), (worker), (impl)); \
+} while (0)
+
+#endif /* __SCHED_REPLAY_H__ */
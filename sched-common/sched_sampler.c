@@ -0,0 +1,131 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+#include <starpu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "sched_sampler.h"
+
+#define SCHED_SAMPLER_INTERVAL_DEFAULT	1000
+
+static pthread_mutex_t sampler_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t sampler_thread;
+static int sampler_running;
+static volatile int sampler_stopping;
+
+static sched_sampler_snapshot_func sampler_snapshot;
+static void *sampler_arg;
+static FILE *sampler_file;
+static int sampler_binary;
+static long sampler_interval;
+
+static void *sched_sampler_loop(void *unused STARPU_ATTRIBUTE_UNUSED)
+{
+	struct sched_sampler_worker workers[STARPU_NMAXWORKERS];
+	struct timespec delay =
+	{
+		.tv_sec = sampler_interval / 1000000,
+		.tv_nsec = (sampler_interval % 1000000) * 1000
+	};
+
+	while (!sampler_stopping)
+	{
+		unsigned backlog = 0;
+		unsigned n = sampler_snapshot(sampler_arg, workers, STARPU_NMAXWORKERS, &backlog);
+		double now = starpu_timing_now();
+		unsigned i;
+
+		for (i = 0; i < n; i++)
+		{
+			if (sampler_binary)
+			{
+				struct sched_sampler_record record =
+				{
+					.time = now,
+					.exp_len = workers[i].exp_len,
+					.worker = workers[i].worker,
+					.ntasks = workers[i].ntasks,
+					.backlog = backlog,
+					.busy = workers[i].busy
+				};
+				fwrite(&record, sizeof(record), 1, sampler_file);
+			}
+			else
+				fprintf(sampler_file, "%.3f,%d,%u,%.3f,%d,%u\n", now, workers[i].worker,
+					workers[i].ntasks, workers[i].exp_len, workers[i].busy, backlog);
+		}
+
+		nanosleep(&delay, NULL);
+	}
+
+	return NULL;
+}
+
+int sched_sampler_start(sched_sampler_snapshot_func snapshot, void *arg)
+{
+	const char *path = getenv("STARPU_HR_SAMPLE");
+	if (!path || !path[0])
+		return 0;
+
+	pthread_mutex_lock(&sampler_mutex);
+	if (sampler_running)
+	{
+		pthread_mutex_unlock(&sampler_mutex);
+		return -EBUSY;
+	}
+
+	const char *ext = strrchr(path, '.');
+	sampler_binary = ext && strcmp(ext, ".bin") == 0;
+	sampler_file = fopen(path, sampler_binary ? "wb" : "w");
+	if (!sampler_file)
+	{
+		fprintf(stderr, "[sched_sampler] cannot open %s, sampling disabled\n", path);
+		pthread_mutex_unlock(&sampler_mutex);
+		return -errno;
+	}
+	if (!sampler_binary)
+		fprintf(sampler_file, "time_us,worker,ntasks,exp_len_us,busy,backlog\n");
+
+	sampler_interval = starpu_get_env_number_default("STARPU_HR_SAMPLE_INTERVAL", SCHED_SAMPLER_INTERVAL_DEFAULT);
+	if (sampler_interval <= 0)
+		sampler_interval = SCHED_SAMPLER_INTERVAL_DEFAULT;
+	sampler_snapshot = snapshot;
+	sampler_arg = arg;
+	sampler_stopping = 0;
+	int ret = pthread_create(&sampler_thread, NULL, sched_sampler_loop, NULL);
+	if (ret != 0)
+	{
+		fprintf(stderr, "[sched_sampler] cannot start the sampler thread: %s, sampling disabled\n", strerror(ret));
+		fclose(sampler_file);
+		sampler_file = NULL;
+		pthread_mutex_unlock(&sampler_mutex);
+		return -ret;
+	}
+	sampler_running = 1;
+	pthread_mutex_unlock(&sampler_mutex);
+	return 0;
+}
+
+void sched_sampler_stop(void *arg)
+{
+	pthread_mutex_lock(&sampler_mutex);
+	if (sampler_running && sampler_arg == arg)
+	{
+		sampler_stopping = 1;
+		pthread_join(sampler_thread, NULL);
+		fclose(sampler_file);
+		sampler_file = NULL;
+		sampler_running = 0;
+	}
+	pthread_mutex_unlock(&sampler_mutex);
+}
@@ -0,0 +1,58 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Background time-series sampler of the policy state.
+ *
+ * A thread wakes up every STARPU_HR_SAMPLE_INTERVAL us (default 1000) and
+ * asks the policy for a snapshot: per-worker queue length, exp_len and
+ * busy/idle state, plus the size of the main-list backlog. The snapshot
+ * callback must not take the policy locks, it only reads counters which are
+ * maintained atomically or may be read with races, of queues which the
+ * policy keeps allocated until deinit.
+ *
+ * Sampling is enabled by setting STARPU_HR_SAMPLE to the output file name.
+ * Files ending with ".bin" get packed sched_sampler_record entries, other
+ * files get CSV rows.
+ */
+
+#ifndef __SCHED_SAMPLER_H__
+#define __SCHED_SAMPLER_H__
+
+#include <stdint.h>
+
+struct sched_sampler_worker
+{
+	int worker;
+	unsigned ntasks;
+	double exp_len;
+	int busy;
+};
+
+/* Layout of the binary output, one record per worker and per sample */
+struct sched_sampler_record
+{
+	double time;
+	double exp_len;
+	int32_t worker;
+	uint32_t ntasks;
+	uint32_t backlog;
+	int32_t busy;
+};
+
+/* Fill at most MAX entries of WORKERS, store the main-list backlog in
+ * BACKLOG and return the number of entries filled */
+typedef unsigned (*sched_sampler_snapshot_func)(void *arg, struct sched_sampler_worker *workers, unsigned max, unsigned *backlog);
+
+/* Start the sampler if STARPU_HR_SAMPLE is set. Only one policy instance is
+ * sampled at a time, returns -EBUSY if another one already is. */
+int sched_sampler_start(sched_sampler_snapshot_func snapshot, void *arg);
+/* Stop the sampler started with ARG, if any, and flush the output */
+void sched_sampler_stop(void *arg);
+
+#endif /* __SCHED_SAMPLER_H__ */
@@ -0,0 +1,229 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+#include <starpu.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "sched_share.h"
+
+#define SCHED_SHARE_SLACK_DEFAULT	10000.0
+
+struct sched_share_tenant
+{
+	/* Set and cleared under share_mutex, the charges are read with races */
+	int registered;
+	/* Release callbacks of the tenant running outside of share_mutex:
+	 * unregistering waits for them, its arg is freed afterwards */
+	unsigned users;
+	unsigned sched_ctx_id;
+	double weight;
+	/* Accelerator time used for the fairness, which may be raised to
+	 * bound the credit of an idle tenant, and actually charged, in us */
+	double used;
+	double charged;
+	int waiting;
+	sched_share_backlog_func backlog;
+	sched_share_release_func release;
+	void *arg;
+	pthread_mutex_t mutex;
+};
+
+static struct sched_share_tenant tenants[STARPU_NMAX_SCHED_CTXS];
+static pthread_mutex_t share_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t share_cond = PTHREAD_COND_INITIALIZER;
+/* Tenants waiting, so that poking nobody costs no lock */
+static unsigned share_nwaiting;
+static double share_slack = SCHED_SHARE_SLACK_DEFAULT;
+
+struct sched_share_tenant *sched_share_register(unsigned sched_ctx_id, sched_share_backlog_func backlog,
+						sched_share_release_func release, void *arg)
+{
+	const char *enabled = getenv("STARPU_HR_SHARE");
+	if (!enabled || !enabled[0] || sched_ctx_id >= STARPU_NMAX_SCHED_CTXS)
+		return NULL;
+
+	struct sched_share_tenant *tenant = &tenants[sched_ctx_id];
+	pthread_mutex_lock(&share_mutex);
+	share_slack = starpu_get_env_float_default("STARPU_HR_SHARE_SLACK", SCHED_SHARE_SLACK_DEFAULT);
+	if (!tenant->weight)
+		/* Unless set with sched_share_set_weight() beforehand */
+		tenant->weight = 1.0;
+	tenant->sched_ctx_id = sched_ctx_id;
+	tenant->used = 0.0;
+	tenant->charged = 0.0;
+	tenant->waiting = 0;
+	tenant->users = 0;
+	tenant->backlog = backlog;
+	tenant->release = release;
+	tenant->arg = arg;
+	pthread_mutex_init(&tenant->mutex, NULL);
+	__atomic_store_n(&tenant->registered, 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&share_mutex);
+
+	return tenant;
+}
+
+void sched_share_unregister(struct sched_share_tenant *tenant)
+{
+	double used, share;
+
+	if (!tenant)
+		return;
+
+	if (sched_share_get_usage(tenant->sched_ctx_id, &used, &share) == 0)
+		fprintf(stderr, "[sched_share] context %u: weight %.2f, accelerator time %.0f us, %.1f%% of the total\n",
+			tenant->sched_ctx_id, tenant->weight, used, 100.0 * share);
+
+	/* Unlinked: the other tenants no longer call its callbacks, except
+	 * for the release calls already started */
+	pthread_mutex_lock(&share_mutex);
+	__atomic_store_n(&tenant->registered, 0, __ATOMIC_RELEASE);
+	if (__atomic_exchange_n(&tenant->waiting, 0, __ATOMIC_ACQ_REL))
+		__atomic_sub_fetch(&share_nwaiting, 1, __ATOMIC_RELAXED);
+	while (tenant->users > 0)
+		pthread_cond_wait(&share_cond, &share_mutex);
+	tenant->weight = 0.0;
+	pthread_mutex_unlock(&share_mutex);
+	pthread_mutex_destroy(&tenant->mutex);
+}
+
+int sched_share_set_weight(unsigned sched_ctx_id, double weight)
+{
+	if (sched_ctx_id >= STARPU_NMAX_SCHED_CTXS || weight <= 0.0)
+		return -EINVAL;
+
+	struct sched_share_tenant *tenant = &tenants[sched_ctx_id];
+	pthread_mutex_lock(&share_mutex);
+	if (tenant->registered)
+	{
+		/* Keep the virtual time */
+		pthread_mutex_lock(&tenant->mutex);
+		tenant->used *= weight / tenant->weight;
+		tenant->weight = weight;
+		pthread_mutex_unlock(&tenant->mutex);
+	}
+	else
+		tenant->weight = weight;
+	pthread_mutex_unlock(&share_mutex);
+	return 0;
+}
+
+int sched_share_get_usage(unsigned sched_ctx_id, double *used, double *share)
+{
+	double total = 0.0;
+	unsigned i;
+
+	if (sched_ctx_id >= STARPU_NMAX_SCHED_CTXS)
+		return -ENOENT;
+
+	pthread_mutex_lock(&share_mutex);
+	if (!tenants[sched_ctx_id].registered)
+	{
+		pthread_mutex_unlock(&share_mutex);
+		return -ENOENT;
+	}
+	for (i = 0; i < STARPU_NMAX_SCHED_CTXS; i++)
+		if (tenants[i].registered)
+			total += tenants[i].charged;
+	*used = tenants[sched_ctx_id].charged;
+	*share = total > 0.0 ? *used / total : 0.0;
+	pthread_mutex_unlock(&share_mutex);
+	return 0;
+}
+
+int sched_share_may_use(struct sched_share_tenant *tenant)
+{
+	double mine = tenant->used / tenant->weight;
+	double least = mine;
+	int others = 0, ret;
+	unsigned i;
+
+	/* Keeps the others registered while their backlog is read */
+	pthread_mutex_lock(&share_mutex);
+	for (i = 0; i < STARPU_NMAX_SCHED_CTXS; i++)
+	{
+		struct sched_share_tenant *other = &tenants[i];
+		if (other == tenant || !other->registered)
+			continue;
+		if (other->backlog(other->arg) == 0)
+			continue;
+		/* Read with races, the charge only grows */
+		double vtime = other->used / other->weight;
+		if (!others || vtime < least)
+			least = vtime;
+		others = 1;
+	}
+	if (!others)
+		ret = 1;
+	else if (mine < least - share_slack)
+	{
+		/* Back from idle: do not use the credit it banked */
+		pthread_mutex_lock(&tenant->mutex);
+		tenant->used = STARPU_MAX(tenant->used, (least - share_slack) * tenant->weight);
+		pthread_mutex_unlock(&tenant->mutex);
+		ret = 1;
+	}
+	else
+		ret = mine <= least + share_slack;
+	pthread_mutex_unlock(&share_mutex);
+	return ret;
+}
+
+void sched_share_charge(struct sched_share_tenant *tenant, double us)
+{
+	pthread_mutex_lock(&tenant->mutex);
+	tenant->used += us;
+	tenant->charged += us;
+	pthread_mutex_unlock(&tenant->mutex);
+}
+
+void sched_share_poke(struct sched_share_tenant *tenant)
+{
+	struct sched_share_tenant *woken[STARPU_NMAX_SCHED_CTXS];
+	unsigned i, n = 0;
+
+	if (__atomic_load_n(&share_nwaiting, __ATOMIC_ACQUIRE) == 0)
+		return;
+
+	pthread_mutex_lock(&share_mutex);
+	for (i = 0; i < STARPU_NMAX_SCHED_CTXS; i++)
+	{
+		struct sched_share_tenant *other = &tenants[i];
+		if (other == tenant || !other->registered)
+			continue;
+		if (__atomic_exchange_n(&other->waiting, 0, __ATOMIC_ACQ_REL))
+		{
+			__atomic_sub_fetch(&share_nwaiting, 1, __ATOMIC_RELAXED);
+			other->users++;
+			woken[n++] = other;
+		}
+	}
+	pthread_mutex_unlock(&share_mutex);
+
+	/* Without lock: the callbacks dispatch, and may poke in turn */
+	for (i = 0; i < n; i++)
+		woken[i]->release(woken[i]->arg, woken[i]->sched_ctx_id);
+
+	if (n > 0)
+	{
+		pthread_mutex_lock(&share_mutex);
+		for (i = 0; i < n; i++)
+			woken[i]->users--;
+		pthread_cond_broadcast(&share_cond);
+		pthread_mutex_unlock(&share_mutex);
+	}
+}
+
+void sched_share_wait(struct sched_share_tenant *tenant)
+{
+	if (!__atomic_exchange_n(&tenant->waiting, 1, __ATOMIC_ACQ_REL))
+		__atomic_add_fetch(&share_nwaiting, 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,63 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Weighted fair sharing of the accelerators between scheduling contexts.
+ *
+ * Each context (tenant) registers with a weight and is charged the time its
+ * tasks spend on accelerators. Its virtual time is that charge divided by
+ * its weight. A tenant whose virtual time is more than STARPU_HR_SHARE_SLACK
+ * us (default 10000) ahead of the least served active tenant may not place
+ * tasks on accelerators until the others catch up; its CPU placements and
+ * the order of its own tasks are not affected. A tenant is active while it
+ * has a backlog, as reported by its callback, and an idle tenant does not
+ * bank more than the slack in credit.
+ *
+ * A tenant which held tasks back calls sched_share_wait(). Its release
+ * callback is called, without any lock held, when another tenant pokes the
+ * others: after each execution of one of its tasks, and when its backlog
+ * drains.
+ *
+ * Sharing is enabled by setting STARPU_HR_SHARE. Each tenant reports its
+ * accelerator time and share on stderr when it unregisters.
+ */
+
+#ifndef __SCHED_SHARE_H__
+#define __SCHED_SHARE_H__
+
+struct sched_share_tenant;
+
+/* Number of tasks the tenant has queued, 0 when it does not compete */
+typedef unsigned (*sched_share_backlog_func)(void *arg);
+typedef void (*sched_share_release_func)(void *arg, unsigned sched_ctx_id);
+
+/* Returns NULL when STARPU_HR_SHARE is not set */
+struct sched_share_tenant *sched_share_register(unsigned sched_ctx_id, sched_share_backlog_func backlog,
+						sched_share_release_func release, void *arg);
+void sched_share_unregister(struct sched_share_tenant *tenant);
+
+/* Weight of the context, 1 by default. Returns -ENOENT when the context did
+ * not register. */
+int sched_share_set_weight(unsigned sched_ctx_id, double weight);
+/* Accelerator time charged to the context in us, and its share of the total
+ * charged to all the contexts. Returns -ENOENT when the context did not
+ * register. */
+int sched_share_get_usage(unsigned sched_ctx_id, double *used, double *share);
+
+/* Whether TENANT may place tasks on accelerators now. Takes a lock, call it
+ * once per decision. */
+int sched_share_may_use(struct sched_share_tenant *tenant);
+/* Charge US of accelerator time to TENANT */
+void sched_share_charge(struct sched_share_tenant *tenant, double us);
+/* The charge or the backlog of TENANT changed: call the release callbacks
+ * of the waiting tenants. Must be called without any lock of the policy. */
+void sched_share_poke(struct sched_share_tenant *tenant);
+/* TENANT holds tasks until sched_share_may_use() changes */
+void sched_share_wait(struct sched_share_tenant *tenant);
+
+#endif /* __SCHED_SHARE_H__ */
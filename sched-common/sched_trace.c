@@ -0,0 +1,155 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+#include <starpu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "sched_trace.h"
+
+#define SCHED_TRACE_BUFFER_DEFAULT	(1 << 16)
+
+struct sched_trace_buffer
+{
+	struct sched_trace_buffer *next;
+	int thread;
+	int worker;
+	/* only written by the owner thread */
+	uint64_t head;
+	uint64_t mask;
+	struct sched_trace_event events[];
+};
+
+int sched_trace_enabled = 0;
+
+static char *trace_path;
+static uint64_t trace_capacity;
+static unsigned trace_users;
+static int trace_nthreads;
+static struct sched_trace_buffer *trace_buffers;
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Bumped at each dump, so that threads do not reuse a freed buffer when
+ * tracing is enabled again */
+static unsigned trace_generation;
+static __thread struct sched_trace_buffer *local_buffer;
+static __thread unsigned local_generation;
+
+void sched_trace_init(void)
+{
+	pthread_mutex_lock(&trace_mutex);
+	if (trace_users++ == 0)
+	{
+		const char *path = getenv("STARPU_HR_TRACE");
+		if (path && path[0])
+		{
+			uint64_t wanted = starpu_get_env_number_default("STARPU_HR_TRACE_BUFFER", SCHED_TRACE_BUFFER_DEFAULT);
+			trace_capacity = 1;
+			while (trace_capacity < wanted)
+				trace_capacity <<= 1;
+			trace_path = strdup(path);
+			sched_trace_enabled = 1;
+		}
+	}
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+static struct sched_trace_buffer *sched_trace_new_buffer(void)
+{
+	struct sched_trace_buffer *buffer = malloc(sizeof(*buffer) + trace_capacity*sizeof(struct sched_trace_event));
+	STARPU_ASSERT(buffer);
+	buffer->head = 0;
+	buffer->mask = trace_capacity - 1;
+	buffer->worker = starpu_worker_get_id();
+
+	/* Registration is the only locked operation, done once per thread */
+	pthread_mutex_lock(&trace_mutex);
+	buffer->thread = trace_nthreads++;
+	buffer->next = trace_buffers;
+	trace_buffers = buffer;
+	pthread_mutex_unlock(&trace_mutex);
+
+	return buffer;
+}
+
+void sched_trace_record(enum sched_trace_event_type type, uint64_t job_id, int worker, double value)
+{
+	struct sched_trace_buffer *buffer = local_buffer;
+	if (STARPU_UNLIKELY(!buffer || local_generation != trace_generation))
+	{
+		buffer = local_buffer = sched_trace_new_buffer();
+		local_generation = trace_generation;
+	}
+
+	struct sched_trace_event *ev = &buffer->events[buffer->head & buffer->mask];
+	ev->time = starpu_timing_now();
+	ev->value = value;
+	ev->job_id = job_id;
+	ev->type = type;
+	ev->worker = worker;
+	buffer->head++;
+}
+
+void sched_trace_dump(void)
+{
+	pthread_mutex_lock(&trace_mutex);
+	if (--trace_users > 0 || !sched_trace_enabled)
+	{
+		pthread_mutex_unlock(&trace_mutex);
+		return;
+	}
+	sched_trace_enabled = 0;
+
+	FILE *f = fopen(trace_path, "wb");
+	if (!f)
+		fprintf(stderr, "[sched_trace] cannot open %s, trace is lost\n", trace_path);
+
+	struct sched_trace_file_header header =
+	{
+		.magic = SCHED_TRACE_MAGIC,
+		.version = SCHED_TRACE_VERSION,
+		.nthreads = trace_nthreads
+	};
+	if (f)
+		fwrite(&header, sizeof(header), 1, f);
+
+	struct sched_trace_buffer *buffer = trace_buffers;
+	while (buffer)
+	{
+		struct sched_trace_buffer *next = buffer->next;
+		uint64_t capacity = buffer->mask + 1;
+		uint64_t first = buffer->head > capacity ? buffer->head - capacity : 0;
+		struct sched_trace_thread_header thread =
+		{
+			.thread = buffer->thread,
+			.worker = buffer->worker,
+			.nevents = buffer->head - first,
+			.ndropped = first
+		};
+
+		if (f)
+		{
+			uint64_t i;
+			fwrite(&thread, sizeof(thread), 1, f);
+			for (i = first; i < buffer->head; i++)
+				fwrite(&buffer->events[i & buffer->mask], sizeof(struct sched_trace_event), 1, f);
+		}
+		free(buffer);
+		buffer = next;
+	}
+
+	if (f)
+		fclose(f);
+	trace_buffers = NULL;
+	trace_nthreads = 0;
+	trace_generation++;
+	free(trace_path);
+	trace_path = NULL;
+	pthread_mutex_unlock(&trace_mutex);
+}
@@ -0,0 +1,84 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Opt-in recorder of scheduling decisions.
+ *
+ * Every thread which records an event gets its own ring buffer, so that
+ * recording never takes a lock: the owner thread is the only writer. The
+ * buffers are dumped in a binary file when the policy is deinitialized, and
+ * sched_trace_convert turns that file into Chrome trace JSON (also read by
+ * Perfetto) or Paje.
+ *
+ * The recorder is enabled by setting STARPU_HR_TRACE to the output file
+ * name. When it is disabled, SCHED_TRACE() costs a single well-predicted
+ * branch.
+ */
+
+#ifndef __SCHED_TRACE_H__
+#define __SCHED_TRACE_H__
+
+#include <stdint.h>
+
+#define SCHED_TRACE_MAGIC	0x45434152544843ULL	/* "CHTRACE" */
+#define SCHED_TRACE_VERSION	1
+
+enum sched_trace_event_type
+{
+	SCHED_TRACE_PUSH = 0,		/* task pushed to the policy */
+	SCHED_TRACE_RATIO,		/* value: heterogeneity ratio */
+	SCHED_TRACE_RANK,		/* value: rank */
+	SCHED_TRACE_CANDIDATE,		/* worker: candidate, value: expected finish time */
+	SCHED_TRACE_DECISION,		/* worker: chosen one, value: expected finish time */
+	SCHED_TRACE_POP,		/* worker: the one popping the task */
+	SCHED_TRACE_PRE_EXEC,
+	SCHED_TRACE_POST_EXEC,
+	SCHED_TRACE_NTYPES
+};
+
+struct sched_trace_event
+{
+	double time;			/* starpu_timing_now(), in us */
+	double value;
+	uint64_t job_id;
+	uint32_t type;
+	int32_t worker;
+};
+
+/* On-disk layout: one sched_trace_file_header, then for each thread one
+ * sched_trace_thread_header followed by its nevents events, oldest first. */
+struct sched_trace_file_header
+{
+	uint64_t magic;
+	uint32_t version;
+	uint32_t nthreads;
+};
+
+struct sched_trace_thread_header
+{
+	int32_t thread;			/* recording order of the thread */
+	int32_t worker;			/* StarPU worker running that thread, -1 for application threads */
+	uint64_t nevents;
+	uint64_t ndropped;		/* events overwritten because the ring was full */
+};
+
+extern int sched_trace_enabled;
+
+/* Read STARPU_HR_TRACE and STARPU_HR_TRACE_BUFFER, called at policy init */
+void sched_trace_init(void);
+/* Write the recorded events and release the buffers, called at policy deinit */
+void sched_trace_dump(void);
+
+void sched_trace_record(enum sched_trace_event_type type, uint64_t job_id, int worker, double value);
+
+#define SCHED_TRACE(type, job_id, worker, value) do { \
+	if (__builtin_expect(sched_trace_enabled, 0)) \
+		sched_trace_record((type), (job_id), (worker), (value)); \
+} while (0)
+
+#endif /* __SCHED_TRACE_H__ */
@@ -0,0 +1,313 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Converts a trace recorded through STARPU_HR_TRACE into Chrome trace JSON
+ * (chrome://tracing, ui.perfetto.dev) or into a Paje trace (ViTE).
+ *
+ * Usage: sched_trace_convert [-f chrome|paje] <input> <output>
+ * Without -f, the format is guessed from the output extension.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sched_trace.h"
+
+struct thread_trace
+{
+	struct sched_trace_thread_header header;
+	struct sched_trace_event *events;
+};
+
+struct sorted_event
+{
+	const struct sched_trace_event *ev;
+	int thread;
+};
+
+static const char *event_names[SCHED_TRACE_NTYPES] =
+{
+	[SCHED_TRACE_PUSH] = "push",
+	[SCHED_TRACE_RATIO] = "ratio",
+	[SCHED_TRACE_RANK] = "rank",
+	[SCHED_TRACE_CANDIDATE] = "candidate",
+	[SCHED_TRACE_DECISION] = "decision",
+	[SCHED_TRACE_POP] = "pop",
+	[SCHED_TRACE_PRE_EXEC] = "pre_exec",
+	[SCHED_TRACE_POST_EXEC] = "post_exec",
+};
+
+static const char *event_name(uint32_t type)
+{
+	if (type < SCHED_TRACE_NTYPES)
+		return event_names[type];
+	return "unknown";
+}
+
+static int read_trace(const char *path, struct thread_trace **threadsp, uint32_t *nthreadsp)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f)
+	{
+		perror(path);
+		return -1;
+	}
+
+	struct sched_trace_file_header header;
+	if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != SCHED_TRACE_MAGIC)
+	{
+		fprintf(stderr, "%s is not a scheduler trace\n", path);
+		fclose(f);
+		return -1;
+	}
+	if (header.version != SCHED_TRACE_VERSION)
+	{
+		fprintf(stderr, "%s: unsupported trace version %u\n", path, header.version);
+		fclose(f);
+		return -1;
+	}
+
+	struct thread_trace *threads = calloc(header.nthreads, sizeof(*threads));
+	uint32_t i;
+	for (i = 0; i < header.nthreads; i++)
+	{
+		if (fread(&threads[i].header, sizeof(threads[i].header), 1, f) != 1)
+			break;
+		threads[i].events = malloc(threads[i].header.nevents*sizeof(struct sched_trace_event));
+		if (fread(threads[i].events, sizeof(struct sched_trace_event), threads[i].header.nevents, f) != threads[i].header.nevents)
+			break;
+		if (threads[i].header.ndropped)
+			fprintf(stderr, "warning: thread %d dropped %llu events, increase STARPU_HR_TRACE_BUFFER\n",
+				threads[i].header.thread, (unsigned long long) threads[i].header.ndropped);
+	}
+	fclose(f);
+
+	if (i != header.nthreads)
+	{
+		fprintf(stderr, "%s is truncated\n", path);
+		return -1;
+	}
+
+	*threadsp = threads;
+	*nthreadsp = header.nthreads;
+	return 0;
+}
+
+static void thread_label(const struct thread_trace *thread, char *buf, size_t len)
+{
+	if (thread->header.worker >= 0)
+		snprintf(buf, len, "worker %d", thread->header.worker);
+	else
+		snprintf(buf, len, "thread %d", thread->header.thread);
+}
+
+static void write_chrome(FILE *out, struct thread_trace *threads, uint32_t nthreads)
+{
+	uint32_t i;
+	uint64_t j;
+	int first = 1;
+
+	fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	for (i = 0; i < nthreads; i++)
+	{
+		char label[32];
+		int tid = threads[i].header.thread;
+		thread_label(&threads[i], label, sizeof(label));
+		fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			first ? "" : ",\n", tid, label);
+		first = 0;
+
+		for (j = 0; j < threads[i].header.nevents; j++)
+		{
+			const struct sched_trace_event *ev = &threads[i].events[j];
+			switch (ev->type)
+			{
+			case SCHED_TRACE_PRE_EXEC:
+				fprintf(out, ",\n{\"name\":\"job %llu\",\"cat\":\"exec\",\"ph\":\"B\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"args\":{\"worker\":%d}}",
+					(unsigned long long) ev->job_id, tid, ev->time, ev->worker);
+				break;
+			case SCHED_TRACE_POST_EXEC:
+				fprintf(out, ",\n{\"name\":\"job %llu\",\"cat\":\"exec\",\"ph\":\"E\",\"pid\":0,\"tid\":%d,\"ts\":%.3f}",
+					(unsigned long long) ev->job_id, tid, ev->time);
+				break;
+			default:
+				fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"sched\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"args\":{\"job\":%llu,\"worker\":%d,\"value\":",
+					event_name(ev->type), tid, ev->time, (unsigned long long) ev->job_id, ev->worker);
+				/* No prediction (NAN) has no JSON number */
+				if (isfinite(ev->value))
+					fprintf(out, "%g}}", ev->value);
+				else
+					fprintf(out, "null}}");
+				break;
+			}
+		}
+	}
+	fprintf(out, "\n]}\n");
+}
+
+static int compare_events(const void *a, const void *b)
+{
+	const struct sorted_event *ea = a;
+	const struct sorted_event *eb = b;
+	if (ea->ev->time < eb->ev->time)
+		return -1;
+	return ea->ev->time > eb->ev->time;
+}
+
+static void write_paje_header(FILE *out)
+{
+	fprintf(out,
+		"%%EventDef PajeDefineContainerType 0\n%%\tAlias string\n%%\tType string\n%%\tName string\n%%EndEventDef\n"
+		"%%EventDef PajeDefineStateType 1\n%%\tAlias string\n%%\tType string\n%%\tName string\n%%EndEventDef\n"
+		"%%EventDef PajeDefineEventType 2\n%%\tAlias string\n%%\tType string\n%%\tName string\n%%EndEventDef\n"
+		"%%EventDef PajeDefineEntityValue 3\n%%\tAlias string\n%%\tType string\n%%\tName string\n%%\tColor color\n%%EndEventDef\n"
+		"%%EventDef PajeCreateContainer 4\n%%\tTime date\n%%\tAlias string\n%%\tType string\n%%\tContainer string\n%%\tName string\n%%EndEventDef\n"
+		"%%EventDef PajeDestroyContainer 5\n%%\tTime date\n%%\tType string\n%%\tName string\n%%EndEventDef\n"
+		"%%EventDef PajeSetState 6\n%%\tTime date\n%%\tType string\n%%\tContainer string\n%%\tValue string\n%%EndEventDef\n"
+		"%%EventDef PajeNewEvent 7\n%%\tTime date\n%%\tType string\n%%\tContainer string\n%%\tValue string\n%%EndEventDef\n");
+
+	fprintf(out, "0 P 0 \"Program\"\n");
+	fprintf(out, "0 T P \"Thread\"\n");
+	fprintf(out, "1 S T \"Thread State\"\n");
+	fprintf(out, "3 I S \"Idle\" \"0.5 0.5 0.5\"\n");
+	fprintf(out, "3 E S \"Executing\" \"0.0 0.6 0.0\"\n");
+	fprintf(out, "2 D T \"Scheduler\"\n");
+}
+
+/* Paje dates are in ms, relative to the first event */
+static void write_paje(FILE *out, struct thread_trace *threads, uint32_t nthreads)
+{
+	uint64_t total = 0;
+	uint32_t i;
+	uint64_t j, n = 0;
+
+	for (i = 0; i < nthreads; i++)
+		total += threads[i].header.nevents;
+
+	struct sorted_event *sorted = malloc(total*sizeof(*sorted));
+	for (i = 0; i < nthreads; i++)
+		for (j = 0; j < threads[i].header.nevents; j++)
+		{
+			sorted[n].ev = &threads[i].events[j];
+			sorted[n].thread = threads[i].header.thread;
+			n++;
+		}
+	qsort(sorted, total, sizeof(*sorted), compare_events);
+
+	double origin = total ? sorted[0].ev->time : 0.0;
+	double last = total ? sorted[total-1].ev->time : 0.0;
+
+	write_paje_header(out);
+	fprintf(out, "4 0 p P 0 \"scheduler\"\n");
+	for (i = 0; i < nthreads; i++)
+	{
+		char label[32];
+		thread_label(&threads[i], label, sizeof(label));
+		fprintf(out, "4 0 t%d T p \"%s\"\n", threads[i].header.thread, label);
+		fprintf(out, "6 0 S t%d I\n", threads[i].header.thread);
+	}
+
+	for (j = 0; j < total; j++)
+	{
+		const struct sched_trace_event *ev = sorted[j].ev;
+		double date = (ev->time - origin)/1000.0;
+		switch (ev->type)
+		{
+		case SCHED_TRACE_PRE_EXEC:
+			fprintf(out, "6 %.6f S t%d E\n", date, sorted[j].thread);
+			break;
+		case SCHED_TRACE_POST_EXEC:
+			fprintf(out, "6 %.6f S t%d I\n", date, sorted[j].thread);
+			break;
+		default:
+			fprintf(out, "7 %.6f D t%d \"%s job=%llu worker=%d value=%g\"\n",
+				date, sorted[j].thread, event_name(ev->type),
+				(unsigned long long) ev->job_id, ev->worker, ev->value);
+			break;
+		}
+	}
+
+	double end = (last - origin)/1000.0;
+	for (i = 0; i < nthreads; i++)
+		fprintf(out, "5 %.6f T t%d\n", end, threads[i].header.thread);
+	fprintf(out, "5 %.6f P p\n", end);
+
+	free(sorted);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-f chrome|paje] <input> <output>\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	const char *format = NULL;
+	const char *input = NULL;
+	const char *output = NULL;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-f") == 0 && i+1 < argc)
+			format = argv[++i];
+		else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)
+		{
+			usage(argv[0]);
+			return 0;
+		}
+		else if (!input)
+			input = argv[i];
+		else if (!output)
+			output = argv[i];
+	}
+
+	if (!input || !output)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (!format)
+	{
+		const char *ext = strrchr(output, '.');
+		format = (ext && strcmp(ext, ".paje") == 0) ? "paje" : "chrome";
+	}
+	if (strcmp(format, "chrome") != 0 && strcmp(format, "paje") != 0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	struct thread_trace *threads;
+	uint32_t nthreads;
+	if (read_trace(input, &threads, &nthreads) != 0)
+		return 1;
+
+	FILE *out = fopen(output, "w");
+	if (!out)
+	{
+		perror(output);
+		return 1;
+	}
+
+	if (strcmp(format, "paje") == 0)
+		write_paje(out, threads, nthreads);
+	else
+		write_chrome(out, threads, nthreads);
+	fclose(out);
+
+	uint32_t t;
+	for (t = 0; t < nthreads; t++)
+		free(threads[t].events);
+	free(threads);
+	return 0;
+}
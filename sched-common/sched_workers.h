@@ -0,0 +1,233 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Per-context worker descriptors.
+ *
+ * The prediction loops need, for each worker and each task, the perf arch of
+ * the worker in the context, its memory node and its relative speedup. The
+ * policies fill this table from their add_workers/remove_workers methods and
+ * the hot loops read it instead of calling back into StarPU.
+ *
+ * Combined workers (groups of CPU workers running one parallel task) whose
+ * members all belong to the context can be listed as well, see
+ * sched_workers_find_combined().
+ */
+
+#ifndef __SCHED_WORKERS_H__
+#define __SCHED_WORKERS_H__
+
+#include <starpu.h>
+
+struct sched_worker_desc
+{
+	struct starpu_perfmodel_arch *perf_arch;
+	unsigned memory_node;
+	double speedup;			/* starpu_worker_get_relative_speedup() */
+	uint32_t where;			/* STARPU_CPU, STARPU_CUDA, ... to compare with cl->where */
+};
+
+struct sched_combined_desc
+{
+	int id;				/* combined worker id, after the basic ones */
+	struct starpu_perfmodel_arch *perf_arch;
+	int size;
+	int *members;			/* owned by StarPU */
+};
+
+struct sched_workers
+{
+	/* Indexed by worker id, only valid for the workers of the context */
+	struct sched_worker_desc desc[STARPU_NMAXWORKERS];
+	unsigned nworkers;
+	int ids[STARPU_NMAXWORKERS];
+
+	/* Distinct memory nodes of the workers, and how many workers each */
+	unsigned nnodes;
+	unsigned nodes[STARPU_MAXNODES];
+	unsigned node_nworkers[STARPU_MAXNODES];
+
+	unsigned ncombined;
+	struct sched_combined_desc combined[STARPU_NMAX_COMBINEDWORKERS];
+};
+
+static inline uint32_t sched_workers_where(int workerid)
+{
+	switch (starpu_worker_get_type(workerid))
+	{
+	case STARPU_CPU_WORKER:
+		return STARPU_CPU;
+	case STARPU_CUDA_WORKER:
+		return STARPU_CUDA;
+	case STARPU_OPENCL_WORKER:
+		return STARPU_OPENCL;
+	default:
+		return ~0U;
+	}
+}
+
+/* Cheap rejection before starpu_worker_can_execute_task_impl() */
+static inline int sched_workers_may_execute(const struct sched_worker_desc *desc, struct starpu_task *task)
+{
+	return task->cl == NULL || (task->cl->where & desc->where) != 0;
+}
+
+static inline void sched_workers_count_nodes(struct sched_workers *w)
+{
+	unsigned i, n;
+
+	w->nnodes = 0;
+	for (i = 0; i < w->nworkers; i++)
+	{
+		unsigned node = w->desc[w->ids[i]].memory_node;
+		for (n = 0; n < w->nnodes; n++)
+			if (w->nodes[n] == node)
+				break;
+		if (n == w->nnodes)
+		{
+			w->nodes[n] = node;
+			w->node_nworkers[n] = 0;
+			w->nnodes++;
+		}
+		w->node_nworkers[n]++;
+	}
+}
+
+/* Returns how many of WORKERIDS were not in the context yet */
+static inline unsigned sched_workers_add(struct sched_workers *w, int *workerids, unsigned nworkers, unsigned sched_ctx_id)
+{
+	unsigned i, j, added = 0;
+
+	for (i = 0; i < nworkers; i++)
+	{
+		int workerid = workerids[i];
+		struct sched_worker_desc *desc = &w->desc[workerid];
+
+		desc->perf_arch = starpu_worker_get_perf_archtype(workerid, sched_ctx_id);
+		desc->memory_node = starpu_worker_get_memory_node(workerid);
+		desc->speedup = starpu_worker_get_relative_speedup(desc->perf_arch);
+		desc->where = sched_workers_where(workerid);
+
+		for (j = 0; j < w->nworkers; j++)
+			if (w->ids[j] == workerid)
+				break;
+		if (j == w->nworkers)
+		{
+			w->ids[w->nworkers++] = workerid;
+			added++;
+		}
+	}
+	sched_workers_count_nodes(w);
+	return added;
+}
+
+static inline int sched_workers_contains(const struct sched_workers *w, int workerid)
+{
+	unsigned i;
+
+	for (i = 0; i < w->nworkers; i++)
+		if (w->ids[i] == workerid)
+			return 1;
+	return 0;
+}
+
+static inline void sched_workers_remove(struct sched_workers *w, int *workerids, unsigned nworkers)
+{
+	unsigned i, j, n;
+	int m;
+
+	for (i = 0; i < nworkers; i++)
+		for (j = 0; j < w->nworkers; j++)
+			if (w->ids[j] == workerids[i])
+			{
+				w->ids[j] = w->ids[--w->nworkers];
+				break;
+			}
+	sched_workers_count_nodes(w);
+
+	/* Drop the combined workers which lost a member */
+	for (i = 0, n = 0; i < w->ncombined; i++)
+	{
+		for (m = 0; m < w->combined[i].size; m++)
+			if (!sched_workers_contains(w, w->combined[i].members[m]))
+				break;
+		if (m == w->combined[i].size)
+			w->combined[n++] = w->combined[i];
+	}
+	w->ncombined = n;
+}
+
+/* List the combined workers made of workers of the context only. StarPU
+ * creates them when the policy calls _starpu_sched_find_worker_combinations()
+ * and never removes them. */
+static inline void sched_workers_find_combined(struct sched_workers *w, unsigned sched_ctx_id)
+{
+	int first = starpu_worker_get_count();
+	int last = first + starpu_combined_worker_get_count();
+	int id, i;
+
+	w->ncombined = 0;
+	for (id = first; id < last && w->ncombined < STARPU_NMAX_COMBINEDWORKERS; id++)
+	{
+		struct sched_combined_desc *c = &w->combined[w->ncombined];
+
+		if (starpu_combined_worker_get_description(id, &c->size, &c->members) != 0 || c->size < 2)
+			continue;
+		for (i = 0; i < c->size; i++)
+			if (!sched_workers_contains(w, c->members[i]))
+				break;
+		if (i < c->size)
+			continue;
+
+		c->id = id;
+		c->perf_arch = starpu_worker_get_perf_archtype(id, sched_ctx_id);
+		w->ncombined++;
+	}
+}
+
+/* Perf arch of WORKERID in the context, combined workers included: the
+ * descriptors only cover the basic workers */
+static inline struct starpu_perfmodel_arch *sched_workers_perf_arch(const struct sched_workers *w, int workerid, unsigned sched_ctx_id)
+{
+	unsigned i;
+
+	if (workerid < (int) starpu_worker_get_count())
+		return w->desc[workerid].perf_arch;
+	for (i = 0; i < w->ncombined; i++)
+		if (w->combined[i].id == workerid)
+			return w->combined[i].perf_arch;
+	/* Not listed by sched_workers_find_combined() */
+	return starpu_worker_get_perf_archtype(workerid, sched_ctx_id);
+}
+
+/* Average predicted time to move SIZE bytes between two distinct workers of
+ * the context, i.e. the sum over the ordered pairs of distinct workers divided
+ * by nworkers^2. Workers sharing a memory node are grouped, so the cost is
+ * quadratic in the number of nodes instead of the number of workers. */
+static inline double sched_workers_transfer_time(const struct sched_workers *w, size_t size)
+{
+	double penalty = 0.0;
+	unsigned a, b;
+
+	if (w->nworkers < 2)
+		return 0.0;
+
+	for (a = 0; a < w->nnodes; a++)
+		for (b = 0; b < w->nnodes; b++)
+		{
+			double pairs = (double) w->node_nworkers[a] * w->node_nworkers[b];
+			if (a == b)
+				/* a worker is not paired with itself */
+				pairs -= w->node_nworkers[a];
+			if (pairs > 0)
+				penalty += pairs * starpu_transfer_predict(w->nodes[a], w->nodes[b], size);
+		}
+	return penalty / ((double) w->nworkers * w->nworkers);
+}
+
+#endif /* __SCHED_WORKERS_H__ */
@@ -0,0 +1,97 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sched_plugin.h"
+
+/* Built from the benchmark sources with SCHED_POLICY_LIBRARY defined */
+extern struct starpu_sched_policy hratio_sched_policy;		/* test-pi/pi.c */
+extern struct starpu_sched_policy rank_based_sched_policy;	/* advanced_sched/rank_based_sched.c */
+extern struct starpu_sched_policy dummy_sched_policy;		/* advanced_sched/dummy_sched.c */
+extern struct starpu_sched_policy modular_hratio_sched_policy;	/* advanced_sched/modular_hratio.c */
+
+static struct
+{
+	const char *name;
+	struct starpu_sched_policy *policy;
+} plugin_policies[] =
+{
+	{ "hratio", &hratio_sched_policy },
+	{ "rank-based", &rank_based_sched_policy },
+	{ "dummy", &dummy_sched_policy },
+	{ "modular-hratio", &modular_hratio_sched_policy },
+};
+
+#define SCHED_PLUGIN_NPOLICIES (sizeof(plugin_policies) / sizeof(plugin_policies[0]))
+
+struct starpu_sched_policy *sched_plugin_find(const char *name)
+{
+	unsigned i;
+
+	if (!name)
+		return NULL;
+	for (i = 0; i < SCHED_PLUGIN_NPOLICIES; i++)
+		if (strcmp(name, plugin_policies[i].name) == 0)
+			return plugin_policies[i].policy;
+	return NULL;
+}
+
+void sched_plugin_list(FILE *f)
+{
+	unsigned i;
+
+	fprintf(f, "\nPolicies of libsmartcoop_sched:\n");
+	for (i = 0; i < SCHED_PLUGIN_NPOLICIES; i++)
+		fprintf(f, "%-12s -> %s\n", plugin_policies[i].name, plugin_policies[i].policy->policy_description);
+}
+
+typedef int (*starpu_initialize_func)(struct starpu_conf *user_conf, int *argc, char ***argv);
+
+int starpu_initialize(struct starpu_conf *user_conf, int *argc, char ***argv)
+{
+	static starpu_initialize_func real_initialize;
+	struct starpu_sched_policy *policy;
+	struct starpu_conf conf;
+
+	if (!real_initialize)
+	{
+		real_initialize = (starpu_initialize_func) dlsym(RTLD_NEXT, "starpu_initialize");
+		if (!real_initialize)
+		{
+			fprintf(stderr, "[sched_plugin] starpu_initialize not found: %s\n", dlerror());
+			return -ENOSYS;
+		}
+	}
+
+	const char *name = getenv("STARPU_SCHED");
+	if (name && strcmp(name, "help") == 0)
+		sched_plugin_list(stderr);
+
+	/* STARPU_SCHED has precedence over the configuration, as in StarPU */
+	policy = sched_plugin_find(name);
+	if (!policy && !name && user_conf)
+		policy = sched_plugin_find(user_conf->sched_policy_name);
+	if (!policy || (user_conf && user_conf->sched_policy))
+		/* Not ours, or the application chose its policy itself */
+		return real_initialize(user_conf, argc, argv);
+
+	if (user_conf)
+		conf = *user_conf;
+	else
+		starpu_conf_init(&conf);
+	/* StarPU only looks at STARPU_SCHED when sched_policy is not set */
+	conf.sched_policy = policy;
+	conf.sched_policy_name = NULL;
+	return real_initialize(&conf, argc, argv);
+}
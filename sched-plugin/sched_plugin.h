@@ -0,0 +1,32 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * The policies of this repository, packaged as one shared library.
+ *
+ * Applications linked with libsmartcoop_sched, or started with it in
+ * LD_PRELOAD, select the policies by name like the StarPU ones: the library
+ * wraps starpu_initialize() and, when STARPU_SCHED (or the sched_policy_name
+ * field of the configuration) names one of its policies, passes it to StarPU
+ * as the sched_policy of the configuration. Other names are left to StarPU.
+ * STARPU_SCHED=help lists these policies before the StarPU ones.
+ */
+
+#ifndef __SCHED_PLUGIN_H__
+#define __SCHED_PLUGIN_H__
+
+#include <stdio.h>
+#include <starpu.h>
+
+/* The policy registered as NAME, or NULL */
+struct starpu_sched_policy *sched_plugin_find(const char *name);
+
+/* Print the registered policies, as STARPU_SCHED=help does */
+void sched_plugin_list(FILE *f);
+
+#endif /* __SCHED_PLUGIN_H__ */
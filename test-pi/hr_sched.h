@@ -0,0 +1,69 @@
+/* smartCoopScheduler --- scheduling policies for heterogeneous CPU/GPU platforms
+ *
+ * This is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2.1 of the License, or (at your option)
+ * any later version.
+ */
+
+/*
+ * Application interface of the H-Ratio policy.
+ *
+ * Admission control: before submitting a ready task, ask whether it can end
+ * by a target date under the current load. The prediction starts from the
+ * expected end of every worker queue, places the tasks of the main list
+ * which would be dispatched before it at their earliest finish, then places
+ * the task itself. When the target can be met, the predicted length of the
+ * task is reserved on the chosen worker, so that later decisions and
+ * admissions see it, and the task goes to that worker when it is submitted,
+ * bypassing the main list.
+ *
+ * Deadlines: a task may be given an absolute deadline before it is
+ * submitted. With STARPU_HR_MODE=deadline the main list is ordered by
+ * slack, the deadline minus the best predicted end of the task, and in any
+ * mode a task whose slack is negative when dispatched goes to the worker
+ * which runs it the fastest.
+ *
+ * Fair share: with several contexts under this policy, the accelerator time
+ * of each context is weighted, see sched_share.h.
+ */
+
+#ifndef __HR_SCHED_H__
+#define __HR_SCHED_H__
+
+#include <starpu.h>
+
+enum hr_admission
+{
+	HR_ADMIT_ACCEPTED = 0,
+	HR_ADMIT_REJECTED,
+	/* No worker has a prediction for the task yet, nothing is reserved */
+	HR_ADMIT_UNPREDICTED
+};
+
+/* TARGET and *FINISH are dates in us, on the starpu_timing_now() clock.
+ * *FINISH receives the predicted end of TASK, also when it is rejected, in
+ * which case it is the best achievable one. Returns an enum hr_admission, or
+ * -ENODEV when SCHED_CTX_ID does not use the H-Ratio policy. */
+int hr_sched_admit(unsigned sched_ctx_id, struct starpu_task *task, double target, double *finish);
+
+/* Drop the reservation of an accepted task which will not be submitted */
+void hr_sched_admit_cancel(unsigned sched_ctx_id, struct starpu_task *task);
+
+/* DEADLINE is a date in us, on the starpu_timing_now() clock, kept until
+ * TASK is executed. Returns -ENODEV when SCHED_CTX_ID does not use the
+ * H-Ratio policy. */
+int hr_sched_set_deadline(unsigned sched_ctx_id, struct starpu_task *task, double deadline);
+/* Drop the deadline of a task which will not be submitted */
+void hr_sched_clear_deadline(unsigned sched_ctx_id, struct starpu_task *task);
+
+/* Fair share of the accelerators between contexts, with STARPU_HR_SHARE set.
+ * Each context gets accelerator time in proportion to its WEIGHT (1 by
+ * default, may be set before the context is created) while it has tasks to
+ * run. hr_sched_get_share() gives the accelerator time charged to the
+ * context in us and its fraction of the total, or returns -ENOENT for a
+ * context which does not take part. */
+int hr_sched_set_share(unsigned sched_ctx_id, double weight);
+int hr_sched_get_share(unsigned sched_ctx_id, double *used, double *share);
+
+#endif /* __HR_SCHED_H__ */
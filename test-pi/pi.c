@@ -37,9 +37,21 @@
 #include <core/debug.h>
 
 #include <sched_policies/fifo_queues.h>
+#include <sched_policies/detect_combined_workers.h>
 #include <starpu_scheduler.h>
 #include <limits.h>
+#include <errno.h>
 #include <stdlib.h>
+
+#include "sched_trace.h"
+#include "sched_sampler.h"
+#include "sched_perfcnt.h"
+#include "sched_energy.h"
+#include "sched_replay.h"
+#include "sched_log.h"
+#include "sched_workers.h"
+#include "sched_share.h"
+#include "hr_sched.h"
 #define STAPU_USE_CUDA 1
 
 #define thr 	256
@@ -83,6 +95,164 @@ static int all_device_len = 0;
 #define DBL_MAX __DBL_MAX__
 #endif
 
+/* Ordering of the main list. The key of each task is kept in its record,
+ * the list is sorted by decreasing key and equal keys keep the submission
+ * order. */
+enum hr_mode
+{
+	HR_MODE_RATIO = 0,	/* heterogeneity ratio, independent heterogeneous batches */
+	HR_MODE_RANK,		/* upward rank, deep DAGs */
+	HR_MODE_FIFO,		/* submission order, uniform microtasks */
+	HR_MODE_DEADLINE,	/* least slack first, tasks with deadlines */
+	HR_NMODES
+};
+
+static const char *hr_mode_names[HR_NMODES] =
+{
+	[HR_MODE_RATIO] = "ratio",
+	[HR_MODE_RANK] = "rank",
+	[HR_MODE_FIFO] = "fifo",
+	[HR_MODE_DEADLINE] = "deadline",
+};
+
+/* Workload shape over the last meta_window pushes */
+struct hr_meta_window
+{
+	unsigned n;
+	/* Tasks whose lengths were looked at, and those with predictions */
+	unsigned nsampled;
+	unsigned nmodelled;
+	double sum_length;
+	double sum_length2;
+	double sum_ratio;
+	double sum_ratio2;
+	unsigned long sum_fanout;
+	unsigned max_depth;
+};
+
+/* Depth of the tasks announced by their predecessors, direct-mapped on the
+ * job id: a collision forgets a depth, which can only under-estimate it */
+#define HR_META_DEPTH_SLOTS 4096
+
+/* Cached predictions of a task class (codelet and footprint), refreshed every
+ * uniform_refresh placements so that perf model updates are taken into
+ * account. The table is direct-mapped, a new class evicts the previous one. */
+#define HR_CLASS_SLOTS 16
+
+struct hr_class
+{
+	struct starpu_codelet *cl;
+	uint32_t footprint;
+	int cached;
+	unsigned placed;
+	unsigned version;
+	double ratio;
+	double min_length;
+	double avg_length;
+	double length[STARPU_NMAXWORKERS][STARPU_MAXIMPLEMENTATIONS];
+};
+
+/* How much work a decision does, see hr_choose_tier */
+enum hr_tier
+{
+	HR_TIER_CACHED = 0,	/* cached class predictions, no perf model query */
+	HR_TIER_EFT,		/* earliest finish time over the workers */
+	HR_TIER_FULL,		/* rank with transfers, data-aware placement */
+	HR_NTIERS
+};
+
+static const char *hr_tier_names[HR_NTIERS] =
+{
+	[HR_TIER_CACHED] = "cached",
+	[HR_TIER_EFT] = "eft",
+	[HR_TIER_FULL] = "full",
+};
+
+/* Energy-aware placement, see hr_energy_pick */
+enum hr_energy
+{
+	HR_ENERGY_OFF = 0,	/* earliest finish time */
+	HR_ENERGY_SLACK,	/* least energy within a makespan slack */
+	HR_ENERGY_CAP,		/* earliest finish off the CPUs above a power cap */
+	HR_NENERGY
+};
+
+static const char *hr_energy_names[HR_NENERGY] =
+{
+	[HR_ENERGY_OFF] = "off",
+	[HR_ENERGY_SLACK] = "slack",
+	[HR_ENERGY_CAP] = "cap",
+};
+
+/* A placement considered by _dm_push_task */
+struct hr_candidate
+{
+	int worker;
+	unsigned impl;
+	double exp_end;
+	double length;
+	double penalty;
+	double energy;
+};
+
+/* Capacity reserved by hr_sched_admit() for a task not pushed yet */
+struct hr_reservation
+{
+	struct hr_reservation *next;
+	struct starpu_task *task;
+	int worker;			/* -1 once the worker left the context */
+	unsigned impl;
+	double length;
+};
+
+/* Scheduler-private record of a task, from its push to its dispatch, or to
+ * the end of its execution when it has a deadline. Records are allocated
+ * HR_JOB_SLAB at a time from the arena of the context and found by job id in
+ * HR_JOB_SLOTS buckets, so that StarPU's struct starpu_task needs no field
+ * of ours. The backlog lists link the records rather than the tasks: sorting
+ * and inserting only touch these few cache lines. */
+#define HR_JOB_SLAB 256
+#define HR_JOB_SLOTS 1024
+
+/* Worker classes of the predicted lengths: CPUs (and CPU groups), CUDA,
+ * OpenCL and the others */
+#define HR_JOB_NCLASSES 4
+
+struct hr_job
+{
+	/* Pending or main list, or free list of the arena */
+	struct hr_job *prev;
+	struct hr_job *next;
+	struct hr_job *hash_next;
+	struct starpu_task *task;
+	unsigned long job_id;
+	/* Order in the main list */
+	double key;
+	/* NAN until computed, valid while version is the model version */
+	double ratio;
+	double rank;
+	/* Absolute deadline, NAN without */
+	double deadline;
+	/* Shortest and longest predicted length per worker class, NAN when
+	 * no worker of the class has a prediction */
+	float min_length[HR_JOB_NCLASSES];
+	float max_length[HR_JOB_NCLASSES];
+	unsigned version;
+	int predicted;
+};
+
+struct hr_job_list
+{
+	struct hr_job *head;
+	struct hr_job *tail;
+};
+
+struct hr_job_slab
+{
+	struct hr_job_slab *next;
+	struct hr_job jobs[HR_JOB_SLAB];
+};
+
 struct _starpu_dmda_data
 {
 	double alpha;
@@ -90,9 +260,119 @@ struct _starpu_dmda_data
 	double _gamma;
 	double idle_power;
 
+	/* Queues of the workers, published atomically. Those of removed
+	 * workers are retired, not destroyed, until deinit: the sampler
+	 * reads them without lock. */
 	struct _starpu_fifo_taskq **queue_array;
+	struct _starpu_fifo_taskq **retired_queues;
+	/* Perf arch, memory node... of the workers, see add_workers */
+	struct sched_workers workers;
 	starpu_pthread_mutex_t policy_mutex;
-	struct starpu_task_list main_list;
+	struct hr_job_list main_list;
+	/* Tasks pushed since the last dispatch, without a key yet: keys are
+	 * only computed when the order matters, see hr_next_task */
+	struct hr_job_list pending_list;
+
+	/* Task records, see struct hr_job */
+	struct hr_job_slab *job_slabs;
+	struct hr_job *job_free;
+	struct hr_job *job_index[HR_JOB_SLOTS];
+
+	/* Homogeneous backlog detection: main_list_len counts the tasks of
+	 * the main list, uniform_len those sharing the reference class
+	 * (uniform_cl, uniform_footprint). When both are equal, ordering is
+	 * pointless and the main list is a plain FIFO. */
+	struct starpu_perfmodel_arch *footprint_arch;
+	struct starpu_codelet *uniform_cl;
+	uint32_t uniform_footprint;
+	unsigned main_list_len;
+	unsigned uniform_len;
+
+	/* Cached predictions per class, HR_CLASS_SLOTS entries */
+	struct hr_class *classes;
+	unsigned uniform_refresh;
+
+	/* Decision depth: fraction of the predicted compute time the
+	 * scheduler may spend on a task (0 disables the tiers), and running
+	 * averages of the cost of each tier, in us */
+	double budget;
+	double key_cost[HR_NTIERS];
+	double place_cost[HR_NTIERS];
+	unsigned long tier_count[HR_NTIERS];
+	unsigned long class_fills;
+
+	/* Bumped by post_exec when a task was not predicted or its length
+	 * was off by more than model_tolerance. Keys of the main list and
+	 * class caches computed under an older version are stale. */
+	unsigned model_version;
+	unsigned keyed_version;
+	unsigned rekey_dispatched;
+	double model_tolerance;
+	double exec_start[STARPU_NMAXWORKERS];
+
+	/* Set between pre_exec and post_exec, read by the sampler */
+	int worker_busy[STARPU_NMAXWORKERS];
+
+	/* Dispatch gating: 0 releases one task per push while the worker
+	 * queues hold at most thr tasks in total; otherwise, target in us of
+	 * predicted work (exp_end - now) below which a worker gets tasks */
+	double horizon;
+
+	/* Parallel tasks may go to combined workers, which cost
+	 * combined_cost us per member to start, see hr_combined_best */
+	int combined;
+	double combined_cost;
+
+	/* Fair share of the accelerators with the other contexts, NULL
+	 * unless STARPU_HR_SHARE is set, and whether the accelerators are
+	 * open to it for the current dispatch, see hr_share_check */
+	struct sched_share_tenant *share;
+	int share_open;
+	/* Tasks in the accelerator queues, for the other tenants to read */
+	int share_queued;
+
+	/* Accepted admissions, see hr_sched.h */
+	struct hr_reservation *reservations;
+
+	/* Records with a deadline, the slack quantum under which the ratio
+	 * breaks ties, and how many deadlines were missed */
+	unsigned ndeadlines;
+	double deadline_quantum;
+	unsigned long deadline_count;
+	unsigned long deadline_missed;
+
+	/* Energy-aware placement: relative makespan slack allowed to save
+	 * energy, CPU package power cap in W measured with RAPL, and how
+	 * many placements moved away from the earliest finish. The RAPL
+	 * counters are only opened for energy placement or the energy log. */
+	enum hr_energy energy;
+	double energy_slack;
+	double power_cap;
+	unsigned long energy_moves;
+	int rapl;
+	double energy_start;
+
+	/* With STARPU_HR_REPLAY, decisions of a recorded run, see
+	 * sched_replay.h */
+	int replay;
+	unsigned long replay_hits;
+	unsigned long replay_misses;
+
+	/* Active ordering and, with STARPU_HR_MODE=auto, the statistics
+	 * used to switch it, see hr_meta_observe */
+	enum hr_mode mode;
+	int meta_auto;
+	unsigned meta_window;
+	unsigned meta_depth;
+	double meta_uniform_cv;
+	enum hr_mode meta_candidate;
+	unsigned meta_switches;
+	unsigned meta_sample;
+	unsigned long meta_pushes;
+	struct hr_meta_window window;
+	unsigned long depth_job[HR_META_DEPTH_SLOTS];
+	unsigned depth_value[HR_META_DEPTH_SLOTS];
+
 	long int total_task_cnt;
 	long int ready_task_cnt;
 	long int eager_task_cnt; /* number of tasks scheduled without model */
@@ -110,6 +390,46 @@ struct _starpu_dmda_data
 #define _STARPU_SCHED_BETA_DEFAULT 1.0
 #define _STARPU_SCHED_GAMMA_DEFAULT 1000.0
 
+/* Number of placements after which the cached predictions of a uniform
+ * backlog are recomputed, so that perf model updates are taken into account */
+#define _HR_UNIFORM_REFRESH_DEFAULT 64
+
+/* Weight of the last measure in the running average of the tier costs */
+#define _HR_TIER_COST_WEIGHT 0.125
+/* Relative decay, per decision, of the costs of the deeper tiers not used:
+ * a tier ruled out by a spike is tried again after a while */
+#define _HR_TIER_COST_DECAY 0.01
+
+/* Relative error between predicted and measured length from which the perf
+ * model is considered updated */
+#define _HR_MODEL_TOLERANCE_DEFAULT 0.5
+
+/* Start cost of a parallel task on a combined worker, per member, in us: the
+ * members wake up and meet at the task barrier */
+#define _HR_COMBINED_COST_DEFAULT 5.0
+
+/* Adaptive ordering: number of pushes per observation window, DAG depth from
+ * which the rank ordering is used, and coefficient of variation of the task
+ * lengths and ratios under which the workload is considered uniform */
+#define _HR_META_WINDOW_DEFAULT 256
+#define _HR_META_DEPTH_DEFAULT 4
+#define _HR_META_UNIFORM_CV_DEFAULT 0.1
+/* Lengths of one push in this many are predicted, when not cached */
+#define _HR_META_SAMPLE_DEFAULT 8
+
+/* Deadline ordering: slacks within the same quantum, in us, are ordered by
+ * heterogeneity ratio. Tasks without deadline go after all the others. */
+#define _HR_DEADLINE_QUANTUM_DEFAULT 100.0
+#define _HR_DEADLINE_NONE_KEY 1e12
+
+/* Energy placement: a task may finish up to this fraction of its earliest
+ * finish delay later if it saves energy */
+#define _HR_ENERGY_SLACK_DEFAULT 0.1
+
+/* Replay key of the tasks absent from the replayed decisions: after the
+ * others */
+#define _HR_REPLAY_NONE_KEY 1e15
+
 #ifdef STARPU_USE_TOP
 static double alpha = _STARPU_SCHED_ALPHA_DEFAULT;
 static double beta = _STARPU_SCHED_BETA_DEFAULT;
@@ -225,6 +545,13 @@ static struct starpu_task *_starpu_fifo_pop_first_ready_task(struct _starpu_fifo
 	return task;
 }
 
+/* Fair share: N tasks entered (or left, N < 0) the queue of WORKER */
+static void hr_share_queued(struct _starpu_dmda_data *dt, unsigned worker, int n)
+{
+	if (dt->share && dt->workers.desc[worker].where != STARPU_CPU)
+		__atomic_add_fetch(&dt->share_queued, n, __ATOMIC_RELAXED);
+}
+
 static struct starpu_task *dmda_pop_ready_task(unsigned sched_ctx_id)
 {
 	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
@@ -243,6 +570,7 @@ static struct starpu_task *dmda_pop_ready_task(unsigned sched_ctx_id)
 	task = _starpu_fifo_pop_first_ready_task(fifo, node, dt->num_priorities);
 	if (task)
 	{
+		hr_share_queued(dt, workerid, -1);
 #ifdef STARPU_VERBOSE
 		if (task->cl)
 		{
@@ -277,6 +605,8 @@ static struct starpu_task *dmda_pop_task(unsigned sched_ctx_id)
 //	printf("task%d  ", task==NULL);
 	if (task)
 	{
+		SCHED_TRACE(SCHED_TRACE_POP, starpu_task_get_job_id(task), workerid, 0.0);
+		hr_share_queued(dt, workerid, -1);
 #ifdef STARPU_VERBOSE
 		if (task->cl)
 		{
@@ -310,6 +640,10 @@ static struct starpu_task *dmda_pop_every_task(unsigned sched_ctx_id)
 	STARPU_PTHREAD_MUTEX_LOCK_SCHED(sched_mutex);
 	new_list = _starpu_fifo_pop_every_task(fifo, workerid);
 	STARPU_PTHREAD_MUTEX_UNLOCK_SCHED(sched_mutex);
+	int n = 0;
+	for (struct starpu_task *t = new_list; t; t = t->next)
+		n++;
+	hr_share_queued(dt, workerid, -n);
 	return new_list;
 }
 
@@ -327,6 +661,7 @@ static int push_task_on_best_worker(struct starpu_task *task, int best_workerid,
                 starpu_sched_ctx_move_task_to_ctx(task, child_sched_ctx);
                 return 0;
         }
+	SCHED_REPLAY_RECORD(starpu_task_get_job_id(task), best_workerid, starpu_task_get_implementation(task));
 
 	struct _starpu_fifo_taskq *fifo = dt->queue_array[best_workerid];
 
@@ -399,11 +734,13 @@ static int push_task_on_best_worker(struct starpu_task *task, int best_workerid,
 
 	if (starpu_get_prefetch_flag())
 	{
-		unsigned memory_node = starpu_worker_get_memory_node(best_workerid);
+		unsigned memory_node = dt->workers.desc[best_workerid].memory_node;
 		starpu_prefetch_task_input_on_node(task, memory_node);
 	}
 
 	STARPU_AYU_ADDTOTASKQUEUE(starpu_task_get_job_id(task), best_workerid);
+	/* Before the worker may pop it */
+	hr_share_queued(dt, best_workerid, 1);
 	int ret = 0;
 	if (prio)
 	{
@@ -440,6 +777,183 @@ static int push_task_on_best_worker(struct starpu_task *task, int best_workerid,
 	return ret;
 }
 
+/* Whether WORKER may get tasks from the main list: accelerators are closed
+ * while the context is over its share, and with horizon gating, a worker is
+ * closed beyond the horizon. An empty queue is always open, whatever is left
+ * in exp_len. */
+static int hr_worker_open(struct _starpu_dmda_data *dt, unsigned worker, double now)
+{
+	struct _starpu_fifo_taskq *fifo = dt->queue_array[worker];
+
+	if (!dt->share_open && dt->workers.desc[worker].where != STARPU_CPU)
+		return 0;
+	if (dt->horizon <= 0.0 || fifo->ntasks == 0)
+		return 1;
+	/* Read without the worker sched_mutex, like the other predictions */
+	return isnan(fifo->exp_end) || fifo->exp_end - now < dt->horizon;
+}
+
+static int hr_task_parallel(struct starpu_task *task)
+{
+	return task->cl != NULL && task->cl->type != STARPU_SEQ;
+}
+
+/* Expected end of the work queued on the members of C, or -1 when one of
+ * them is above the horizon */
+static double hr_combined_ready(struct _starpu_dmda_data *dt, const struct sched_combined_desc *c, double now)
+{
+	double ready = now;
+	int i;
+
+	for (i = 0; i < c->size; i++)
+	{
+		struct _starpu_fifo_taskq *fifo = dt->queue_array[c->members[i]];
+		if (!hr_worker_open(dt, c->members[i], now))
+			return -1.0;
+		double exp_start = isnan(fifo->exp_start) ? now : STARPU_MAX(fifo->exp_start, now);
+		ready = STARPU_MAX(ready, exp_start + fifo->exp_len);
+	}
+	return ready;
+}
+
+/* Earliest expected end of the parallel TASK over the combined workers: the
+ * group starts once all its members are done with their queue, then pays its
+ * formation cost. A combined worker without prediction is returned first, to
+ * calibrate it, with a NAN *LENGTH. */
+static int hr_combined_best(struct _starpu_dmda_data *dt, struct starpu_task *task, double now,
+			    double *best_end, unsigned *best_impl, double *best_length)
+{
+	int best = -1;
+	unsigned i, nimpl;
+
+	for (i = 0; i < dt->workers.ncombined; i++)
+	{
+		const struct sched_combined_desc *c = &dt->workers.combined[i];
+		double ready = hr_combined_ready(dt, c, now);
+		if (ready < 0.0)
+			continue;
+
+		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
+		{
+			if (!starpu_combined_worker_can_execute_task(c->id, task, nimpl))
+				continue;
+
+			double length = starpu_task_expected_length(task, c->perf_arch, nimpl);
+			if (isnan(length) || _STARPU_IS_ZERO(length))
+			{
+				*best_end = NAN;
+				*best_impl = nimpl;
+				*best_length = NAN;
+				return i;
+			}
+
+			double end = ready + dt->combined_cost * c->size + length;
+			SCHED_TRACE(SCHED_TRACE_CANDIDATE, starpu_task_get_job_id(task), c->id, end);
+			if (best == -1 || end < *best_end)
+			{
+				best = i;
+				*best_end = end;
+				*best_impl = nimpl;
+				*best_length = length;
+			}
+		}
+	}
+	return best;
+}
+
+/* Push one alias of TASK to each member of C, as the parallel heft policy
+ * does. The prediction of each alias covers the wait for the other members,
+ * so that the queues of all members end at EXP_END. */
+static int hr_push_task_on_combined(struct _starpu_dmda_data *dt, struct starpu_task *task,
+				    const struct sched_combined_desc *c, double exp_end)
+{
+	int i;
+
+	SCHED_REPLAY_RECORD(starpu_task_get_job_id(task), c->id, starpu_task_get_implementation(task));
+
+	/* Only the aliases are executed, they carry the predictions */
+	task->predicted = 0.0;
+	task->predicted_transfer = 0.0;
+	starpu_parallel_task_barrier_init(task, c->id);
+
+	for (i = 0; i < c->size; i++)
+	{
+		int member = c->members[i];
+		struct _starpu_fifo_taskq *fifo = dt->queue_array[member];
+		struct starpu_task *alias = starpu_task_dup(task);
+		starpu_pthread_mutex_t *sched_mutex;
+		starpu_pthread_cond_t *sched_cond;
+
+		alias->destroy = 1;
+		alias->predicted_transfer = 0.0;
+
+		starpu_worker_get_sched_condition(member, &sched_mutex, &sched_cond);
+		STARPU_PTHREAD_MUTEX_LOCK_SCHED(sched_mutex);
+		fifo->exp_start = isnan(fifo->exp_start) ? starpu_timing_now() : STARPU_MAX(fifo->exp_start, starpu_timing_now());
+		fifo->exp_end = fifo->exp_start + fifo->exp_len;
+		alias->predicted = isnan(exp_end) ? NAN : exp_end - fifo->exp_end;
+		if (!isnan(alias->predicted))
+		{
+			fifo->exp_len += alias->predicted;
+			fifo->exp_end = exp_end;
+		}
+		starpu_task_list_push_back(&fifo->taskq, alias);
+		fifo->ntasks++;
+		fifo->nprocessed++;
+#if !defined(STARPU_NON_BLOCKING_DRIVERS) || defined(STARPU_SIMGRID)
+		starpu_wakeup_worker_locked(member, sched_cond, sched_mutex);
+#endif
+		STARPU_PTHREAD_MUTEX_UNLOCK_SCHED(sched_mutex);
+	}
+	starpu_push_task_end(task);
+	return 0;
+}
+
+/* Placement among the NCAND candidates of a task when dt->energy is set,
+ * BEST being the earliest finish. With a slack, the one of least energy
+ * among those finishing at most energy_slack times the delay of BEST later:
+ * its predicted energy, plus the idle power of the other workers for the
+ * time it extends the makespan, as the dmda fitness. Under a power cap, the
+ * earliest finish off the CPUs while their measured power exceeds it. */
+static const struct hr_candidate *hr_energy_pick(struct _starpu_dmda_data *dt, const struct hr_candidate *cand, unsigned ncand,
+						 const struct hr_candidate *best, double now, double max_exp_end)
+{
+	const struct hr_candidate *pick = best;
+	double pick_energy = DBL_MAX;
+	unsigned i;
+
+	if (dt->energy == HR_ENERGY_CAP)
+	{
+		double power = sched_energy_cpu_power();
+		if (!(power > dt->power_cap))
+			return best;
+		pick = NULL;
+		for (i = 0; i < ncand; i++)
+			if (dt->workers.desc[cand[i].worker].where != STARPU_CPU
+			    && (!pick || cand[i].exp_end < pick->exp_end))
+				pick = &cand[i];
+		/* Only CPUs can run it */
+		return pick ? pick : best;
+	}
+
+	double limit = best->exp_end + dt->energy_slack * (best->exp_end - now);
+	for (i = 0; i < ncand; i++)
+	{
+		const struct hr_candidate *k = &cand[i];
+		if (k->exp_end > limit)
+			continue;
+		double energy = isnan(k->energy) ? 0.0 : k->energy;
+		if (k->exp_end > max_exp_end)
+			energy += dt->idle_power * (k->exp_end - max_exp_end) / 1000000.0;
+		if (energy < pick_energy || (energy == pick_energy && k->exp_end < pick->exp_end))
+		{
+			pick = k;
+			pick_energy = energy;
+		}
+	}
+	return pick;
+}
+
 /* TODO: factorize with dmda!! */
 static int _dm_push_task(struct starpu_task *task, unsigned prio, unsigned sched_ctx_id)
 {
@@ -464,18 +978,30 @@ static int _dm_push_task(struct starpu_task *task, unsigned prio, unsigned sched
 	struct starpu_worker_collection *workers = starpu_sched_ctx_get_worker_collection(sched_ctx_id);
 
 	struct starpu_sched_ctx_iterator it;
+	double now = starpu_timing_now();
+
+	/* Every placement, for hr_energy_pick */
+	struct hr_candidate cand[dt->energy != HR_ENERGY_OFF ? workers->nworkers * STARPU_MAXIMPLEMENTATIONS : 1];
+	unsigned ncand = 0;
+	int best_cand = -1;
+	double max_exp_end = 0.0;
 
 	workers->init_iterator(workers, &it);
 	while(workers->has_next_master(workers, &it))
 	{
 		worker = workers->get_next_master(workers, &it);
 		struct _starpu_fifo_taskq *fifo  = dt->queue_array[worker];
-		unsigned memory_node = starpu_worker_get_memory_node(worker);
-		struct starpu_perfmodel_arch* perf_arch = starpu_worker_get_perf_archtype(worker, sched_ctx_id);
+		const struct sched_worker_desc *desc = &dt->workers.desc[worker];
+		unsigned memory_node = desc->memory_node;
+		struct starpu_perfmodel_arch* perf_arch = desc->perf_arch;
 
 		/* Sometimes workers didn't take the tasks as early as we expected */
 		double exp_start = isnan(fifo->exp_start) ? starpu_timing_now() : STARPU_MAX(fifo->exp_start, starpu_timing_now());
+		if (exp_start + fifo->exp_len > max_exp_end)
+			max_exp_end = exp_start + fifo->exp_len;
 
+		if (!hr_worker_open(dt, worker, now))
+			continue;
 		if (!starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
 			continue;
 
@@ -490,7 +1016,7 @@ static int _dm_push_task(struct starpu_task *task, unsigned prio, unsigned sched
 			double exp_end;
 			double local_length = starpu_task_expected_length(task, perf_arch, nimpl);
 			double local_penalty = starpu_task_expected_data_transfer_time(memory_node, task);
-			double ntasks_end = fifo->ntasks / starpu_worker_get_relative_speedup(perf_arch);
+			double ntasks_end = fifo->ntasks / desc->speedup;
 
 			//_STARPU_DEBUG("Scheduler dm: task length (%lf) worker (%u) kernel (%u) \n", local_length,worker,nimpl);
 
@@ -552,6 +1078,20 @@ static int _dm_push_task(struct starpu_task *task, unsigned prio, unsigned sched
 				continue;
 
 			exp_end = exp_start + fifo->exp_len + local_length;
+			SCHED_TRACE(SCHED_TRACE_CANDIDATE, starpu_task_get_job_id(task), worker, exp_end);
+
+			if (dt->energy != HR_ENERGY_OFF)
+			{
+				struct hr_candidate *k = &cand[ncand++];
+				k->worker = worker;
+				k->impl = nimpl;
+				k->exp_end = exp_end;
+				k->length = local_length;
+				k->penalty = local_penalty;
+				k->energy = dt->energy == HR_ENERGY_SLACK ? starpu_task_expected_energy(task, perf_arch, nimpl) : NAN;
+				if (best == -1 || exp_end < best_exp_end)
+					best_cand = ncand - 1;
+			}
 
 			if (best == -1 || exp_end < best_exp_end)
 			{
@@ -565,15 +1105,47 @@ static int _dm_push_task(struct starpu_task *task, unsigned prio, unsigned sched
 		}
 	}
 
+	if (!unknown && dt->workers.ncombined > 0 && hr_task_parallel(task))
+	{
+		/* A CPU group may beat the best single worker */
+		double combined_end, combined_length;
+		unsigned combined_impl;
+		int combined = hr_combined_best(dt, task, now, &combined_end, &combined_impl, &combined_length);
+		if (combined != -1 && (best == -1 || isnan(combined_end) || combined_end < best_exp_end))
+		{
+			const struct sched_combined_desc *c = &dt->workers.combined[combined];
+			SCHED_TRACE(SCHED_TRACE_DECISION, starpu_task_get_job_id(task), c->id, combined_end);
+			starpu_task_set_implementation(task, combined_impl);
+			starpu_sched_task_break(task);
+			return hr_push_task_on_combined(dt, task, c, combined_end);
+		}
+	}
+
+	if (!unknown && best_cand != -1)
+	{
+		const struct hr_candidate *k = hr_energy_pick(dt, cand, ncand, &cand[best_cand], now, max_exp_end);
+		if (k != &cand[best_cand])
+		{
+			best = k->worker;
+			best_impl = k->impl;
+			best_exp_end = k->exp_end;
+			model_best = k->length;
+			transfer_model_best = k->penalty;
+			dt->energy_moves++;
+		}
+	}
+
 	if (unknown)
 	{
 		best = ntasks_best;
 		model_best = 0.0;
 		transfer_model_best = 0.0;
+		best_exp_end = NAN;
 #ifdef STARPU_VERBOSE
 		dt->eager_task_cnt++;
 #endif
 	}
+	SCHED_TRACE(SCHED_TRACE_DECISION, starpu_task_get_job_id(task), best, best_exp_end);
 
 	//_STARPU_DEBUG("Scheduler dm: kernel (%u)\n", best_impl);
 
@@ -627,8 +1199,9 @@ static void compute_all_performance_predictions(struct starpu_task *task,
 		worker = workers->get_next_master(workers, &it);
 
 		struct _starpu_fifo_taskq *fifo = dt->queue_array[worker];
-		struct starpu_perfmodel_arch* perf_arch = starpu_worker_get_perf_archtype(worker, sched_ctx_id);
-		unsigned memory_node = starpu_worker_get_memory_node(worker);
+		const struct sched_worker_desc *desc = &dt->workers.desc[worker];
+		struct starpu_perfmodel_arch* perf_arch = desc->perf_arch;
+		unsigned memory_node = desc->memory_node;
 
 		STARPU_ASSERT_MSG(fifo != NULL, "worker %u ctx %u\n", worker, sched_ctx_id);
 
@@ -690,7 +1263,7 @@ static void compute_all_performance_predictions(struct starpu_task *task,
 				if (conversion_time > 0.0)
 					local_task_length[worker_ctx][nimpl] += conversion_time;
 			}
-			double ntasks_end = fifo_ntasks / starpu_worker_get_relative_speedup(perf_arch);
+			double ntasks_end = fifo_ntasks / desc->speedup;
 
 			/*
 			 * This implements a default greedy scheduler for the
@@ -824,6 +1397,7 @@ static double _dmda_push_task(struct starpu_task *task, unsigned prio, unsigned
 	if (forced_best == -1)
 	{
 		struct starpu_sched_ctx_iterator it;
+		double now = starpu_timing_now();
 
 		workers->init_iterator(workers, &it);
 		while(workers->has_next_master(workers, &it))
@@ -831,9 +1405,12 @@ static double _dmda_push_task(struct starpu_task *task, unsigned prio, unsigned
 			worker = workers->get_next_master(workers, &it);
 			if (!starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
 				continue;
+			/* Skipped in the loop below only, worker_ctx indexes
+			 * the predictions of every capable worker */
+			int open = hr_worker_open(dt, worker, now);
 			for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
 			{
-				if (!(impl_mask & (1U << nimpl)))
+				if (!(impl_mask & (1U << nimpl)) || !open)
 				{
 					/* no one on that queue may execute this task */
 					continue;
@@ -891,6 +1468,8 @@ static double _dmda_push_task(struct starpu_task *task, unsigned prio, unsigned
 	}
 
 	//_STARPU_DEBUG("Scheduler dmda: kernel (%u)\n", best_impl);
+	SCHED_TRACE(SCHED_TRACE_DECISION, starpu_task_get_job_id(task), best,
+		    forced_best != -1 ? NAN : exp_end[best_in_ctx][selected_impl]);
 	starpu_task_set_implementation(task, selected_impl);
 
 	starpu_sched_task_break(task);
@@ -920,52 +1499,8 @@ static int dmda_push_sorted_task(struct starpu_task *task)
 	return _dmda_push_task(task, 1, task->sched_ctx, 0, 0);
 }
 
-static void starpu_task_list_swap(struct starpu_task_list *list, struct starpu_task* a, struct starpu_task* b)
-{
-	struct starpu_task *pre = a->prev;
-	struct starpu_task *nex = b->next;
-	if(a == list->head) list->head = b;
-	if(b == list->tail) list->tail = a;
-	if(pre != NULL)
-	{
-		pre->next = b;
-		b->prev = pre;
-	}
-	b->next = a;
-	if(nex != NULL)
-	{
-		a->next = nex;
-		nex->prev = a;
-	}
-	a->prev = b;
-	
-}
-
-static void starpu_task_list_sort_on_heter_ratio(struct starpu_task_list *list, unsigned sched_ctx_id)
-{
-	int going = 1;
-	while (going)
-	{
-		going = 0;
-		struct starpu_task* current = list->head;
-		while(current != list->tail)
-		{
-			if(current->hete_ratio < current->next->hete_ratio)
-			{
-				going = 1;
-				starpu_task_list_swap(list, current, current->next);
-			}
-			else
-			{
-				current = current->next;
-			}
-			
-		}
-	}
-	
-}
-
 static double get_task_heter_ratio(unsigned sched_ctx_id,struct starpu_task* task){
+	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
 	struct starpu_worker_collection *workers = starpu_sched_ctx_get_worker_collection(sched_ctx_id);
 	struct starpu_sched_ctx_iterator it;
 	struct starpu_sched_ctx_iterator it1;
@@ -975,14 +1510,15 @@ static double get_task_heter_ratio(unsigned sched_ctx_id,struct starpu_task* tas
 	unsigned worker;
 	unsigned impl_mask;
 	unsigned nimpl;
+	unsigned i;
 
 	workers->init_iterator(workers, &it);
 	while(workers->has_next_master(workers, &it))
 	{
 		worker = workers->get_next_master(workers, &it);
-		unsigned memory_node = starpu_worker_get_memory_node(worker);
-		struct starpu_perfmodel_arch* perf_arch = starpu_worker_get_perf_archtype(worker, sched_ctx_id);
-		if (!starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
+		const struct sched_worker_desc *desc = &dt->workers.desc[worker];
+		struct starpu_perfmodel_arch* perf_arch = desc->perf_arch;
+		if (!sched_workers_may_execute(desc, task) || !starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
 			continue;
 
 		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
@@ -997,15 +1533,27 @@ static double get_task_heter_ratio(unsigned sched_ctx_id,struct starpu_task* tas
 			if (local_length>max_execution_time) max_execution_time = local_length;
 		}
 	}
+	for (i = 0; i < dt->workers.ncombined && hr_task_parallel(task); i++)
+	{
+		/* CPU groups are devices of their own */
+		const struct sched_combined_desc *c = &dt->workers.combined[i];
+		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
+		{
+			if (!starpu_combined_worker_can_execute_task(c->id, task, nimpl))
+				continue;
+			double local_length = 1+starpu_task_expected_length(task, c->perf_arch, nimpl);
+			if (local_length>max_execution_time) max_execution_time = local_length;
+		}
+	}
 	//printf("the max_execution_time is %lf\n", max_execution_time);
 
 	workers->init_iterator(workers, &it1);
 	while(workers->has_next_master(workers, &it1))
 	{
 		worker = workers->get_next_master(workers, &it1);
-		unsigned memory_node = starpu_worker_get_memory_node(worker);
-		struct starpu_perfmodel_arch* perf_arch = starpu_worker_get_perf_archtype(worker, sched_ctx_id);
-		if (!starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
+		const struct sched_worker_desc *desc = &dt->workers.desc[worker];
+		struct starpu_perfmodel_arch* perf_arch = desc->perf_arch;
+		if (!sched_workers_may_execute(desc, task) || !starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
 			continue;
 
 		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
@@ -1020,149 +1568,1453 @@ static double get_task_heter_ratio(unsigned sched_ctx_id,struct starpu_task* tas
 			if(heter_ratio>max_heter_tatio)max_heter_tatio = heter_ratio;
 		}
 	}
+	for (i = 0; i < dt->workers.ncombined && hr_task_parallel(task); i++)
+	{
+		const struct sched_combined_desc *c = &dt->workers.combined[i];
+		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
+		{
+			if (!starpu_combined_worker_can_execute_task(c->id, task, nimpl))
+				continue;
+			double local_length = starpu_task_expected_length(task, c->perf_arch, nimpl);
+			double heter_ratio = max_execution_time/local_length;
+			if(heter_ratio>max_heter_tatio)max_heter_tatio = heter_ratio;
+		}
+	}
 	return max_heter_tatio;
 }
 
 
-static int dm_push_task(struct starpu_task *task)
+static uint32_t hr_task_footprint(struct _starpu_dmda_data *dt, struct starpu_task *task)
 {
-	unsigned sched_ctx_id = task->sched_ctx;
-	struct _starpu_dmda_data *data = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
-	//starpu_task_list_push_front(&data->main_list, task);
-	starpu_task_list_sort_on_heter_ratio(&data->main_list, sched_ctx_id);
-	STARPU_PTHREAD_MUTEX_LOCK(&data->policy_mutex);
+	if (!task->cl || !task->cl->model || !dt->footprint_arch)
+		return 0;
+	return starpu_task_footprint(task->cl->model, task, dt->footprint_arch, 0);
+}
 
-    task->hete_ratio = get_task_heter_ratio(sched_ctx_id, task);
-	if(starpu_task_list_empty(&data->main_list)){
-		starpu_task_list_push_back(&data->main_list, task);
-	}
-	else{
-		struct starpu_task* current = starpu_task_list_begin(&data->main_list);
-		if(task->hete_ratio>current->hete_ratio)
-		{
-			starpu_task_list_push_front(&data->main_list, task);
-		}
-		else{
-			current = current->next;
-			while(current!= NULL){
-				if(task->hete_ratio>current->hete_ratio){
-					current->prev->next = task;
-					task->next = current;
-					task->prev = current->prev;
-					current->prev = task;
-				}
-			}
-		}
-	 }
-	//starpu_push_task_end(task);
-	unsigned int worker_count = 64;
-	all_device_len = 0;
-	for (int i = 0; i < worker_count && data->queue_array[i] != NULL; i++){
-		int count = 0;
-		struct starpu_task *cur = data->queue_array[i]->taskq.head;
-		while (cur != NULL){
-			cur = cur->next;
-			count++;
-		}
-		all_device_len += count;
-	}
-	//printf("%d ", all_device_len);
-//	STARPU_PTHREAD_MUTEX_UNLOCK(&data->policy_mutex);
-	//task = starpu_task_list_begin(&data->main_list);
-	int ret;
-	if (all_device_len <= thr){
-		task = starpu_task_list_pop_front(&data->main_list);
-		ret = _dm_push_task(task, 0, task->sched_ctx);
-	}
-	else{
-		ret = 0;
-//		starpu_push_task_end(task);
+/* Account for a task entering the main list, policy_mutex must be held */
+static void hr_uniform_enter(struct _starpu_dmda_data *dt, struct starpu_task *task)
+{
+	uint32_t footprint = hr_task_footprint(dt, task);
+
+	if (dt->main_list_len == 0 && (task->cl != dt->uniform_cl || footprint != dt->uniform_footprint))
+	{
+		/* The backlog drained, the new task gives the reference class */
+		dt->uniform_cl = task->cl;
+		dt->uniform_footprint = footprint;
+		dt->uniform_len = 0;
 	}
-	STARPU_PTHREAD_MUTEX_UNLOCK(&data->policy_mutex);
-	return ret;
+
+	if (task->cl == dt->uniform_cl && footprint == dt->uniform_footprint)
+		dt->uniform_len++;
+	/* Also read by the sampler, without policy_mutex */
+	__atomic_add_fetch(&dt->main_list_len, 1, __ATOMIC_RELAXED);
 }
 
-static int dmda_push_task(struct starpu_task *task)
+/* Account for a task leaving the main list, policy_mutex must be held */
+static void hr_uniform_leave(struct _starpu_dmda_data *dt, int uniform)
 {
-	STARPU_ASSERT(task);
-	return _dmda_push_task(task, 0, task->sched_ctx, 0, 0);
+	if (uniform)
+		dt->uniform_len--;
+	__atomic_sub_fetch(&dt->main_list_len, 1, __ATOMIC_RELAXED);
 }
-static double dmda_simulate_push_task(struct starpu_task *task)
+
+static struct hr_class *hr_class_slot(struct _starpu_dmda_data *dt, struct starpu_codelet *cl, uint32_t footprint)
 {
-	STARPU_ASSERT(task);
-	return _dmda_push_task(task, 0, task->sched_ctx, 1, 0);
+	return &dt->classes[(((uintptr_t) cl >> 4) ^ footprint) % HR_CLASS_SLOTS];
 }
 
-static double dmda_simulate_push_sorted_task(struct starpu_task *task)
+/* Cached class of CL and FOOTPRINT, or NULL */
+static struct hr_class *hr_class_find(struct _starpu_dmda_data *dt, struct starpu_codelet *cl, uint32_t footprint)
 {
-	STARPU_ASSERT(task);
-	return _dmda_push_task(task, 1, task->sched_ctx, 1, 0);
+	struct hr_class *c = hr_class_slot(dt, cl, footprint);
+	if (c->cached && c->cl == cl && c->footprint == footprint
+	    && c->version == __atomic_load_n(&dt->model_version, __ATOMIC_RELAXED))
+		return c;
+	return NULL;
 }
 
-static double dmda_simulate_push_sorted_decision_task(struct starpu_task *task)
+static int hr_class_usable(struct _starpu_dmda_data *dt, struct hr_class *c)
 {
-	STARPU_ASSERT(task);
-	return _dmda_push_task(task, 1, task->sched_ctx, 1, 1);
+	return c != NULL && c->cached && c->placed < dt->uniform_refresh;
 }
 
-static void dmda_add_workers(unsigned sched_ctx_id, int *workerids, unsigned nworkers)
+static void hr_class_invalidate_all(struct _starpu_dmda_data *dt)
 {
-	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
-
 	unsigned i;
-	for (i = 0; i < nworkers; i++)
+	for (i = 0; i < HR_CLASS_SLOTS; i++)
+		dt->classes[i].cached = 0;
+}
+
+/* Cache the ratio and the per-worker predictions of the class of TASK, using
+ * it as representative. Nothing is cached while the perf model is still
+ * calibrating on some worker. */
+static void hr_class_fill(struct _starpu_dmda_data *dt, struct hr_class *c, struct starpu_task *task, uint32_t footprint, unsigned sched_ctx_id)
+{
+	struct starpu_worker_collection *workers = starpu_sched_ctx_get_worker_collection(sched_ctx_id);
+	struct starpu_sched_ctx_iterator it;
+	unsigned worker;
+	unsigned impl_mask;
+	unsigned nimpl;
+	double total = 0.0;
+
+	dt->class_fills++;
+	c->cl = task->cl;
+	c->footprint = footprint;
+	c->version = __atomic_load_n(&dt->model_version, __ATOMIC_RELAXED);
+	c->cached = 0;
+	c->min_length = DBL_MAX;
+
+	workers->init_iterator(workers, &it);
+	while(workers->has_next_master(workers, &it))
 	{
-		struct _starpu_fifo_taskq *q;
-		int workerid = workerids[i];
-		/* if the worker has alreadry belonged to this context
-		   the queue and the synchronization variables have been already initialized */
-		q = dt->queue_array[workerid];
-		if(q == NULL)
-		{
-			q = dt->queue_array[workerid] = _starpu_create_fifo();
-			/* These are only stats, they can be read with races */
-			STARPU_HG_DISABLE_CHECKING(q->exp_start);
-			STARPU_HG_DISABLE_CHECKING(q->exp_len);
-			STARPU_HG_DISABLE_CHECKING(q->exp_end);
-		}
+		worker = workers->get_next_master(workers, &it);
+		const struct sched_worker_desc *desc = &dt->workers.desc[worker];
+		struct starpu_perfmodel_arch* perf_arch = desc->perf_arch;
 
-		if(dt->num_priorities != -1)
+		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
+			c->length[worker][nimpl] = NAN;
+
+		if (!sched_workers_may_execute(desc, task) || !starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
+			continue;
+
+		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
 		{
-			_STARPU_MALLOC(q->exp_len_per_priority, dt->num_priorities*sizeof(double));
-			_STARPU_MALLOC(q->ntasks_per_priority, dt->num_priorities*sizeof(unsigned));
-			int j;
-			for(j = 0; j < dt->num_priorities; j++)
-			{
-				q->exp_len_per_priority[j] = 0.0;
-				q->ntasks_per_priority[j] = 0;
-			}
+			if (!(impl_mask & (1U << nimpl)))
+				continue;
+
+			double local_length = starpu_task_expected_length(task, perf_arch, nimpl);
+			if (isnan(local_length) || _STARPU_IS_ZERO(local_length))
+				/* Let _dm_push_task drive the calibration */
+				return;
+			c->length[worker][nimpl] = local_length;
+			c->min_length = STARPU_MIN(c->min_length, local_length);
+			total += local_length;
 		}
 	}
+
+	c->ratio = get_task_heter_ratio(sched_ctx_id, task);
+	/* Same as hr_avg_execution_time */
+	c->avg_length = total / dt->workers.nworkers;
+	c->placed = 0;
+	c->cached = 1;
 }
 
-static void dmda_remove_workers(unsigned sched_ctx_id, int *workerids, unsigned nworkers)
+/* Class of TASK with fresh predictions, or NULL while calibrating */
+static struct hr_class *hr_class_get(struct _starpu_dmda_data *dt, struct starpu_task *task, uint32_t footprint, unsigned sched_ctx_id)
 {
-	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
+	struct hr_class *c = hr_class_find(dt, task->cl, footprint);
+	if (!task->cl)
+		return NULL;
+	if (c == NULL || c->placed >= dt->uniform_refresh)
+	{
+		c = hr_class_slot(dt, task->cl, footprint);
+		hr_class_fill(dt, c, task, footprint, sched_ctx_id);
+	}
+	return c->cached ? c : NULL;
+}
+
+/* Placement from the cached predictions of class C: earliest expected end,
+ * the perf models are not queried */
+static int _dm_push_task_cached(struct starpu_task *task, struct hr_class *c, unsigned prio, unsigned sched_ctx_id)
+{
+	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
+	struct starpu_worker_collection *workers = starpu_sched_ctx_get_worker_collection(sched_ctx_id);
+	struct starpu_sched_ctx_iterator it;
+	unsigned worker;
+	unsigned nimpl;
+	int best = -1;
+	unsigned best_impl = 0;
+	double best_exp_end = 0.0;
+	double model_best = 0.0;
+	double now = starpu_timing_now();
+
+	workers->init_iterator(workers, &it);
+	while(workers->has_next_master(workers, &it))
+	{
+		worker = workers->get_next_master(workers, &it);
+		struct _starpu_fifo_taskq *fifo = dt->queue_array[worker];
+		double exp_start = isnan(fifo->exp_start) ? now : STARPU_MAX(fifo->exp_start, now);
+
+		if (!hr_worker_open(dt, worker, now))
+			continue;
+
+		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
+		{
+			double local_length = c->length[worker][nimpl];
+			if (isnan(local_length))
+				continue;
+
+			double exp_end = exp_start + fifo->exp_len + local_length;
+			SCHED_TRACE(SCHED_TRACE_CANDIDATE, starpu_task_get_job_id(task), worker, exp_end);
+			if (best == -1 || exp_end < best_exp_end)
+			{
+				best_exp_end = exp_end;
+				best = worker;
+				best_impl = nimpl;
+				model_best = local_length;
+			}
+		}
+	}
+	STARPU_ASSERT(best != -1);
+	SCHED_TRACE(SCHED_TRACE_DECISION, starpu_task_get_job_id(task), best, best_exp_end);
+
+	double transfer_model_best = starpu_task_expected_data_transfer_time(dt->workers.desc[best].memory_node, task);
+
+	c->placed++;
+	starpu_task_set_implementation(task, best_impl);
+	starpu_sched_task_break(task);
+	return push_task_on_best_worker(task, best,
+					model_best, transfer_model_best, prio, sched_ctx_id);
+}
+
+/* Deepest tier whose measured cost fits in the budget of a task of class C.
+ * The costs start at 0, so each tier is tried before being ruled out. */
+static enum hr_tier hr_choose_tier(struct _starpu_dmda_data *dt, struct hr_class *c)
+{
+	int tier;
+
+	if (c == NULL)
+		/* Not predicted yet, _dm_push_task calibrates */
+		return HR_TIER_EFT;
+
+	double allowed = dt->budget * c->min_length;
+	for (tier = HR_TIER_FULL; tier > HR_TIER_CACHED; tier--)
+		if (dt->key_cost[tier] + dt->place_cost[tier] <= allowed)
+			return tier;
+	return HR_TIER_CACHED;
+}
+
+/* Account for a decision of TIER which took MEASURED us in COSTS */
+static void hr_tier_account(double costs[HR_NTIERS], enum hr_tier tier, double measured)
+{
+	int deeper;
+
+	costs[tier] += _HR_TIER_COST_WEIGHT * (measured - costs[tier]);
+	for (deeper = tier + 1; deeper < HR_NTIERS; deeper++)
+		costs[deeper] *= 1.0 - _HR_TIER_COST_DECAY;
+}
+
+/* Task records, policy_mutex held */
+
+static struct hr_job **hr_job_slot(struct _starpu_dmda_data *dt, unsigned long job_id)
+{
+	struct hr_job **job = &dt->job_index[job_id % HR_JOB_SLOTS];
+	while (*job && (*job)->job_id != job_id)
+		job = &(*job)->hash_next;
+	return job;
+}
+
+static struct hr_job *hr_job_find(struct _starpu_dmda_data *dt, struct starpu_task *task)
+{
+	return *hr_job_slot(dt, starpu_task_get_job_id(task));
+}
+
+/* Record of TASK, created if it has none */
+static struct hr_job *hr_job_get(struct _starpu_dmda_data *dt, struct starpu_task *task)
+{
+	unsigned long job_id = starpu_task_get_job_id(task);
+	struct hr_job **slot = hr_job_slot(dt, job_id);
+	struct hr_job *job = *slot;
+	unsigned i;
+
+	if (job)
+		return job;
+
+	if (!dt->job_free)
+	{
+		struct hr_job_slab *slab;
+		_STARPU_MALLOC(slab, sizeof(*slab));
+		slab->next = dt->job_slabs;
+		dt->job_slabs = slab;
+		/* Handed out in address order */
+		for (i = HR_JOB_SLAB; i-- > 0; )
+		{
+			slab->jobs[i].next = dt->job_free;
+			dt->job_free = &slab->jobs[i];
+		}
+	}
+	job = dt->job_free;
+	dt->job_free = job->next;
+
+	job->prev = NULL;
+	job->next = NULL;
+	job->hash_next = NULL;
+	job->task = task;
+	job->job_id = job_id;
+	job->key = 0.0;
+	job->ratio = NAN;
+	job->rank = NAN;
+	job->deadline = NAN;
+	job->version = __atomic_load_n(&dt->model_version, __ATOMIC_RELAXED);
+	job->predicted = 0;
+	*slot = job;
+	return job;
+}
+
+static void hr_job_free(struct _starpu_dmda_data *dt, struct hr_job *job)
+{
+	struct hr_job **slot = hr_job_slot(dt, job->job_id);
+	STARPU_ASSERT(*slot == job);
+	*slot = job->hash_next;
+	job->next = dt->job_free;
+	dt->job_free = job;
+}
+
+/* JOB left the backlog to be placed. Its record is only kept for the
+ * deadline check of post_exec. */
+static struct starpu_task *hr_job_dispatched(struct _starpu_dmda_data *dt, struct hr_job *job)
+{
+	struct starpu_task *task = job->task;
+	if (isnan(job->deadline))
+		hr_job_free(dt, job);
+	return task;
+}
+
+static int hr_job_list_empty(const struct hr_job_list *list)
+{
+	return list->head == NULL;
+}
+
+static void hr_job_list_push_back(struct hr_job_list *list, struct hr_job *job)
+{
+	job->prev = list->tail;
+	job->next = NULL;
+	if (list->tail)
+		list->tail->next = job;
+	else
+		list->head = job;
+	list->tail = job;
+}
+
+static void hr_job_list_push_front(struct hr_job_list *list, struct hr_job *job)
+{
+	job->prev = NULL;
+	job->next = list->head;
+	if (list->head)
+		list->head->prev = job;
+	else
+		list->tail = job;
+	list->head = job;
+}
+
+static struct hr_job *hr_job_list_pop_front(struct hr_job_list *list)
+{
+	struct hr_job *job = list->head;
+	if (job)
+	{
+		list->head = job->next;
+		if (list->head)
+			list->head->prev = NULL;
+		else
+			list->tail = NULL;
+		job->next = NULL;
+	}
+	return job;
+}
+
+/* Insert JOB in LIST, kept sorted by decreasing key. Tasks with the same key
+ * stay in submission order. */
+static void hr_main_list_insert(struct hr_job_list *list, struct hr_job *job)
+{
+	struct hr_job *current = list->head;
+	while (current != NULL && current->key >= job->key)
+		current = current->next;
+
+	if (current == NULL)
+		hr_job_list_push_back(list, job);
+	else if (current == list->head)
+		hr_job_list_push_front(list, job);
+	else
+	{
+		job->prev = current->prev;
+		job->next = current;
+		current->prev->next = job;
+		current->prev = job;
+	}
+}
+
+
+/* Upward rank, ported from the rank-based policy: average execution time of
+ * the task plus the most expensive successor, transfer included */
+static double hr_avg_execution_time(struct _starpu_dmda_data *dt, unsigned sched_ctx_id, struct starpu_task *task)
+{
+	struct starpu_worker_collection *workers = starpu_sched_ctx_get_worker_collection(sched_ctx_id);
+	struct starpu_sched_ctx_iterator it;
+	unsigned m = dt->workers.nworkers;
+	double total = 0.0;
+	unsigned impl_mask;
+	unsigned nimpl;
+
+	workers->init_iterator(workers, &it);
+	while(workers->has_next_master(workers, &it))
+	{
+		unsigned worker = workers->get_next_master(workers, &it);
+		const struct sched_worker_desc *desc = &dt->workers.desc[worker];
+		struct starpu_perfmodel_arch* perf_arch = desc->perf_arch;
+		if (!sched_workers_may_execute(desc, task) || !starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
+			continue;
+
+		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
+		{
+			if (!(impl_mask & (1U << nimpl)))
+				continue;
+			double local_length = starpu_task_expected_length(task, perf_arch, nimpl);
+			if (!isnan(local_length))
+				total += local_length;
+		}
+	}
+	return total / m;
+}
+
+/* Average time to move the data of SUCC between two distinct workers */
+static double hr_data_transfer_time(struct _starpu_dmda_data *dt, struct starpu_task *succ)
+{
+	unsigned nbuffers = STARPU_TASK_GET_NBUFFERS(succ);
+	unsigned buffer;
+	double penalty = 0.0;
+
+	for (buffer = 0; buffer < nbuffers; buffer++)
+	{
+		starpu_data_handle_t handle = STARPU_TASK_GET_HANDLE(succ, buffer);
+		penalty += sched_workers_transfer_time(&dt->workers, _starpu_data_get_size(handle));
+	}
+	return penalty;
+}
+
+static double hr_task_rank(struct _starpu_dmda_data *dt, unsigned sched_ctx_id, struct starpu_task *task, int with_transfer)
+{
+	double max_succ = 0.0;
+	int nsuccs = starpu_task_get_task_succs(task, 0, NULL);
+	int i;
+
+	if (nsuccs > 0)
+	{
+		struct starpu_task *succs[nsuccs];
+		nsuccs = starpu_task_get_task_succs(task, nsuccs, succs);
+		for (i = 0; i < nsuccs; i++)
+		{
+			double succ = hr_avg_execution_time(dt, sched_ctx_id, succs[i]);
+			if (with_transfer)
+				succ += hr_data_transfer_time(dt, succs[i]);
+			if (succ > max_succ)
+				max_succ = succ;
+		}
+	}
+	return hr_avg_execution_time(dt, sched_ctx_id, task) + max_succ;
+}
+
+static unsigned hr_job_class(uint32_t where)
+{
+	switch (where)
+	{
+	case STARPU_CPU:
+		return 0;
+	case STARPU_CUDA:
+		return 1;
+	case STARPU_OPENCL:
+		return 2;
+	default:
+		return 3;
+	}
+}
+
+static void hr_job_account(struct hr_job *job, unsigned class, double length, double *min_length, double *max_length)
+{
+	if (isnan(*min_length) || length < *min_length)
+		*min_length = length;
+	if (isnan(*max_length) || length > *max_length)
+		*max_length = length;
+	if (isnan(job->min_length[class]) || length < job->min_length[class])
+		job->min_length[class] = length;
+	if (isnan(job->max_length[class]) || length > job->max_length[class])
+		job->max_length[class] = length;
+}
+
+/* Drop what JOB computed under an older perf model version */
+static void hr_job_refresh(struct _starpu_dmda_data *dt, struct hr_job *job)
+{
+	unsigned version = __atomic_load_n(&dt->model_version, __ATOMIC_RELAXED);
+	if (job->version != version)
+	{
+		job->version = version;
+		job->predicted = 0;
+		job->ratio = NAN;
+		job->rank = NAN;
+	}
+}
+
+/* Shortest and longest expected length of JOB over the worker classes,
+ * returns 0 if no prediction is available yet */
+static int hr_job_range(const struct hr_job *job, double *min_length, double *max_length)
+{
+	unsigned class;
+	int found = 0;
+
+	for (class = 0; class < HR_JOB_NCLASSES; class++)
+	{
+		if (isnan(job->min_length[class]))
+			continue;
+		if (!found || job->min_length[class] < *min_length)
+			*min_length = job->min_length[class];
+		if (!found || job->max_length[class] > *max_length)
+			*max_length = job->max_length[class];
+		found = 1;
+	}
+	return found;
+}
+
+/* Lengths per worker class of JOB, CPU groups included for a parallel task,
+ * and its heterogeneity ratio, once per perf model version. The ratio is the
+ * one of get_task_heter_ratio, (1 + longest) / shortest, or 0 without
+ * prediction, in a single pass over the perf models. */
+static void hr_job_predict(struct _starpu_dmda_data *dt, unsigned sched_ctx_id, struct hr_job *job)
+{
+	struct starpu_task *task = job->task;
+	struct starpu_worker_collection *workers = starpu_sched_ctx_get_worker_collection(sched_ctx_id);
+	struct starpu_sched_ctx_iterator it;
+	double min_length = NAN, max_length = NAN;
+	unsigned impl_mask;
+	unsigned nimpl, class, i;
+
+	hr_job_refresh(dt, job);
+	if (job->predicted)
+		return;
+
+	for (class = 0; class < HR_JOB_NCLASSES; class++)
+	{
+		job->min_length[class] = NAN;
+		job->max_length[class] = NAN;
+	}
+
+	workers->init_iterator(workers, &it);
+	while(workers->has_next_master(workers, &it))
+	{
+		unsigned worker = workers->get_next_master(workers, &it);
+		const struct sched_worker_desc *desc = &dt->workers.desc[worker];
+		if (!sched_workers_may_execute(desc, task) || !starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
+			continue;
+
+		class = hr_job_class(desc->where);
+		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
+		{
+			if (!(impl_mask & (1U << nimpl)))
+				continue;
+			double local_length = starpu_task_expected_length(task, desc->perf_arch, nimpl);
+			if (!isnan(local_length))
+				hr_job_account(job, class, local_length, &min_length, &max_length);
+		}
+	}
+	for (i = 0; i < dt->workers.ncombined && hr_task_parallel(task); i++)
+	{
+		/* CPU groups are devices of their own */
+		const struct sched_combined_desc *c = &dt->workers.combined[i];
+		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
+		{
+			if (!starpu_combined_worker_can_execute_task(c->id, task, nimpl))
+				continue;
+			double local_length = starpu_task_expected_length(task, c->perf_arch, nimpl);
+			if (!isnan(local_length))
+				hr_job_account(job, 0, local_length, &min_length, &max_length);
+		}
+	}
+
+	/* From the exact lengths, the record only keeps floats */
+	job->ratio = isnan(min_length) ? 0.0 : (1 + max_length) / min_length;
+	job->predicted = 1;
+}
+
+/* Best predicted end of TASK over the workers, from the same exp_end data as
+ * _dm_push_task, or NAN without prediction */
+static double hr_task_best_end(struct _starpu_dmda_data *dt, unsigned sched_ctx_id, struct starpu_task *task, double now)
+{
+	struct starpu_worker_collection *workers = starpu_sched_ctx_get_worker_collection(sched_ctx_id);
+	struct starpu_sched_ctx_iterator it;
+	unsigned impl_mask;
+	unsigned nimpl;
+	double best = NAN;
+
+	workers->init_iterator(workers, &it);
+	while(workers->has_next_master(workers, &it))
+	{
+		unsigned worker = workers->get_next_master(workers, &it);
+		const struct sched_worker_desc *desc = &dt->workers.desc[worker];
+		struct _starpu_fifo_taskq *fifo = dt->queue_array[worker];
+		if (!sched_workers_may_execute(desc, task) || !starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
+			continue;
+
+		double exp_start = isnan(fifo->exp_start) ? now : STARPU_MAX(fifo->exp_start, now);
+		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
+		{
+			if (!(impl_mask & (1U << nimpl)))
+				continue;
+			double local_length = starpu_task_expected_length(task, desc->perf_arch, nimpl);
+			if (isnan(local_length))
+				continue;
+			double exp_end = exp_start + fifo->exp_len + local_length;
+			if (isnan(best) || exp_end < best)
+				best = exp_end;
+		}
+	}
+	return best;
+}
+
+/* Deadline minus the best predicted end, or minus now without prediction */
+static double hr_task_slack(struct _starpu_dmda_data *dt, unsigned sched_ctx_id, struct starpu_task *task, double deadline)
+{
+	double now = starpu_timing_now();
+	double end = hr_task_best_end(dt, sched_ctx_id, task, now);
+	return deadline - (isnan(end) ? now : end);
+}
+
+static double hr_task_key(struct _starpu_dmda_data *dt, struct starpu_task *task, struct hr_job *job, enum hr_mode mode, unsigned sched_ctx_id);
+
+/* Least slack first: the key is minus the slack in quanta, its fractional
+ * part grows with the heterogeneity ratio */
+static double hr_deadline_key(struct _starpu_dmda_data *dt, struct starpu_task *task, struct hr_job *job, unsigned sched_ctx_id)
+{
+	double ratio = hr_task_key(dt, task, job, HR_MODE_RATIO, sched_ctx_id);
+	double tie = ratio > 0.0 && isfinite(ratio) ? ratio / (1.0 + ratio) : 0.0;
+
+	if (!job || isnan(job->deadline))
+		return -_HR_DEADLINE_NONE_KEY + tie;
+	return -floor(hr_task_slack(dt, sched_ctx_id, task, job->deadline) / dt->deadline_quantum) + tie;
+}
+
+/* Ordering key of TASK in MODE. Ratio and rank are kept in its record JOB,
+ * when it has one. When replaying, the recorded order instead, whatever the
+ * mode. */
+static double hr_task_key(struct _starpu_dmda_data *dt, struct starpu_task *task, struct hr_job *job, enum hr_mode mode, unsigned sched_ctx_id)
+{
+	uint32_t footprint = hr_task_footprint(dt, task);
+	struct hr_class *c;
+
+	if (dt->replay)
+	{
+		const struct sched_replay_decision *d = sched_replay_find(starpu_task_get_job_id(task));
+		return d ? -(double) d->order : -_HR_REPLAY_NONE_KEY;
+	}
+
+	switch (mode)
+	{
+	case HR_MODE_RATIO:
+		/* The ratio only depends on the class */
+		c = hr_class_find(dt, task->cl, footprint);
+		if (c)
+			return c->ratio;
+		if (job)
+		{
+			hr_job_predict(dt, sched_ctx_id, job);
+			return job->ratio;
+		}
+		return get_task_heter_ratio(sched_ctx_id, task);
+	case HR_MODE_RANK:
+		if (dt->budget > 0.0)
+		{
+			/* A refill of the class is charged to the tier */
+			double start = starpu_timing_now();
+			c = hr_class_get(dt, task, footprint, sched_ctx_id);
+			enum hr_tier tier = hr_choose_tier(dt, c);
+			double rank;
+
+			if (tier == HR_TIER_CACHED)
+				/* Successors are not looked at */
+				rank = c->avg_length;
+			else
+				rank = hr_task_rank(dt, sched_ctx_id, task, tier == HR_TIER_FULL);
+			hr_tier_account(dt->key_cost, tier, starpu_timing_now() - start);
+			return rank;
+		}
+		if (job)
+		{
+			hr_job_refresh(dt, job);
+			if (isnan(job->rank))
+				job->rank = hr_task_rank(dt, sched_ctx_id, task, 1);
+			return job->rank;
+		}
+		return hr_task_rank(dt, sched_ctx_id, task, 1);
+	case HR_MODE_DEADLINE:
+		return hr_deadline_key(dt, task, job, sched_ctx_id);
+	default:
+		return 0.0;
+	}
+}
+
+static int hr_key_cmp(const void *a, const void *b)
+{
+	const struct hr_job *ja = *(const struct hr_job **)a;
+	const struct hr_job *jb = *(const struct hr_job **)b;
+
+	if (ja->key != jb->key)
+		return ja->key > jb->key ? -1 : 1;
+	/* Keep the submission order between equal keys */
+	return ja->job_id < jb->job_id ? -1 : ja->job_id > jb->job_id;
+}
+
+/* Give the tasks of the main list the key of the current mode and version,
+ * and sort it again, policy_mutex held */
+static void hr_main_list_rekey(struct _starpu_dmda_data *dt, unsigned sched_ctx_id)
+{
+	struct hr_job *job;
+	unsigned n = 0, i = 0;
+
+	dt->keyed_version = __atomic_load_n(&dt->model_version, __ATOMIC_RELAXED);
+	dt->rekey_dispatched = 0;
+
+	for (job = dt->main_list.head; job != NULL; job = job->next)
+		n++;
+	if (n == 0)
+		return;
+
+	struct hr_job **jobs;
+	_STARPU_MALLOC(jobs, n*sizeof(*jobs));
+	while (!hr_job_list_empty(&dt->main_list))
+	{
+		job = hr_job_list_pop_front(&dt->main_list);
+		job->key = hr_task_key(dt, job->task, job, dt->mode, sched_ctx_id);
+		jobs[i++] = job;
+	}
+
+	/* In fifo mode all keys are 0, this restores the job order */
+	qsort(jobs, n, sizeof(*jobs), hr_key_cmp);
+	for (i = 0; i < n; i++)
+		hr_job_list_push_back(&dt->main_list, jobs[i]);
+	free(jobs);
+}
+
+/* Switch to MODE at a safe point, policy_mutex held */
+static void hr_meta_switch(struct _starpu_dmda_data *dt, enum hr_mode mode, unsigned sched_ctx_id)
+{
+	SCHED_LOG_INFO("H-Ratio ordering switches from %s to %s, %u queued tasks\n",
+		       hr_mode_names[dt->mode], hr_mode_names[mode], dt->main_list_len);
+	dt->mode = mode;
+	dt->meta_switches++;
+	hr_main_list_rekey(dt, sched_ctx_id);
+}
+
+/* Pick the ordering matching the last window: deep DAGs go by rank, uniform
+ * workloads in submission order, the rest by heterogeneity ratio */
+static enum hr_mode hr_meta_decide(struct _starpu_dmda_data *dt)
+{
+	struct hr_meta_window *w = &dt->window;
+
+	if (w->max_depth >= dt->meta_depth && w->sum_fanout >= w->n)
+		return HR_MODE_RANK;
+
+	if (w->nsampled > 0 && w->nmodelled == w->nsampled)
+	{
+		double mean_length = w->sum_length / w->n;
+		double mean_ratio = w->sum_ratio / w->n;
+		double var_length = w->sum_length2 / w->n - mean_length * mean_length;
+		double var_ratio = w->sum_ratio2 / w->n - mean_ratio * mean_ratio;
+		double cv_length = mean_length > 0.0 ? sqrt(STARPU_MAX(var_length, 0.0)) / mean_length : 0.0;
+		double cv_ratio = mean_ratio > 0.0 ? sqrt(STARPU_MAX(var_ratio, 0.0)) / mean_ratio : 0.0;
+
+		if (cv_length < dt->meta_uniform_cv && cv_ratio < dt->meta_uniform_cv)
+			return HR_MODE_FIFO;
+	}
+
+	return HR_MODE_RATIO;
+}
+
+/* Account for TASK in the observation window, policy_mutex held. Once the
+ * window is full, the ordering is switched if two windows in a row agree on
+ * it. */
+static void hr_meta_observe(struct _starpu_dmda_data *dt, struct hr_job *job, unsigned sched_ctx_id)
+{
+	struct starpu_task *task = job->task;
+	struct hr_meta_window *w = &dt->window;
+	unsigned long job_id = starpu_task_get_job_id(task);
+	unsigned slot = job_id % HR_META_DEPTH_SLOTS;
+	unsigned depth = dt->depth_job[slot] == job_id ? dt->depth_value[slot] : 0;
+	double min_length, max_length;
+	int nsuccs, i;
+
+	/* Announce the depth of the successors */
+	nsuccs = starpu_task_get_task_succs(task, 0, NULL);
+	if (nsuccs > 0)
+	{
+		struct starpu_task *succs[nsuccs];
+		nsuccs = starpu_task_get_task_succs(task, nsuccs, succs);
+		for (i = 0; i < nsuccs; i++)
+		{
+			unsigned long succ_id = starpu_task_get_job_id(succs[i]);
+			unsigned succ_slot = succ_id % HR_META_DEPTH_SLOTS;
+			if (dt->depth_job[succ_slot] != succ_id || dt->depth_value[succ_slot] < depth + 1)
+			{
+				dt->depth_job[succ_slot] = succ_id;
+				dt->depth_value[succ_slot] = depth + 1;
+			}
+		}
+		w->sum_fanout += nsuccs;
+	}
+	if (depth > w->max_depth)
+		w->max_depth = depth;
+
+	/* Lengths and ratio from the cached class predictions when there are
+	 * some, otherwise from the perf models for one push in meta_sample
+	 * only: querying them for every push would cost as much as the
+	 * placement itself */
+	struct hr_class *c = hr_class_find(dt, task->cl, hr_task_footprint(dt, task));
+	int sampled = 1, modelled = 0;
+	double ratio = 0.0;
+	if (c && c->cached)
+	{
+		modelled = 1;
+		min_length = c->min_length;
+		ratio = c->ratio;
+	}
+	else if (dt->meta_pushes++ % dt->meta_sample == 0)
+	{
+		/* Kept in the record for the ratio key */
+		hr_job_predict(dt, sched_ctx_id, job);
+		modelled = hr_job_range(job, &min_length, &max_length);
+		ratio = job->ratio;
+	}
+	else
+		sampled = 0;
+	w->nsampled += sampled;
+	if (modelled)
+	{
+		w->nmodelled++;
+		w->sum_length += min_length;
+		w->sum_length2 += min_length * min_length;
+		w->sum_ratio += ratio;
+		w->sum_ratio2 += ratio * ratio;
+	}
+
+	if (++w->n >= dt->meta_window)
+	{
+		enum hr_mode mode = hr_meta_decide(dt);
+		if (mode != dt->mode && mode == dt->meta_candidate)
+			hr_meta_switch(dt, mode, sched_ctx_id);
+		dt->meta_candidate = mode;
+		memset(w, 0, sizeof(*w));
+	}
+}
+
+/* Move the pending tasks to the main list, computing their key */
+static void hr_pending_flush(struct _starpu_dmda_data *dt, unsigned sched_ctx_id)
+{
+	while (!hr_job_list_empty(&dt->pending_list))
+	{
+		struct hr_job *job = hr_job_list_pop_front(&dt->pending_list);
+		job->key = hr_task_key(dt, job->task, job, dt->mode, sched_ctx_id);
+		SCHED_TRACE(dt->mode == HR_MODE_RANK ? SCHED_TRACE_RANK : SCHED_TRACE_RATIO,
+			    job->job_id, -1, job->key);
+		hr_main_list_insert(&dt->main_list, job);
+	}
+}
+
+/* Take the next task to dispatch, policy_mutex held. Keys are computed here
+ * rather than at push time, so that they use the latest predictions, and
+ * only when the order depends on them: a lone task, a fifo ordering or a
+ * homogeneous backlog are dispatched in submission order. The main list
+ * only holds tasks older than the pending ones. The list the task was taken
+ * from is stored in FROM: a task taken from the pending list has no key. */
+static struct hr_job *hr_next_task(struct _starpu_dmda_data *dt, unsigned sched_ctx_id, struct hr_job_list **from)
+{
+	*from = &dt->main_list;
+	if (!dt->replay && (dt->mode == HR_MODE_FIFO || (dt->mode == HR_MODE_RATIO && dt->uniform_len == dt->main_list_len)))
+	{
+		if (!hr_job_list_empty(&dt->main_list))
+			return hr_job_list_pop_front(&dt->main_list);
+		*from = &dt->pending_list;
+		return hr_job_list_pop_front(&dt->pending_list);
+	}
+
+	if (hr_job_list_empty(&dt->main_list) && dt->main_list_len == 1)
+	{
+		*from = &dt->pending_list;
+		return hr_job_list_pop_front(&dt->pending_list);
+	}
+
+	/* The perf models changed since the main list was sorted. Sorting
+	 * again is not cheap, do it at most every uniform_refresh dispatches. */
+	if (dt->keyed_version != __atomic_load_n(&dt->model_version, __ATOMIC_RELAXED)
+	    && dt->rekey_dispatched >= dt->uniform_refresh)
+		hr_main_list_rekey(dt, sched_ctx_id);
+	dt->rekey_dispatched++;
+
+	hr_pending_flush(dt, sched_ctx_id);
+	return hr_job_list_pop_front(&dt->main_list);
+}
+
+/* Late TASK: to the capable worker with the shortest expected length,
+ * whatever its queue. Returns 1 when no worker has a prediction. */
+static int hr_push_fastest(struct _starpu_dmda_data *dt, struct starpu_task *task, unsigned sched_ctx_id, int *ret)
+{
+	struct starpu_worker_collection *workers = starpu_sched_ctx_get_worker_collection(sched_ctx_id);
+	struct starpu_sched_ctx_iterator it;
+	unsigned impl_mask;
+	unsigned nimpl, best_impl = 0;
+	double best_length = NAN;
+	double now = starpu_timing_now();
+	int best = -1;
+
+	workers->init_iterator(workers, &it);
+	while(workers->has_next_master(workers, &it))
+	{
+		unsigned worker = workers->get_next_master(workers, &it);
+		const struct sched_worker_desc *desc = &dt->workers.desc[worker];
+		if (!hr_worker_open(dt, worker, now) || !sched_workers_may_execute(desc, task)
+		    || !starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
+			continue;
+
+		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
+		{
+			if (!(impl_mask & (1U << nimpl)))
+				continue;
+			double local_length = starpu_task_expected_length(task, desc->perf_arch, nimpl);
+			if (isnan(local_length) || (best != -1 && local_length >= best_length))
+				continue;
+			best = worker;
+			best_impl = nimpl;
+			best_length = local_length;
+		}
+	}
+	if (best == -1)
+		return 1;
+
+	SCHED_TRACE(SCHED_TRACE_DECISION, starpu_task_get_job_id(task), best, NAN);
+	starpu_task_set_implementation(task, best_impl);
+	starpu_sched_task_break(task);
+	*ret = push_task_on_best_worker(task, best, best_length,
+					starpu_task_expected_data_transfer_time(dt->workers.desc[best].memory_node, task),
+					0, sched_ctx_id);
+	return 0;
+}
+
+/* TASK to the worker and implementation of its replayed decision. Returns 1
+ * when it has none, or when that worker is not a worker of the context able
+ * to run it: CPU groups are not replayed. */
+static int hr_push_replayed(struct _starpu_dmda_data *dt, struct starpu_task *task, unsigned sched_ctx_id, int *ret)
+{
+	const struct sched_replay_decision *d = sched_replay_find(starpu_task_get_job_id(task));
+	unsigned impl_mask;
+
+	if (!d || d->worker < 0 || (unsigned) d->worker >= starpu_worker_get_count()
+	    /* Whatever the horizon and the fair share: the run replays */
+	    || !sched_workers_contains(&dt->workers, d->worker)
+	    || !sched_workers_may_execute(&dt->workers.desc[d->worker], task)
+	    || d->impl >= STARPU_MAXIMPLEMENTATIONS
+	    || !starpu_worker_can_execute_task_impl(d->worker, task, &impl_mask)
+	    || !(impl_mask & (1U << d->impl)))
+	{
+		dt->replay_misses++;
+		return 1;
+	}
+	dt->replay_hits++;
+
+	const struct sched_worker_desc *desc = &dt->workers.desc[d->worker];
+	SCHED_TRACE(SCHED_TRACE_DECISION, starpu_task_get_job_id(task), d->worker, NAN);
+	starpu_task_set_implementation(task, d->impl);
+	starpu_sched_task_break(task);
+	*ret = push_task_on_best_worker(task, d->worker, starpu_task_expected_length(task, desc->perf_arch, d->impl),
+					starpu_task_expected_data_transfer_time(desc->memory_node, task),
+					0, sched_ctx_id);
+	return 0;
+}
+
+/* Place TASK, just taken from the main list, policy_mutex held */
+static int hr_dispatch(struct _starpu_dmda_data *dt, struct starpu_task *task, unsigned sched_ctx_id)
+{
+	uint32_t footprint = hr_task_footprint(dt, task);
+	int uniform = task->cl == dt->uniform_cl && footprint == dt->uniform_footprint;
+	struct hr_class *c;
+	int ret;
+
+	hr_uniform_leave(dt, uniform);
+
+	if (dt->replay && hr_push_replayed(dt, task, sched_ctx_id, &ret) == 0)
+		return ret;
+
+	if (dt->workers.ncombined > 0 && hr_task_parallel(task))
+		/* Only the EFT placement looks at the combined workers */
+		return _dm_push_task(task, 0, sched_ctx_id);
+
+	if (dt->ndeadlines > 0)
+	{
+		/* Negative slack: the deadline cannot be met by the earliest
+		 * finish, lose as little as possible, whatever the energy */
+		struct hr_job *job = hr_job_find(dt, task);
+		if (job && !isnan(job->deadline) && hr_task_slack(dt, sched_ctx_id, task, job->deadline) < 0.0
+		    && hr_push_fastest(dt, task, sched_ctx_id, &ret) == 0)
+			return ret;
+	}
+
+	if (dt->energy != HR_ENERGY_OFF)
+		/* Only the EFT placement looks at the energy */
+		return _dm_push_task(task, 0, sched_ctx_id);
+
+	if (dt->budget <= 0.0)
+	{
+		/* Only the homogeneous backlog uses the cached placement */
+		c = uniform ? hr_class_get(dt, task, footprint, sched_ctx_id) : NULL;
+		if (hr_class_usable(dt, c))
+			return _dm_push_task_cached(task, c, 0, sched_ctx_id);
+		return _dm_push_task(task, 0, sched_ctx_id);
+	}
+
+	/* A refill of the class is charged to the tier */
+	double start = starpu_timing_now();
+	c = hr_class_get(dt, task, footprint, sched_ctx_id);
+	enum hr_tier tier = hr_choose_tier(dt, c);
+
+	switch (tier)
+	{
+	case HR_TIER_CACHED:
+		ret = _dm_push_task_cached(task, c, 0, sched_ctx_id);
+		break;
+	case HR_TIER_EFT:
+		ret = _dm_push_task(task, 0, sched_ctx_id);
+		break;
+	default:
+		ret = _dmda_push_task(task, 0, sched_ctx_id, 0, 0);
+		break;
+	}
+	hr_tier_account(dt->place_cost, tier, starpu_timing_now() - start);
+	dt->tier_count[tier]++;
+
+	return ret;
+}
+
+/* Whether some worker below the horizon can execute TASK */
+static int hr_task_fits_open(struct _starpu_dmda_data *dt, struct starpu_task *task, double now)
+{
+	unsigned i, nimpl;
+
+	for (i = 0; i < dt->workers.nworkers; i++)
+	{
+		int worker = dt->workers.ids[i];
+		if (hr_worker_open(dt, worker, now)
+		    && sched_workers_may_execute(&dt->workers.desc[worker], task)
+		    && starpu_worker_can_execute_task_first_impl(worker, task, &nimpl))
+			return 1;
+	}
+	return 0;
+}
+
+/* Number of tasks in the worker queues */
+static int hr_device_len(struct _starpu_dmda_data *dt)
+{
+	int len = 0;
+
+	for (int i = 0; i < STARPU_NMAXWORKERS; i++)
+	{
+		if (dt->queue_array[i] != NULL)
+			len += dt->queue_array[i]->ntasks;
+	}
+	return len;
+}
+
+/* Fair share: take the verdict once per dispatch, policy_mutex held, for
+ * hr_worker_open to read in the per-worker loops */
+static void hr_share_check(struct _starpu_dmda_data *dt)
+{
+	dt->share_open = dt->share == NULL || sched_share_may_use(dt->share);
+}
+
+/* Horizon gating or fair share: dispatch from the backlog while some open
+ * worker can execute the next task, policy_mutex held. Without horizon, the
+ * worker queues still hold at most thr tasks. When no open worker can run
+ * the next task, it stays at the head until a push, pre_exec or post_exec
+ * opens one, or another context pokes the share. */
+static int hr_release(struct _starpu_dmda_data *dt, unsigned sched_ctx_id)
+{
+	int ret = 0;
+
+	while (ret == 0 && dt->main_list_len > 0
+	       && (dt->horizon > 0.0 || hr_device_len(dt) <= thr))
+	{
+		struct hr_job_list *from;
+		struct hr_job *job = hr_next_task(dt, sched_ctx_id, &from);
+		hr_share_check(dt);
+		/* A recorded decision is replayed whatever the gating */
+		if (!(dt->replay && sched_replay_find(starpu_task_get_job_id(job->task)))
+		    && !hr_task_fits_open(dt, job->task, starpu_timing_now()))
+		{
+			/* It was the head of its list, it still is. A pending
+			 * task goes back unkeyed, ahead of the younger ones. */
+			hr_job_list_push_front(from, job);
+			if (dt->share)
+				sched_share_wait(dt->share);
+			break;
+		}
+		ret = hr_dispatch(dt, hr_job_dispatched(dt, job), sched_ctx_id);
+	}
+	return ret;
+}
+
+/* Called by a worker whose horizon just shrank, or when another context
+ * poked the share */
+static void hr_release_from_worker(struct _starpu_dmda_data *dt, unsigned sched_ctx_id)
+{
+	if ((dt->horizon <= 0.0 && dt->share == NULL)
+	    || __atomic_load_n(&dt->main_list_len, __ATOMIC_RELAXED) == 0)
+		return;
+	STARPU_PTHREAD_MUTEX_LOCK(&dt->policy_mutex);
+	hr_release(dt, sched_ctx_id);
+	STARPU_PTHREAD_MUTEX_UNLOCK(&dt->policy_mutex);
+	if (dt->share && __atomic_load_n(&dt->main_list_len, __ATOMIC_RELAXED) == 0)
+		sched_share_poke(dt->share);
+}
+
+/* Admission: expected end of each worker queue, indexed by worker id */
+static void hr_admit_snapshot(struct _starpu_dmda_data *dt, double *ends, double now)
+{
+	unsigned i;
+
+	for (i = 0; i < dt->workers.nworkers; i++)
+	{
+		int worker = dt->workers.ids[i];
+		struct _starpu_fifo_taskq *fifo = dt->queue_array[worker];
+		double exp_start = isnan(fifo->exp_start) ? now : STARPU_MAX(fifo->exp_start, now);
+		ends[worker] = exp_start + fifo->exp_len;
+	}
+}
+
+/* Admission: earliest finish of TASK over the worker ends ENDS, or NAN
+ * without prediction. With WITH_TRANSFER, the task cannot start before its
+ * data is there. The lengths come from the class cache when possible. */
+static double hr_admit_best(struct _starpu_dmda_data *dt, struct starpu_task *task, const double *ends, double now,
+			    int with_transfer, unsigned sched_ctx_id, int *best_worker, unsigned *best_impl, double *best_length)
+{
+	struct hr_class *c = hr_class_get(dt, task, hr_task_footprint(dt, task), sched_ctx_id);
+	double best_end = NAN;
+	unsigned impl_mask = ~0U;
+	unsigned i, nimpl;
+
+	*best_worker = -1;
+	for (i = 0; i < dt->workers.nworkers; i++)
+	{
+		int worker = dt->workers.ids[i];
+		const struct sched_worker_desc *desc = &dt->workers.desc[worker];
+
+		if (!sched_workers_may_execute(desc, task))
+			continue;
+		if (c == NULL && !starpu_worker_can_execute_task_impl(worker, task, &impl_mask))
+			continue;
+
+		double start = ends[worker];
+		if (with_transfer)
+		{
+			double transfer = starpu_task_expected_data_transfer_time(desc->memory_node, task);
+			if (!isnan(transfer))
+				start = STARPU_MAX(start, now + transfer);
+		}
+
+		for (nimpl = 0; nimpl < STARPU_MAXIMPLEMENTATIONS; nimpl++)
+		{
+			double length;
+			if (c != NULL)
+				length = c->length[worker][nimpl];
+			else if (impl_mask & (1U << nimpl))
+				length = starpu_task_expected_length(task, desc->perf_arch, nimpl);
+			else
+				continue;
+			if (isnan(length))
+				continue;
+
+			if (*best_worker == -1 || start + length < best_end)
+			{
+				best_end = start + length;
+				*best_worker = worker;
+				*best_impl = nimpl;
+				*best_length = length;
+			}
+		}
+	}
+	return best_end;
+}
+
+/* Admission: place the tasks of LIST dispatched before a task of key KEY,
+ * the whole list when ORDERED is 0 */
+static void hr_admit_backlog(struct _starpu_dmda_data *dt, const struct hr_job_list *list, int ordered, double key,
+			     double *ends, double now, unsigned sched_ctx_id)
+{
+	struct hr_job *job;
+
+	for (job = list->head; job != NULL; job = job->next)
+	{
+		int worker;
+		unsigned impl;
+		double length;
+
+		if (ordered && job->key < key)
+			/* Sorted by decreasing key, the rest comes after */
+			break;
+		/* Tasks without prediction are counted as empty */
+		if (!isnan(hr_admit_best(dt, job->task, ends, now, 0, sched_ctx_id, &worker, &impl, &length)))
+			ends[worker] += length;
+	}
+}
+
+/* Add (SIGN 1) or remove (SIGN -1) a reservation from the prediction of its
+ * worker queue */
+static void hr_reservation_account(struct _starpu_dmda_data *dt, struct hr_reservation *r, double sign)
+{
+	starpu_pthread_mutex_t *sched_mutex;
+	starpu_pthread_cond_t *sched_cond;
+
+	if (r->worker < 0)
+		/* Its queue was retired with the reservation in it */
+		return;
+	struct _starpu_fifo_taskq *fifo = dt->queue_array[r->worker];
+	starpu_worker_get_sched_condition(r->worker, &sched_mutex, &sched_cond);
+	STARPU_PTHREAD_MUTEX_LOCK_SCHED(sched_mutex);
+	fifo->exp_len += sign * r->length;
+	fifo->exp_end += sign * r->length;
+	STARPU_PTHREAD_MUTEX_UNLOCK_SCHED(sched_mutex);
+}
+
+/* Remove and return the reservation of TASK, policy_mutex held */
+static struct hr_reservation *hr_reservation_take(struct _starpu_dmda_data *dt, struct starpu_task *task)
+{
+	struct hr_reservation **prev;
+
+	for (prev = &dt->reservations; *prev; prev = &(*prev)->next)
+		if ((*prev)->task == task)
+		{
+			struct hr_reservation *r = *prev;
+			*prev = r->next;
+			return r;
+		}
+	return NULL;
+}
+
+/* Push an admitted task to the worker it was reserved on, policy_mutex held */
+/* Returns 1 when the reserved worker left the context: the task is then
+ * placed as usual */
+static int hr_push_reserved(struct _starpu_dmda_data *dt, struct starpu_task *task, struct hr_reservation *r, unsigned sched_ctx_id, int *ret)
+{
+	int worker = r->worker;
+	unsigned impl = r->impl;
+	double length = r->length;
+
+	/* push_task_on_best_worker adds it back, with the transfer */
+	hr_reservation_account(dt, r, -1.0);
+	free(r);
+	if (worker < 0 || !sched_workers_contains(&dt->workers, worker))
+		return 1;
+
+	double transfer = starpu_task_expected_data_transfer_time(dt->workers.desc[worker].memory_node, task);
+	SCHED_TRACE(SCHED_TRACE_PUSH, starpu_task_get_job_id(task), -1, 0.0);
+	SCHED_TRACE(SCHED_TRACE_DECISION, starpu_task_get_job_id(task), worker, NAN);
+	starpu_task_set_implementation(task, impl);
+	starpu_sched_task_break(task);
+	*ret = push_task_on_best_worker(task, worker, length, transfer, 0, sched_ctx_id);
+	return 0;
+}
+
+static int dm_push_task(struct starpu_task *task)
+{
+	unsigned sched_ctx_id = task->sched_ctx;
+	struct _starpu_dmda_data *data = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
+	STARPU_PTHREAD_MUTEX_LOCK(&data->policy_mutex);
+
+	if (data->reservations)
+	{
+		struct hr_reservation *r = hr_reservation_take(data, task);
+		int ret;
+		if (r && hr_push_reserved(data, task, r, sched_ctx_id, &ret) == 0)
+		{
+			STARPU_PTHREAD_MUTEX_UNLOCK(&data->policy_mutex);
+			return ret;
+		}
+	}
+
+	struct hr_job *job = hr_job_get(data, task);
+	if (data->meta_auto)
+		/* Safe point: the new task is not queued yet */
+		hr_meta_observe(data, job, sched_ctx_id);
+
+	hr_uniform_enter(data, task);
+	hr_job_list_push_back(&data->pending_list, job);
+	SCHED_TRACE(SCHED_TRACE_PUSH, starpu_task_get_job_id(task), -1, 0.0);
+
+	int ret = 0;
+	if (data->horizon > 0.0 || data->share)
+		ret = hr_release(data, sched_ctx_id);
+	else
+	{
+		all_device_len = hr_device_len(data);
+		if (all_device_len <= thr)
+		{
+			struct hr_job_list *from;
+			job = hr_next_task(data, sched_ctx_id, &from);
+			ret = hr_dispatch(data, hr_job_dispatched(data, job), sched_ctx_id);
+		}
+	}
+	STARPU_PTHREAD_MUTEX_UNLOCK(&data->policy_mutex);
+	/* Drained: the others may now get more than their share */
+	if (data->share && __atomic_load_n(&data->main_list_len, __ATOMIC_RELAXED) == 0)
+		sched_share_poke(data->share);
+	return ret;
+}
+
+static int dmda_push_task(struct starpu_task *task)
+{
+	STARPU_ASSERT(task);
+	return _dmda_push_task(task, 0, task->sched_ctx, 0, 0);
+}
+static double dmda_simulate_push_task(struct starpu_task *task)
+{
+	STARPU_ASSERT(task);
+	return _dmda_push_task(task, 0, task->sched_ctx, 1, 0);
+}
+
+static double dmda_simulate_push_sorted_task(struct starpu_task *task)
+{
+	STARPU_ASSERT(task);
+	return _dmda_push_task(task, 1, task->sched_ctx, 1, 0);
+}
+
+static double dmda_simulate_push_sorted_decision_task(struct starpu_task *task)
+{
+	STARPU_ASSERT(task);
+	return _dmda_push_task(task, 1, task->sched_ctx, 1, 1);
+}
+
+static void dmda_add_workers(unsigned sched_ctx_id, int *workerids, unsigned nworkers)
+{
+	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
+
+	unsigned i;
+	for (i = 0; i < nworkers; i++)
+	{
+		struct _starpu_fifo_taskq *q;
+		int workerid = workerids[i];
+		/* if the worker has alreadry belonged to this context
+		   the queue and the synchronization variables have been already initialized */
+		q = dt->queue_array[workerid];
+		if(q == NULL && dt->retired_queues[workerid] != NULL)
+		{
+			/* Back in the context: its queue was left empty */
+			q = dt->retired_queues[workerid];
+			dt->retired_queues[workerid] = NULL;
+			q->exp_start = starpu_timing_now();
+			q->exp_len = 0.0;
+			q->exp_end = q->exp_start;
+			__atomic_store_n(&dt->queue_array[workerid], q, __ATOMIC_RELEASE);
+		}
+		else if(q == NULL)
+		{
+			q = _starpu_create_fifo();
+			/* These are only stats, they can be read with races */
+			STARPU_HG_DISABLE_CHECKING(q->exp_start);
+			STARPU_HG_DISABLE_CHECKING(q->exp_len);
+			STARPU_HG_DISABLE_CHECKING(q->exp_end);
+			__atomic_store_n(&dt->queue_array[workerid], q, __ATOMIC_RELEASE);
+		}
+
+		if(dt->num_priorities != -1)
+		{
+			_STARPU_MALLOC(q->exp_len_per_priority, dt->num_priorities*sizeof(double));
+			_STARPU_MALLOC(q->ntasks_per_priority, dt->num_priorities*sizeof(unsigned));
+			int j;
+			for(j = 0; j < dt->num_priorities; j++)
+			{
+				q->exp_len_per_priority[j] = 0.0;
+				q->ntasks_per_priority[j] = 0;
+			}
+		}
+	}
+
+	/* The pushes read the worker table and the class cache, the queues
+	 * are published first */
+	STARPU_PTHREAD_MUTEX_LOCK(&dt->policy_mutex);
+	/* StarPU only creates groups, find them again when the workers
+	 * changed */
+	if (sched_workers_add(&dt->workers, workerids, nworkers, sched_ctx_id) > 0 && dt->combined)
+	{
+		_starpu_sched_find_worker_combinations(workerids, nworkers);
+		sched_workers_find_combined(&dt->workers, sched_ctx_id);
+	}
+	if (nworkers > 0 && dt->footprint_arch == NULL)
+		dt->footprint_arch = dt->workers.desc[workerids[0]].perf_arch;
+	/* The cached placement only covers the previous set of workers */
+	hr_class_invalidate_all(dt);
+	STARPU_PTHREAD_MUTEX_UNLOCK(&dt->policy_mutex);
+}
+
+static void dmda_remove_workers(unsigned sched_ctx_id, int *workerids, unsigned nworkers)
+{
+	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
 
 	int workerid;
 	unsigned i;
+	STARPU_PTHREAD_MUTEX_LOCK(&dt->policy_mutex);
+	sched_workers_remove(&dt->workers, workerids, nworkers);
+	hr_class_invalidate_all(dt);
+	/* Their reservations leave with the retired queues, the tasks will
+	 * be placed as usual */
+	for (struct hr_reservation *r = dt->reservations; r; r = r->next)
+		if (r->worker >= 0 && !sched_workers_contains(&dt->workers, r->worker))
+			r->worker = -1;
+	STARPU_PTHREAD_MUTEX_UNLOCK(&dt->policy_mutex);
+
 	for (i = 0; i < nworkers; i++)
 	{
 		workerid = workerids[i];
-		if(dt->queue_array[workerid] != NULL)
+		struct _starpu_fifo_taskq *q = dt->queue_array[workerid];
+		if(q != NULL)
 		{
 			if(dt->num_priorities != -1)
 			{
-				free(dt->queue_array[workerid]->exp_len_per_priority);
-				free(dt->queue_array[workerid]->ntasks_per_priority);
+				free(q->exp_len_per_priority);
+				free(q->ntasks_per_priority);
+				q->exp_len_per_priority = NULL;
+				q->ntasks_per_priority = NULL;
 			}
 
-			_starpu_destroy_fifo(dt->queue_array[workerid]);
-			dt->queue_array[workerid] = NULL;
+			/* The sampler may still be reading it */
+			__atomic_store_n(&dt->queue_array[workerid], NULL, __ATOMIC_RELEASE);
+			dt->retired_queues[workerid] = q;
 		}
 	}
 }
 
+/* Snapshot for the background sampler. It runs without policy_mutex: the
+ * queues of removed workers are only retired, and their counters are read
+ * with races. */
+static unsigned hr_sampler_snapshot(void *arg, struct sched_sampler_worker *workers, unsigned max, unsigned *backlog)
+{
+	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)arg;
+	unsigned n = 0;
+	int i;
+
+	for (i = 0; i < STARPU_NMAXWORKERS && n < max; i++)
+	{
+		struct _starpu_fifo_taskq *fifo = __atomic_load_n(&dt->queue_array[i], __ATOMIC_ACQUIRE);
+		if (fifo == NULL)
+			continue;
+
+		workers[n].worker = i;
+		workers[n].ntasks = __atomic_load_n(&fifo->ntasks, __ATOMIC_RELAXED);
+		workers[n].exp_len = fifo->exp_len;
+		workers[n].busy = __atomic_load_n(&dt->worker_busy[i], __ATOMIC_RELAXED);
+		n++;
+	}
+	*backlog = __atomic_load_n(&dt->main_list_len, __ATOMIC_RELAXED);
+
+	return n;
+}
+
+/* Fair share: tasks the context wants to run, read by the other tenants
+ * from counters only, the worker table may be changing */
+static unsigned hr_share_backlog(void *arg)
+{
+	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)arg;
+	int queued = __atomic_load_n(&dt->share_queued, __ATOMIC_RELAXED);
+
+	return __atomic_load_n(&dt->main_list_len, __ATOMIC_RELAXED) + (queued > 0 ? queued : 0);
+}
+
+static void hr_share_release(void *arg, unsigned sched_ctx_id)
+{
+	hr_release_from_worker((struct _starpu_dmda_data*)arg, sched_ctx_id);
+}
+
 static void initialize_dmda_policy(unsigned sched_ctx_id)
 {
 	starpu_sched_ctx_create_worker_collection(sched_ctx_id, STARPU_WORKER_LIST);
@@ -1177,13 +3029,80 @@ static void initialize_dmda_policy(unsigned sched_ctx_id)
 	int i;
 	for(i = 0; i < STARPU_NMAXWORKERS; i++)
 		dt->queue_array[i] = NULL;
+	_STARPU_CALLOC(dt->retired_queues, STARPU_NMAXWORKERS, sizeof(struct _starpu_fifo_taskq*));
 
 	dt->alpha = starpu_get_env_float_default("STARPU_SCHED_ALPHA", _STARPU_SCHED_ALPHA_DEFAULT);
 	dt->beta = starpu_get_env_float_default("STARPU_SCHED_BETA", _STARPU_SCHED_BETA_DEFAULT);
 	dt->_gamma = starpu_get_env_float_default("STARPU_SCHED_GAMMA", _STARPU_SCHED_GAMMA_DEFAULT);
 	dt->idle_power = starpu_get_env_float_default("STARPU_IDLE_POWER", 0.0);
 	STARPU_PTHREAD_MUTEX_INIT(&dt->policy_mutex, NULL);
-	starpu_task_list_init(&dt->main_list);
+	dt->model_tolerance = starpu_get_env_float_default("STARPU_HR_MODEL_TOLERANCE", _HR_MODEL_TOLERANCE_DEFAULT);
+	_STARPU_CALLOC(dt->classes, HR_CLASS_SLOTS, sizeof(struct hr_class));
+	dt->uniform_refresh = starpu_get_env_number_default("STARPU_HR_UNIFORM_REFRESH", _HR_UNIFORM_REFRESH_DEFAULT);
+	dt->budget = starpu_get_env_float_default("STARPU_HR_SCHED_BUDGET", 0.0) / 100.0;
+	dt->horizon = starpu_get_env_float_default("STARPU_HR_HORIZON", 0.0);
+	dt->combined = starpu_get_env_number_default("STARPU_HR_COMBINED", 0) > 0;
+	dt->combined_cost = starpu_get_env_float_default("STARPU_HR_COMBINED_COST", _HR_COMBINED_COST_DEFAULT);
+
+	const char *mode = getenv("STARPU_HR_MODE");
+	dt->mode = HR_MODE_RATIO;
+	if (mode && strcmp(mode, "auto") == 0)
+		dt->meta_auto = 1;
+	else if (mode && mode[0])
+	{
+		for (i = 0; i < HR_NMODES; i++)
+			if (strcmp(mode, hr_mode_names[i]) == 0)
+				break;
+		if (i < HR_NMODES)
+			dt->mode = i;
+		else
+			_STARPU_DISP("Warning: unknown STARPU_HR_MODE %s, using %s\n", mode, hr_mode_names[dt->mode]);
+	}
+	dt->meta_candidate = dt->mode;
+	dt->meta_window = starpu_get_env_number_default("STARPU_HR_META_WINDOW", _HR_META_WINDOW_DEFAULT);
+	if (dt->meta_window == 0)
+		dt->meta_window = _HR_META_WINDOW_DEFAULT;
+	dt->meta_depth = starpu_get_env_number_default("STARPU_HR_META_DEPTH", _HR_META_DEPTH_DEFAULT);
+	dt->meta_uniform_cv = starpu_get_env_float_default("STARPU_HR_META_UNIFORM_CV", _HR_META_UNIFORM_CV_DEFAULT);
+	dt->meta_sample = starpu_get_env_number_default("STARPU_HR_META_SAMPLE", _HR_META_SAMPLE_DEFAULT);
+	if (dt->meta_sample == 0)
+		dt->meta_sample = _HR_META_SAMPLE_DEFAULT;
+	dt->deadline_quantum = starpu_get_env_float_default("STARPU_HR_DEADLINE_QUANTUM", _HR_DEADLINE_QUANTUM_DEFAULT);
+	if (!(dt->deadline_quantum > 0.0))
+		dt->deadline_quantum = _HR_DEADLINE_QUANTUM_DEFAULT;
+	const char *energy = getenv("STARPU_HR_ENERGY");
+	if (energy && energy[0])
+	{
+		for (i = 0; i < HR_NENERGY; i++)
+			if (strcmp(energy, hr_energy_names[i]) == 0)
+				break;
+		if (i < HR_NENERGY)
+			dt->energy = i;
+		else
+			_STARPU_DISP("Warning: unknown STARPU_HR_ENERGY %s, energy-aware placement disabled\n", energy);
+	}
+	dt->energy_slack = starpu_get_env_float_default("STARPU_HR_ENERGY_SLACK", _HR_ENERGY_SLACK_DEFAULT);
+	if (!(dt->energy_slack >= 0.0))
+		dt->energy_slack = _HR_ENERGY_SLACK_DEFAULT;
+	dt->power_cap = starpu_get_env_float_default("STARPU_HR_POWER_CAP", 0.0);
+	dt->rapl = dt->energy != HR_ENERGY_OFF || SCHED_LOG_LEVEL >= SCHED_LOG_LEVEL_INFO;
+	if (dt->rapl && sched_energy_init() == 0 && dt->energy == HR_ENERGY_CAP)
+	{
+		_STARPU_DISP("Warning: no readable RAPL counter, STARPU_HR_ENERGY=cap disabled\n");
+		dt->energy = HR_ENERGY_OFF;
+	}
+	else if (dt->energy == HR_ENERGY_CAP && !(dt->power_cap > 0.0))
+	{
+		_STARPU_DISP("Warning: STARPU_HR_ENERGY=cap needs STARPU_HR_POWER_CAP in W, disabled\n");
+		dt->energy = HR_ENERGY_OFF;
+	}
+	dt->energy_start = dt->rapl ? sched_energy_cpu_joules() : NAN;
+	dt->replay = sched_replay_init() > 0;
+	sched_trace_init();
+	sched_perfcnt_init();
+	sched_sampler_start(hr_sampler_snapshot, dt);
+	dt->share_open = 1;
+	dt->share = sched_share_register(sched_ctx_id, hr_share_backlog, hr_share_release, dt);
 	if(starpu_sched_ctx_min_priority_is_set(sched_ctx_id) != 0 && starpu_sched_ctx_max_priority_is_set(sched_ctx_id) != 0)
 		dt->num_priorities = starpu_sched_ctx_get_max_priority(sched_ctx_id) - starpu_sched_ctx_get_min_priority(sched_ctx_id) + 1;
 	else 
@@ -1233,6 +3152,55 @@ static void deinitialize_dmda_policy(unsigned sched_ctx_id)
 	}
 #endif
 
+	if (dt->meta_auto)
+		SCHED_LOG_INFO("H-Ratio ordering switched %u times, ended with %s\n",
+			       dt->meta_switches, hr_mode_names[dt->mode]);
+	if (dt->budget > 0.0)
+	{
+		int tier;
+		for (tier = 0; tier < HR_NTIERS; tier++)
+			SCHED_LOG_INFO("H-Ratio %s decisions: %lu, key %.2f us, placement %.2f us\n",
+				       hr_tier_names[tier], dt->tier_count[tier], dt->key_cost[tier], dt->place_cost[tier]);
+		/* Many more than the classes of the workload: the table thrashes */
+		SCHED_LOG_INFO("H-Ratio class predictions computed %lu times\n", dt->class_fills);
+	}
+	while (dt->reservations)
+	{
+		/* Admitted but never submitted */
+		struct hr_reservation *r = dt->reservations;
+		dt->reservations = r->next;
+		free(r);
+	}
+	if (dt->deadline_count > 0)
+		SCHED_LOG_INFO("H-Ratio deadlines: %lu missed of %lu\n", dt->deadline_missed, dt->deadline_count);
+	while (dt->job_slabs)
+	{
+		/* With the records of tasks given a deadline but never run */
+		struct hr_job_slab *slab = dt->job_slabs;
+		dt->job_slabs = slab->next;
+		free(slab);
+	}
+	if (dt->energy != HR_ENERGY_OFF)
+		SCHED_LOG_INFO("H-Ratio energy (%s): %lu placements moved from the earliest finish\n",
+			       hr_energy_names[dt->energy], dt->energy_moves);
+	if (!isnan(dt->energy_start))
+		SCHED_LOG_INFO("H-Ratio CPU packages: %.1f J\n", sched_energy_cpu_joules() - dt->energy_start);
+	if (dt->rapl)
+		sched_energy_release();
+	if (dt->replay)
+		/* Asked for with STARPU_HR_REPLAY, always shown */
+		fprintf(stderr, "[sched_replay] context %u: %lu decisions replayed, %lu placed anew\n",
+			sched_ctx_id, dt->replay_hits, dt->replay_misses);
+	sched_replay_release();
+	sched_share_unregister(dt->share);
+	sched_sampler_stop(dt);
+	sched_perfcnt_dump();
+	sched_trace_dump();
+	for (int i = 0; i < STARPU_NMAXWORKERS; i++)
+		if (dt->retired_queues[i] != NULL)
+			_starpu_destroy_fifo(dt->retired_queues[i]);
+	free(dt->retired_queues);
+	free(dt->classes);
 	free(dt->queue_array);
 	free(dt);
 	starpu_sched_ctx_delete_worker_collection(sched_ctx_id);
@@ -1250,6 +3218,10 @@ static void dmda_pre_exec_hook(struct starpu_task *task)
 	double model = task->predicted;
 	double transfer_model = task->predicted_transfer;
 
+	SCHED_TRACE(SCHED_TRACE_PRE_EXEC, starpu_task_get_job_id(task), workerid, model);
+	__atomic_store_n(&dt->worker_busy[workerid], 1, __ATOMIC_RELAXED);
+	dt->exec_start[workerid] = starpu_timing_now();
+
 	starpu_pthread_mutex_t *sched_mutex;
 	starpu_pthread_cond_t *sched_cond;
 	starpu_worker_get_sched_condition(workerid, &sched_mutex, &sched_cond);
@@ -1294,6 +3266,13 @@ static void dmda_pre_exec_hook(struct starpu_task *task)
 
 	fifo->exp_end = fifo->exp_start + fifo->exp_len;
 	STARPU_PTHREAD_MUTEX_UNLOCK_SCHED(sched_mutex);
+
+	/* The task left the horizon of this worker */
+	hr_release_from_worker(dt, sched_ctx_id);
+
+	/* Last thing before the codelet runs, so that the counters do not
+	 * include the hook itself */
+	SCHED_PERFCNT_START();
 }
 
 static void dmda_push_task_notify(struct starpu_task *task, int workerid, int perf_workerid, unsigned sched_ctx_id)
@@ -1301,8 +3280,8 @@ static void dmda_push_task_notify(struct starpu_task *task, int workerid, int pe
 	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
 	struct _starpu_fifo_taskq *fifo = dt->queue_array[workerid];
 	/* Compute the expected penality */
-	struct starpu_perfmodel_arch *perf_arch = starpu_worker_get_perf_archtype(perf_workerid, sched_ctx_id);
-	unsigned memory_node = starpu_worker_get_memory_node(workerid);
+	struct starpu_perfmodel_arch *perf_arch = sched_workers_perf_arch(&dt->workers, perf_workerid, sched_ctx_id);
+	unsigned memory_node = dt->workers.desc[workerid].memory_node;
 
 	double predicted = starpu_task_expected_length(task, perf_arch,
 						       starpu_task_get_implementation(task));
@@ -1381,6 +3360,32 @@ static void dmda_post_exec_hook(struct starpu_task * task)
 	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(task->sched_ctx);
 	unsigned workerid = starpu_worker_get_id_check();
 	struct _starpu_fifo_taskq *fifo = dt->queue_array[workerid];
+	SCHED_PERFCNT_STOP(task->cl, hr_task_footprint(dt, task), workerid);
+	SCHED_TRACE(SCHED_TRACE_POST_EXEC, starpu_task_get_job_id(task), workerid, 0.0);
+	__atomic_store_n(&dt->worker_busy[workerid], 0, __ATOMIC_RELAXED);
+
+	/* StarPU feeds the measure to the perf model: if the prediction was
+	 * missing or off, the keys computed from it are stale. The prediction
+	 * of a parallel task alias includes the wait for the other members. */
+	double measured = starpu_timing_now() - dt->exec_start[workerid];
+	if (task->cl && task->cl->model && starpu_combined_worker_get_size() <= 1
+	    && (isnan(task->predicted) || fabs(measured - task->predicted) > dt->model_tolerance * task->predicted))
+		__atomic_add_fetch(&dt->model_version, 1, __ATOMIC_RELAXED);
+	if (dt->share && dt->workers.desc[workerid].where != STARPU_CPU)
+		sched_share_charge(dt->share, measured);
+	if (__atomic_load_n(&dt->ndeadlines, __ATOMIC_RELAXED) > 0)
+	{
+		STARPU_PTHREAD_MUTEX_LOCK(&dt->policy_mutex);
+		struct hr_job *job = hr_job_find(dt, task);
+		if (job && !isnan(job->deadline))
+		{
+			if (starpu_timing_now() > job->deadline)
+				dt->deadline_missed++;
+			dt->ndeadlines--;
+			hr_job_free(dt, job);
+		}
+		STARPU_PTHREAD_MUTEX_UNLOCK(&dt->policy_mutex);
+	}
 	starpu_pthread_mutex_t *sched_mutex;
 	starpu_pthread_cond_t *sched_cond;
 	starpu_worker_get_sched_condition(workerid, &sched_mutex, &sched_cond);
@@ -1388,9 +3393,14 @@ static void dmda_post_exec_hook(struct starpu_task * task)
 	fifo->exp_start = starpu_timing_now();
 	fifo->exp_end = fifo->exp_start + fifo->exp_len;
 	STARPU_PTHREAD_MUTEX_UNLOCK_SCHED(sched_mutex);
+
+	hr_release_from_worker(dt, task->sched_ctx);
+	if (dt->share)
+		sched_share_poke(dt->share);
 }
 
-struct starpu_sched_policy _starpu_sched_dm_policy =
+/* Also registered by name in sched-plugin/ */
+struct starpu_sched_policy hratio_sched_policy =
 {
 	.init_sched = initialize_dmda_policy,
 	.deinit_sched = deinitialize_dmda_policy,
@@ -1402,14 +3412,129 @@ struct starpu_sched_policy _starpu_sched_dm_policy =
 	.pre_exec_hook = dmda_pre_exec_hook,
 	.post_exec_hook = dmda_post_exec_hook,
 	.pop_every_task = dmda_pop_every_task,
-	.policy_name = "dm hudhoighjporjeopjowopgjpojgpjowgjopjgpo",
-	.policy_description = "performance model"
+	.policy_name = "hratio",
+	.policy_description = "heterogeneity ratio ordering, earliest finish placement"
 };
 
+int hr_sched_admit(unsigned sched_ctx_id, struct starpu_task *task, double target, double *finish)
+{
+	if (starpu_sched_ctx_get_sched_policy(sched_ctx_id) != &hratio_sched_policy)
+		return -ENODEV;
+
+	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
+	double ends[STARPU_NMAXWORKERS];
+	double now = starpu_timing_now();
+	double length = 0.0;
+	unsigned impl = 0;
+	int worker;
+
+	STARPU_PTHREAD_MUTEX_LOCK(&dt->policy_mutex);
+	hr_admit_snapshot(dt, ends, now);
+
+	/* The pending tasks are older, they go first whatever their key. The
+	 * main list is only ordered by key when hr_next_task sorts it. */
+	int ordered = dt->mode != HR_MODE_FIFO && !(dt->mode == HR_MODE_RATIO && dt->uniform_len == dt->main_list_len);
+	double key = ordered ? hr_task_key(dt, task, hr_job_find(dt, task), dt->mode, sched_ctx_id) : 0.0;
+	hr_admit_backlog(dt, &dt->main_list, ordered, key, ends, now, sched_ctx_id);
+	hr_admit_backlog(dt, &dt->pending_list, 0, 0.0, ends, now, sched_ctx_id);
+
+	*finish = hr_admit_best(dt, task, ends, now, 1, sched_ctx_id, &worker, &impl, &length);
+
+	int ret;
+	if (isnan(*finish))
+		ret = HR_ADMIT_UNPREDICTED;
+	else if (*finish > target)
+		ret = HR_ADMIT_REJECTED;
+	else
+	{
+		struct hr_reservation *r;
+		_STARPU_MALLOC(r, sizeof(*r));
+		r->task = task;
+		r->worker = worker;
+		r->impl = impl;
+		r->length = length;
+		r->next = dt->reservations;
+		dt->reservations = r;
+		hr_reservation_account(dt, r, 1.0);
+		ret = HR_ADMIT_ACCEPTED;
+	}
+	STARPU_PTHREAD_MUTEX_UNLOCK(&dt->policy_mutex);
+
+	SCHED_LOG_DEBUG("admission of job %lu: finish %lf for target %lf, %s\n", starpu_task_get_job_id(task),
+			*finish, target, ret == HR_ADMIT_ACCEPTED ? "accepted" : "not accepted");
+	return ret;
+}
+
+int hr_sched_set_share(unsigned sched_ctx_id, double weight)
+{
+	return sched_share_set_weight(sched_ctx_id, weight);
+}
+
+int hr_sched_get_share(unsigned sched_ctx_id, double *used, double *share)
+{
+	return sched_share_get_usage(sched_ctx_id, used, share);
+}
+
+int hr_sched_set_deadline(unsigned sched_ctx_id, struct starpu_task *task, double deadline)
+{
+	if (starpu_sched_ctx_get_sched_policy(sched_ctx_id) != &hratio_sched_policy)
+		return -ENODEV;
+
+	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
+
+	STARPU_PTHREAD_MUTEX_LOCK(&dt->policy_mutex);
+	struct hr_job *job = hr_job_get(dt, task);
+	if (isnan(job->deadline))
+	{
+		dt->ndeadlines++;
+		dt->deadline_count++;
+	}
+	job->deadline = deadline;
+	STARPU_PTHREAD_MUTEX_UNLOCK(&dt->policy_mutex);
+	return 0;
+}
+
+void hr_sched_clear_deadline(unsigned sched_ctx_id, struct starpu_task *task)
+{
+	if (starpu_sched_ctx_get_sched_policy(sched_ctx_id) != &hratio_sched_policy)
+		return;
+
+	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
+
+	STARPU_PTHREAD_MUTEX_LOCK(&dt->policy_mutex);
+	/* Not submitted: the record is in no list */
+	struct hr_job *job = hr_job_find(dt, task);
+	if (job && !isnan(job->deadline))
+	{
+		dt->ndeadlines--;
+		dt->deadline_count--;
+		hr_job_free(dt, job);
+	}
+	STARPU_PTHREAD_MUTEX_UNLOCK(&dt->policy_mutex);
+}
+
+void hr_sched_admit_cancel(unsigned sched_ctx_id, struct starpu_task *task)
+{
+	if (starpu_sched_ctx_get_sched_policy(sched_ctx_id) != &hratio_sched_policy)
+		return;
+
+	struct _starpu_dmda_data *dt = (struct _starpu_dmda_data*)starpu_sched_ctx_get_policy_data(sched_ctx_id);
+
+	STARPU_PTHREAD_MUTEX_LOCK(&dt->policy_mutex);
+	struct hr_reservation *r = hr_reservation_take(dt, task);
+	if (r)
+	{
+		hr_reservation_account(dt, r, -1.0);
+		free(r);
+	}
+	STARPU_PTHREAD_MUTEX_UNLOCK(&dt->policy_mutex);
+}
+
 
 
 
 
+#ifndef SCHED_POLICY_LIBRARY
 /* default value */
 static unsigned ntasks = 1024;
 
@@ -1514,7 +3639,7 @@ int main(int argc, char **argv)
 #endif
 
 	starpu_conf_init(&conf);
-	conf.sched_policy = &_starpu_sched_dm_policy,
+	conf.sched_policy = &hratio_sched_policy,
 	ret = starpu_init(&conf);
 	//ret = starpu_init(NULL);
 	if (ret == -ENODEV)
@@ -1598,3 +3723,4 @@ int main(int argc, char **argv)
 
 	return 0;
 }
+#endif /* !SCHED_POLICY_LIBRARY */